@@ -2,27 +2,30 @@
 #define BACKEND_H
 
 #include "prog_tree.h"
+#include "spu_code.h"
+#include "peephole.h"
 
 class backend_t {
 public:
     void init(FILE* istream);
+    void init(prog_tree_t* tree);
     void dtor();
-    void translate_to_asm(FILE* ostream);
+    void set_jobs(size_t jobs);
+    err_t translate_to_asm(FILE* ostream);
+    err_t translate_to_bin(FILE* ostream);
 
     void set_dump_ostream(FILE* ostream);
     void dump();
-
-    void print_func(FILE* ostream, node_t* decl);
-    void print_func_body(FILE* ostream, node_t* node, size_t ram_index);
-    void print_expr(FILE* ostream, node_t* node, size_t ram_index);
-    void push_expr(FILE* ostream, node_t* node, size_t ram_index);
-    void print_op_expr_r(FILE* ostream, node_t* node, size_t ram_index);
-    void print_op(FILE* ostream, node_t* node, size_t ram_index);
-    void print_if_else(FILE* ostream, node_t* node, size_t ram_index);
-    void print_equal(FILE* ostream, node_t* node, size_t ram_index);
-    const char* reg_by_num(size_t i);
 private:
+    bool translate(FILE* ostream);
+    void flush(FILE* ostream, spu_code_t* code);
+
     prog_tree_t prog_tree_;
+    spu_code_t code_{};
+    peephole_t peephole_{};  // hits of all the functions
+    spu_code_t program_{};
+    bool is_binary_{false};
+    size_t jobs_{1};
 };
 
 #endif /* BACKEND_H */
@@ -0,0 +1,136 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include "prog_tree.h"
+
+const size_t BC_CODE_MIN_CAPACITY   = 64;
+const size_t VM_REGS_MIN_CAPACITY   = 1024;
+const size_t VM_FRAMES_MIN_CAPACITY = 64;
+const size_t VM_MAX_DEPTH           = 1 << 20;
+const uint32_t BC_NO_REG            = UINT32_MAX;
+const uint32_t BC_NO_CONST          = UINT32_MAX;
+const size_t BC_NO_INSTR            = SIZE_MAX;
+
+// NOTE - register operands index the current frame; jump targets are absolute
+//        instruction indices inside the function
+typedef enum {
+    BC_LOADK = 0,  // a = consts[b]
+    BC_MOV   = 1,  // a = b
+    BC_NEG   = 2,  // a = -b
+    BC_ADD   = 3,  // a = b + c
+    BC_SUB   = 4,  // a = b - c
+    BC_MUL   = 5,  // a = b * c
+    BC_DIV   = 6,  // a = b / c
+    BC_POW   = 7,  // a = b ^ c
+    BC_LOG   = 8,  // a = log_b(c)
+    BC_MATH  = 9,  // a = c(b), c is an op_t of a unary function
+    BC_JMP   = 10, // goto a
+    BC_JE    = 11, // if (b == c) goto a
+    BC_JNE   = 12,
+    BC_JNA   = 13, // if !(b > c) goto a, also taken when b or c is NaN
+    BC_JNAE  = 14,
+    BC_JNB   = 15,
+    BC_JNBE  = 16,
+    BC_IN    = 17, // scan a
+    BC_OUT   = 18, // print a
+    BC_CALL  = 19, // call funcs[a] with c arguments in b, b + 1, ...
+    BC_RET   = 20,
+
+    BC_OPS_AMOUNT = 21,
+} bc_op_t;
+
+typedef struct {
+    uint32_t op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} bc_instr_t;
+
+typedef struct {
+    const char* name;
+
+    bc_instr_t* code;
+    size_t code_size;
+    size_t code_capacity;
+
+    double* consts;
+    size_t consts_size;
+    size_t consts_capacity;
+
+    uint32_t* params;
+    size_t params_amount;
+    size_t regs_amount;
+} bc_func_t;
+
+class bytecode_t {
+public:
+    err_t compile(prog_tree_t* tree);
+    void print(FILE* ostream);
+    void dtor();
+
+    bc_func_t* funcs_{nullptr};
+    size_t funcs_amount_{0};
+    size_t main_{0};
+private:
+    err_t compile_func(bc_func_t* func, node_t* decl);
+    bool assign_var_regs(bc_func_t* func, node_t* decl);
+    bool compile_list(bc_func_t* func, node_t* list);
+    bool compile_stmt(bc_func_t* func, node_t* stmt);
+    bool compile_if(bc_func_t* func, node_t* if_node, node_t* else_node);
+    bool compile_call(bc_func_t* func, node_t* call);
+    bool compile_expr_to(bc_func_t* func, node_t* node, uint32_t dst);
+    uint32_t compile_expr(bc_func_t* func, node_t* node);
+    uint32_t new_temp(bc_func_t* func);
+    node_t* next_item(node_t** list);
+    uint32_t var_reg(node_t* var);
+    size_t emit(bc_func_t* func, bc_op_t op, uint32_t a, uint32_t b, uint32_t c);
+    uint32_t add_const(bc_func_t* func, double value);
+
+    prog_tree_t* tree_{nullptr};
+    size_t* func_by_name_{nullptr};
+    uint32_t* regs_by_name_{nullptr};
+    size_t names_amount_{0};
+    uint32_t temps_base_{0};
+    uint32_t temps_used_{0};
+    uint32_t temps_max_{0};
+};
+
+typedef struct {
+    const void* handler;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} vm_instr_t;
+
+typedef struct {
+    size_t func;
+    size_t ret_pc;
+    size_t base;
+} vm_frame_t;
+
+class vm_t {
+public:
+    err_t init(bytecode_t* bytecode, FILE* istream, FILE* ostream);
+    err_t run();
+    void dtor();
+private:
+    bool thread_code(const void* const* handlers);
+    bool push_frame(size_t func, size_t ret_pc);
+
+    bytecode_t* bytecode_{nullptr};
+    FILE* istream_{nullptr};
+    FILE* ostream_{nullptr};
+
+    vm_instr_t** code_{nullptr};
+
+    double* regs_{nullptr};
+    size_t regs_size_{0};
+    size_t regs_capacity_{0};
+
+    vm_frame_t* frames_{nullptr};
+    size_t frames_size_{0};
+    size_t frames_capacity_{0};
+};
+
+#endif /* BYTECODE_H */
@@ -0,0 +1,151 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+#include "prog_tree.h"
+
+const size_t IR_NO_VALUE            = SIZE_MAX;
+const size_t IR_NO_BLOCK            = SIZE_MAX;
+const size_t IR_FUNCS_MIN_CAPACITY  = 8;
+const size_t IR_BLOCKS_MIN_CAPACITY = 8;
+const size_t IR_INSTRS_MIN_CAPACITY = 8;
+
+typedef enum {
+    IR_MOV  = 0,   // dst = a
+    IR_ADD  = 1,   // dst = a + b
+    IR_SUB  = 2,   // dst = a - b
+    IR_MUL  = 3,   // dst = a * b
+    IR_DIV  = 4,   // dst = a / b
+    IR_POW  = 5,   // dst = a ^ b
+    IR_LOG  = 6,   // dst = log_a(b)
+    IR_NEG  = 7,   // dst = -a
+    IR_MATH = 8,   // dst = op(a), op is an op_t of a unary function
+    IR_IN   = 9,   // dst = scan
+    IR_OUT  = 10,  // print a
+    IR_CALL = 11,  // call func(list)
+    IR_PHI  = 12,  // dst = phi(list), list[i] comes from the i-th predecessor
+    IR_BR   = 13,  // if (a op b) goto targets[0] else goto targets[1]
+    IR_JMP  = 14,  // goto targets[0]
+    IR_RET  = 15,
+
+    IR_OPCODES_AMOUNT = 16,
+} ir_opcode_t;
+
+typedef enum {
+    IR_NONE  = 0,
+    IR_VALUE = 1,
+    IR_CONST = 2,
+} ir_operand_kind_t;
+
+typedef struct {
+    ir_operand_kind_t kind;
+    size_t value;
+    double num;
+} ir_operand_t;
+
+typedef struct {
+    ir_opcode_t opcode;
+    int op;               // op_t of IR_MATH and IR_BR
+    size_t dst;           // IR_NO_VALUE if nothing is defined
+    ir_operand_t a;
+    ir_operand_t b;
+    ir_operand_t* list;   // arguments of IR_CALL, operands of IR_PHI
+    size_t list_size;
+    size_t func;          // callee name of IR_CALL, variable of IR_PHI
+    size_t targets[2];
+} ir_instr_t;
+
+typedef struct {
+    ir_instr_t* instrs;
+    size_t size;
+    size_t capacity;
+
+    size_t* preds;
+    size_t preds_size;
+    size_t preds_capacity;
+
+    size_t succs[2];
+    size_t succs_size;
+
+    size_t idom;
+} ir_block_t;
+
+// NOTE - values below names_amount are the variables of the program, they are
+//        assigned many times before SSA and disappear after it; temporaries and
+//        SSA names follow them. Block 0 is the entry, blocks are kept in layout order
+typedef struct {
+    const char* name;
+
+    ir_block_t* blocks;
+    size_t blocks_size;
+    size_t blocks_capacity;
+
+    size_t* params;
+    size_t params_amount;
+    size_t values_amount;
+} ir_func_t;
+
+// NOTE - three-address code lowered from the optimized tree: every function is
+//        a CFG of basic blocks ending in br/jmp/ret. build() lowers it, puts it
+//        into SSA form and runs copy propagation and dead code elimination,
+//        leave_ssa() replaces phis with moves in the predecessors
+class ir_t {
+public:
+    err_t build(prog_tree_t* tree);
+    ir_func_t* build_func(prog_tree_t* tree, node_t* decl);
+    bool leave_ssa();
+    void print(FILE* ostream);
+    void dtor();
+
+    ir_func_t* funcs_{nullptr};
+    size_t funcs_amount_{0};
+private:
+    ir_func_t* new_func();
+    size_t new_block(ir_func_t* func);
+    ir_instr_t* add_instr(ir_func_t* func, size_t block, ir_opcode_t opcode);
+    size_t new_value(ir_func_t* func);
+    bool is_terminated(ir_func_t* func, size_t block);
+    bool terminate(ir_func_t* func, size_t target);
+
+    bool lower_func(ir_func_t* func, node_t* decl);
+    bool lower_list(ir_func_t* func, node_t* list);
+    bool lower_stmt(ir_func_t* func, node_t* stmt);
+    bool lower_if(ir_func_t* func, node_t* if_node, node_t* else_node);
+    bool lower_call(ir_func_t* func, node_t* call);
+    ir_operand_t lower_expr(ir_func_t* func, node_t* node);
+    size_t var_value(node_t* var);
+    node_t* next_item(node_t** list);
+
+    bool link_blocks(ir_func_t* func);
+    bool add_pred(ir_block_t* block, size_t pred);
+    bool remove_unreachable(ir_func_t* func);
+    bool split_critical_edges(ir_func_t* func);
+
+    size_t* order_blocks(ir_func_t* func);
+    bool find_dominators(ir_func_t* func, size_t* order);
+    uint64_t* find_frontiers(ir_func_t* func);
+    bool place_phis(ir_func_t* func, uint64_t* frontiers);
+    bool rename(ir_func_t* func, size_t block, size_t* children, size_t* siblings);
+    bool build_ssa(ir_func_t* func);
+    bool propagate_copies(ir_func_t* func, bool* is_changed);
+    bool remove_dead_code(ir_func_t* func, bool* is_changed);
+    bool optimize(ir_func_t* func);
+
+    prog_tree_t* tree_{nullptr};
+    size_t names_amount_{0};
+    size_t current_{0};
+
+    size_t* defs_{nullptr};       // current SSA value of every variable while renaming
+    size_t* undo_vars_{nullptr};  // variables redefined in the blocks being renamed
+    size_t* undo_values_{nullptr};
+    size_t undo_size_{0};
+    size_t undo_capacity_{0};
+};
+
+const char* ir_opcode_name(ir_opcode_t opcode);
+size_t ir_operands_amount(const ir_instr_t* instr);
+ir_operand_t* ir_operand(ir_instr_t* instr, size_t i);
+bool ir_same_operand(const ir_operand_t* operand1, const ir_operand_t* operand2);
+bool ir_is_pure(ir_opcode_t opcode);
+
+#endif /* IR_H */
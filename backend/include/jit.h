@@ -0,0 +1,89 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <setjmp.h>
+#include <stdint.h>
+#include "prog_tree.h"
+
+const size_t JIT_CODE_MIN_CAPACITY    = 4096;
+const size_t JIT_PATCHES_MIN_CAPACITY = 64;
+const size_t JIT_MAX_ARGS             = 8;  // xmm0..xmm7, System V
+const size_t JIT_NO_SLOT              = SIZE_MAX;
+
+typedef struct {
+    size_t pos;     // rel32 field to patch
+    size_t target;  // function index for calls
+} jit_patch_t;
+
+// NOTE - the same code as x86_backend_t, encoded straight into memory: variables
+//        in rbp slots, xmm0 caching the top of the expression stack, System V
+//        calls between decls. Code is written into a heap buffer, then copied to
+//        an mmap'd page and made executable (never writable and executable at once)
+class jit_t {
+public:
+    err_t init(prog_tree_t* tree, FILE* istream, FILE* ostream);
+    err_t compile();
+    err_t run();
+    void dtor();
+private:
+    bool index_funcs();
+    bool compile_func(node_t* decl);
+    bool assign_slots(node_t* decl);
+    bool compile_list(node_t* list);
+    bool compile_stmt(node_t* stmt);
+    bool compile_if(node_t* if_node, node_t* else_node);
+    bool compile_call(node_t* call);
+    bool compile_expr(node_t* node);
+    bool compile_op(node_t* node);
+    bool compile_math(int op);
+    long slot_offset(node_t* var);
+    node_t* next_item(node_t** list);
+    const char* name(node_t* node);
+
+    void emit_bytes(size_t amount, ...);
+    void emit_u32(uint32_t value);
+    void emit_u64(uint64_t value);
+    void emit_slot(uint8_t opcode, int reg, long offset);
+    void emit_load_imm(double value, int reg);
+    void emit_call_abs(const void* func);
+    size_t emit_jump(uint8_t opcode);
+    void patch_rel32(size_t pos, size_t target);
+    void add_patch(jit_patch_t** patches, size_t* size, size_t* capacity, size_t pos, size_t target);
+    void push_xmm0();
+    void pop_xmm(int reg);
+
+    static void scan_helper(jit_t* jit, double* slot);
+    static void print_helper(jit_t* jit, double value);
+
+    prog_tree_t* tree_{nullptr};
+    FILE* istream_{nullptr};
+    FILE* ostream_{nullptr};
+
+    size_t names_amount_{0};
+    node_t** decls_{nullptr};
+    size_t* params_amount_{nullptr};
+    size_t* func_offsets_{nullptr};
+    size_t* slots_{nullptr};
+    size_t slots_amount_{0};
+
+    uint8_t* code_{nullptr};
+    size_t code_size_{0};
+    size_t code_capacity_{0};
+    bool is_alloc_err_{false};
+
+    jit_patch_t* calls_{nullptr};
+    size_t calls_size_{0};
+    size_t calls_capacity_{0};
+
+    jit_patch_t* returns_{nullptr};
+    size_t returns_size_{0};
+    size_t returns_capacity_{0};
+
+    uint8_t* exec_{nullptr};
+    size_t exec_size_{0};
+    size_t main_offset_{0};
+
+    jmp_buf abort_env_;
+};
+
+#endif /* JIT_H */
@@ -0,0 +1,37 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "spu_code.h"
+
+typedef enum {
+    PEEPHOLE_PUSH_POP    = 0,  // push X; pop X
+    PEEPHOLE_ADD_ZERO    = 1,  // push 0; add | push 0; sub
+    PEEPHOLE_MUL_ONE     = 2,  // push 1; mul | push 1; div | push 1; pow
+    PEEPHOLE_DEAD_CODE   = 3,  // anything after jmp, ret or hlt up to the next label
+    PEEPHOLE_JMP_NEXT    = 4,  // jmp L; L:
+    PEEPHOLE_DEAD_STORE  = 5,  // pop X; push X; ... pop X, X unread in between
+    PEEPHOLE_DEAD_LABEL  = 6,  // 5: with no jump to it
+
+    PEEPHOLE_RULES_AMOUNT = 7,
+} peephole_rule_t;
+
+// NOTE - rewrites a function's instructions until no rule matches, counting hits per rule
+//        over every function it was run on
+class peephole_t {
+public:
+    void run(spu_code_t* code);
+    void add(const peephole_t* other);
+    void report();
+private:
+    bool fold_tail(spu_instr_t* instrs, size_t* size);
+    bool compact(spu_code_t* code);
+    bool remove_jumps_to_next(spu_code_t* code);
+    bool remove_dead_stores(spu_code_t* code);
+    bool is_dead_store(spu_code_t* code, size_t pop);
+    bool remove_dead_labels(spu_code_t* code);
+    void sweep(spu_code_t* code);
+
+    size_t hits_[PEEPHOLE_RULES_AMOUNT]{};
+};
+
+#endif /* PEEPHOLE_H */
@@ -0,0 +1,69 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdint.h>
+#include "ir.h"
+
+const size_t REGALLOC_REGS_AMOUNT        = 7;    // ax..gx, hx holds the frame
+const size_t REGALLOC_NO_REG             = SIZE_MAX;
+const size_t REGALLOC_NO_SLOT            = SIZE_MAX;
+const size_t REGALLOC_CALLS_MIN_CAPACITY = 16;
+
+typedef struct {
+    size_t first;
+    size_t last;
+    size_t uses;
+    size_t reg;
+    size_t slot;
+} live_interval_t;
+
+typedef struct {
+    size_t block;
+    size_t index;
+    size_t live[REGALLOC_REGS_AMOUNT];
+    size_t live_amount;
+} call_site_t;
+
+// NOTE - works on a function out of SSA. Liveness is solved over the CFG, then
+//        every value gets the interval [first, last] of instruction positions
+//        (in layout order) where it is live. Values are given registers by use
+//        count, hottest first, two values share a register if their intervals
+//        are disjoint, the rest go to [hx+N] slots the same way. Calls clobber
+//        every register: values in registers that are live after a call also get
+//        a slot, they are saved there before the call and reloaded after it.
+//        frame_size() is how many slots the function takes, [hx+0]..[hx+frame-1]
+class regalloc_t {
+public:
+    bool allocate(ir_func_t* func, const bool* on_stack);
+    void dtor();
+    size_t reg_of(size_t value);
+    size_t slot_of(size_t value);
+    size_t live_across(size_t block, size_t index, size_t* values);
+    size_t frame_size();
+private:
+    bool reserve(size_t values_amount);
+    uint64_t* solve_liveness(ir_func_t* func);
+    void build_intervals(ir_func_t* func, const uint64_t* live, const bool* on_stack);
+    void extend(size_t value, size_t pos);
+    bool assign_regs();
+    bool find_call_sites(ir_func_t* func, const uint64_t* live);
+    bool add_call_site(size_t block, size_t index, const uint64_t* live);
+    bool overlaps(size_t value, size_t place, bool is_slot, size_t assigned);
+    void assign_slots();
+
+    live_interval_t* intervals_{nullptr};
+    size_t values_amount_{0};
+    size_t values_capacity_{0};
+    size_t set_words_{0};
+    size_t frame_size_{0};
+
+    size_t* values_{nullptr};
+    size_t values_size_{0};
+    bool* is_saved_{nullptr};
+
+    call_site_t* calls_{nullptr};
+    size_t calls_size_{0};
+    size_t calls_capacity_{0};
+};
+
+#endif /* REGALLOC_H */
@@ -0,0 +1,68 @@
+#ifndef SPU_BINARY_H
+#define SPU_BINARY_H
+
+#include <stdint.h>
+#include "spu_code.h"
+
+// NOTE - in.bin layout expected from spu/run.sh, everything about the encoding lives here:
+//        a header, then the code. An instruction is one opcode byte, the spu_cmd_t value
+//        in the low 6 bits and the argument mode in the high 2, followed by its operands:
+//        a register byte for REG and MEM, then a double for IMM and MEM ([hx+N] is MEM
+//        with register hx and offset N). Jump and call targets are IMM byte offsets from
+//        the start of the code. Multibyte fields are little-endian
+const uint32_t SPU_BIN_SIGNATURE = 0x21555053;  // "SPU!"
+const uint32_t SPU_BIN_VERSION   = 1;
+
+const uint8_t SPU_BIN_MODE_SHIFT = 6;
+const uint8_t SPU_BIN_CMD_MASK   = 0x3F;
+
+typedef enum {
+    SPU_BIN_NONE = 0,  // add
+    SPU_BIN_IMM  = 1,  // push 5, jmp 5:
+    SPU_BIN_REG  = 2,  // push ax
+    SPU_BIN_MEM  = 3,  // push [hx+5]
+} spu_bin_mode_t;
+
+typedef struct {
+    uint32_t signature;
+    uint32_t version;
+    uint64_t code_size;
+} spu_bin_header_t;
+
+const size_t SPU_BIN_MIN_CAPACITY        = 4096;
+const size_t SPU_BIN_LABELS_MIN_CAPACITY = 64;
+
+typedef struct {
+    spu_label_t label;
+    size_t addr;
+} spu_bin_label_t;
+
+// NOTE - two passes over the whole program: the first one gives every instruction
+//        its address and collects the labels, the second one encodes the instructions
+//        with the label references already resolved
+class spu_binary_t {
+public:
+    err_t assemble(const spu_code_t* code);
+    err_t write(FILE* ostream);
+    void dtor();
+private:
+    bool place_labels(const spu_code_t* code, size_t* code_size);
+    bool encode(const spu_code_t* code);
+    bool add_label(const spu_label_t* label, size_t addr);
+    bool find_label(const spu_label_t* label, size_t* addr);
+    bool reserve(size_t size);
+    void emit_byte(uint8_t byte);
+    void emit_double(double value);
+
+    uint8_t* bytes_{nullptr};
+    size_t size_{0};
+    size_t capacity_{0};
+
+    spu_bin_label_t* labels_{nullptr};
+    size_t labels_size_{0};
+    size_t labels_capacity_{0};
+};
+
+size_t spu_bin_instr_size(const spu_instr_t* instr);
+
+#endif /* SPU_BINARY_H */
@@ -0,0 +1,110 @@
+#ifndef SPU_CODE_H
+#define SPU_CODE_H
+
+#include "prog_tree.h"
+
+const size_t SPU_CODE_MIN_CAPACITY = 256;
+const size_t SPU_REGS_AMOUNT       = 8;
+const size_t SPU_REG_HX            = 7;
+
+typedef enum {
+    SPU_LABEL  = 0,  // not an instruction, defines label
+    SPU_PUSH   = 1,
+    SPU_POP    = 2,
+    SPU_ADD    = 3,
+    SPU_SUB    = 4,
+    SPU_MUL    = 5,
+    SPU_DIV    = 6,
+    SPU_POW    = 7,
+    SPU_LOG    = 8,
+    SPU_LN     = 9,
+    SPU_EXP    = 10,
+    SPU_SIN    = 11,
+    SPU_COS    = 12,
+    SPU_TG     = 13,
+    SPU_CTG    = 14,
+    SPU_SH     = 15,
+    SPU_CH     = 16,
+    SPU_TH     = 17,
+    SPU_CTH    = 18,
+    SPU_ARCSIN = 19,
+    SPU_ARCCOS = 20,
+    SPU_ARCTG  = 21,
+    SPU_ARCCTG = 22,
+    SPU_ARCSH  = 23,
+    SPU_ARCCH  = 24,
+    SPU_ARCTH  = 25,
+    SPU_ARCCTH = 26,
+    SPU_IN     = 27,
+    SPU_OUT    = 28,
+    SPU_JMP    = 29,
+    SPU_JA     = 30,
+    SPU_JAE    = 31,
+    SPU_JB     = 32,
+    SPU_JBE    = 33,
+    SPU_JE     = 34,
+    SPU_JNE    = 35,
+    SPU_CALL   = 36,
+    SPU_RET    = 37,
+    SPU_HLT    = 38,
+
+    SPU_CMDS_AMOUNT = 39,
+} spu_cmd_t;
+
+typedef enum {
+    SPU_ARG_NONE  = 0,
+    SPU_ARG_NUM   = 1,  // push 5
+    SPU_ARG_REG   = 2,  // push ax
+    SPU_ARG_MEM   = 3,  // push [hx+5]
+    SPU_ARG_LABEL = 4,  // jmp finish_5:
+} spu_arg_t;
+
+typedef enum {
+    SPU_LABEL_FUNC   = 0,  // main:
+    SPU_LABEL_ELSE   = 1,  // 5:
+    SPU_LABEL_FINISH = 2,  // finish_5:
+} spu_label_kind_t;
+
+typedef struct {
+    spu_label_kind_t kind;
+    size_t num;
+    const char* name;
+} spu_label_t;
+
+typedef struct {
+    spu_cmd_t cmd;
+    spu_arg_t arg;
+    double num;
+    size_t index;  // register or offset from hx
+    spu_label_t label;
+} spu_instr_t;
+
+// NOTE - instructions of one function, kept in memory so they can be rewritten before printing.
+//        An instruction that did not fit is dropped and sets is_alloc_err_ until clear()
+class spu_code_t {
+public:
+    void add(spu_cmd_t cmd);
+    void add_num(spu_cmd_t cmd, double num);
+    void add_reg(spu_cmd_t cmd, size_t reg);
+    void add_mem(spu_cmd_t cmd, size_t offset);
+    void add_label(spu_cmd_t cmd, spu_label_t label);
+    void append(const spu_code_t* code);
+    void move_labels(size_t base);
+    void print(FILE* ostream);
+    void clear();
+    void dtor();
+
+    spu_instr_t* instrs_{nullptr};
+    size_t size_{0};
+    size_t capacity_{0};
+    bool is_alloc_err_{false};
+private:
+    spu_instr_t* new_instr(spu_cmd_t cmd, spu_arg_t arg);
+};
+
+const char* spu_cmd_name(spu_cmd_t cmd);
+const char* spu_reg_name(size_t reg);
+bool spu_same_arg(const spu_instr_t* instr1, const spu_instr_t* instr2);
+bool spu_same_label(const spu_label_t* label1, const spu_label_t* label2);
+
+#endif /* SPU_CODE_H */
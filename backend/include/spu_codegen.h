@@ -0,0 +1,52 @@
+#ifndef SPU_CODEGEN_H
+#define SPU_CODEGEN_H
+
+#include "prog_tree.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "spu_code.h"
+#include "peephole.h"
+
+const size_t SPU_CODEGEN_MAX_OPERANDS = REGALLOC_REGS_AMOUNT;  // arguments of a call at most
+
+// NOTE - compiles one function at a time into the given spu_code_t: lowers it to IR,
+//        allocates registers, prints SPU instructions and runs the peephole pass on
+//        them. The tree is only read, so every thread may have its own generator
+class spu_codegen_t {
+public:
+    bool compile(prog_tree_t* tree, node_t* decl, spu_code_t* code, size_t* labels_amount);
+    void dtor();
+    const peephole_t* peephole();
+private:
+    bool reserve(size_t values_amount);
+
+    bool plan_stack(ir_func_t* func);
+    size_t stack_operands(ir_instr_t* instr, ir_operand_t* operands, int* op);
+    bool take(ir_operand_t* operands, size_t amount, bool is_planning);
+    bool is_stacked(const ir_operand_t* operand);
+
+    bool print_func(ir_func_t* func);
+    bool print_instr(ir_func_t* func, size_t block, size_t index);
+    bool print_call(ir_instr_t* instr, size_t block, size_t index);
+    bool print_branch(ir_instr_t* instr, size_t block);
+    void move_frame(spu_cmd_t cmd);
+    void print_operand(const ir_operand_t* operand);
+    void print_value(spu_cmd_t cmd, size_t value);
+    void store(size_t value);
+
+    prog_tree_t* tree_{nullptr};
+    ir_t ir_{};
+    regalloc_t regalloc_{};
+    peephole_t peephole_{};
+    spu_code_t* code_{nullptr};
+
+    // NOTE - a value read once right after its definition is not stored anywhere,
+    //        it stays on the SPU stack for its reader; pending_ is the SPU stack
+    //        of such values while a block is walked, bottom first
+    bool* on_stack_{nullptr};
+    size_t* pending_{nullptr};
+    size_t pending_size_{0};
+    size_t values_capacity_{0};
+};
+
+#endif /* SPU_CODEGEN_H */
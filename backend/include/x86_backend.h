@@ -0,0 +1,56 @@
+#ifndef X86_BACKEND_H
+#define X86_BACKEND_H
+
+#include <stdint.h>
+#include "prog_tree.h"
+
+const size_t X86_MAX_ARGS            = 8;  // xmm0..xmm7, System V
+const size_t X86_CONSTS_MIN_CAPACITY = 64;
+const size_t X86_NO_SLOT             = SIZE_MAX;
+
+// NOTE - GNU as (AT&T syntax) for x86-64 Linux: doubles live in SSE2 registers,
+//        every variable of a function gets a stack slot below rbp, expressions
+//        are evaluated with the top of the stack cached in xmm0 and the rest
+//        spilled to the machine stack in 16 byte steps, so rsp stays aligned for
+//        libm/libc calls. Functions are exported as lang_<name>, main calls lang_main.
+class x86_backend_t {
+public:
+    void init(prog_tree_t* tree);
+    void dtor();
+    err_t translate_to_x86(FILE* ostream);
+private:
+    bool index_funcs();
+    bool print_func(node_t* decl);
+    bool assign_slots(node_t* decl);
+    bool print_list(node_t* list);
+    bool print_stmt(node_t* stmt);
+    bool print_if(node_t* if_node, node_t* else_node);
+    bool print_call(node_t* call);
+    bool print_expr(node_t* node);
+    bool print_op(node_t* node);
+    bool print_math(int op);
+    void print_runtime();
+    void print_consts();
+    void push_xmm0();
+    void pop_xmm(int reg);
+    bool load_const(double value, int reg);
+    long slot_offset(node_t* var);
+    node_t* next_item(node_t** list);
+    const char* name(node_t* node);
+
+    prog_tree_t prog_tree_{};
+    FILE* ostream_{nullptr};
+
+    size_t names_amount_{0};
+    node_t** decls_{nullptr};
+    size_t* params_amount_{nullptr};
+    size_t* slots_{nullptr};
+    size_t slots_amount_{0};
+    const char* func_name_{nullptr};
+
+    uint64_t* consts_{nullptr};
+    size_t consts_size_{0};
+    size_t consts_capacity_{0};
+};
+
+#endif /* X86_BACKEND_H */
@@ -1,356 +1,225 @@
 #include <assert.h>
+#include <pthread.h>
 #include "backend.h"
 #include "prog_tree.h"
+#include "spu_code.h"
+#include "spu_codegen.h"
+#include "spu_binary.h"
 #include "logger.h"
 
+// NOTE - work shared by the compiler threads: functions are taken one by one
+//        in order, each one is compiled into its own codes[i]
+typedef struct {
+    prog_tree_t* tree;
+    node_t** decls;
+    spu_code_t* codes;
+    size_t* labels;
+    size_t funcs_amount;
+
+    pthread_mutex_t lock;  // guards the fields below
+    size_t next;
+    bool is_ok;
+    peephole_t* peephole;
+} spu_jobs_t;
+
+static spu_label_t func_label(const char* name);
+static bool run_jobs(spu_jobs_t* jobs, size_t threads_amount);
+static void* compile_funcs(void* arg);
+
 void backend_t::init(FILE* istream) {
     assert(istream != nullptr);
 
     prog_tree_.serialization(istream);
 }
 
+void backend_t::init(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    prog_tree_ = *tree;
+    *tree = prog_tree_t();
+}
+
 void backend_t::dtor() {
     prog_tree_.tree_dtor();
+    code_.dtor();
+    program_.dtor();
 }
 
-void backend_t::translate_to_asm(FILE* ostream) {
-    assert(ostream != nullptr);
-
-    fprintf(ostream, "push 0\n");
-    fprintf(ostream, "pop hx\n");
-    fprintf(ostream, "call main:\n");
-    fprintf(ostream, "hlt\n");
-
-    node_t* current_node = prog_tree_.root_;
-    while (current_node != nullptr && current_node->left != nullptr) { //NOTE - if current_node->left->type == OP && current_node->left->type == OP) - syntax_err
-        print_func(ostream, current_node->left);
-        current_node = current_node->right;
-    }
-
+void backend_t::set_jobs(size_t jobs) {
+    jobs_ = jobs > 0 ? jobs : 1;
 }
 
-void backend_t::print_func(FILE* ostream, node_t* decl) {
+err_t backend_t::translate_to_asm(FILE* ostream) {
     assert(ostream != nullptr);
-    assert(decl != nullptr);
-    size_t ram_index = 0; //FIXME -  suka huinya ebanay
-
-    if (decl->left == nullptr || decl->left->type != OP || (int) decl->left->value != SPEC) {
-        LOG(ERROR, "Syntax err at %p: %d %d\n", decl, decl->left->type == OP, (int) decl->left->value == SPEC);
-        return;
-    }
-    if (decl->left->left->type != FUNC) {
-        LOG(ERROR, "Syntax err at %p\n", decl);
-        return;
-    }
 
-    fprintf(ostream, "%s:\n", prog_tree_.var_nametable_[(int) decl->left->left->value].name);
-    fprintf(ostream, "push hx\n");
-    fprintf(ostream, "push 100\n");
-    fprintf(ostream, "add\n");
-    fprintf(ostream, "pop hx\n");
-
-    size_t i = 0;
-    node_t* current_node = decl->left->right;
-    while (1) {
-        if (current_node == nullptr) break;
-        if (current_node->type == VAR) {
-            fprintf(ostream, "push %s\n", reg_by_num(i));
-            fprintf(ostream, "pop [hx+%zu]\n", (size_t) current_node->value);
-            break;
-        }
-        else if (current_node->type ==  OP && (int) current_node->value == SEMICOLON) {
-            fprintf(ostream, "push %s\n", reg_by_num(i));
-            fprintf(ostream, "pop [hx+%zu]\n", (size_t) current_node->left->value);
-            current_node = current_node->right;
-            i++;
-        }
-    }
-
-    print_func_body(ostream, decl->right, ram_index);
-}
-
-const char* backend_t::reg_by_num(size_t i) {
-    switch (i) {
-        case 0: return "ax";
-        case 1: return "bx";
-        case 2: return "cx";
-        case 3: return "dx";
-        case 4: return "ex";
-        case 5: return "fx";
-        case 6: return "gx";
-        default: return "";
-    }
+    is_binary_ = false;
+    return translate(ostream) ? NO_ERR : SYNTAX_ERR;
 }
 
-void backend_t::print_func_body(FILE* ostream, node_t* node, size_t ram_index) {
+// NOTE - functions are collected into program_ instead of being printed, labels can
+//        only be resolved once the whole program is known
+err_t backend_t::translate_to_bin(FILE* ostream) {
     assert(ostream != nullptr);
 
-    if (node == nullptr) {
-        return;
+    is_binary_ = true;
+    if (!translate(ostream) || program_.is_alloc_err_) {
+        program_.clear();
+        return SYNTAX_ERR;
     }
 
-    node_t* my_node = node;
-    while (my_node != nullptr && my_node->type == OP && (int) my_node->value == SEMICOLON) {
-        print_expr(ostream, my_node->left, ram_index);
-        my_node = my_node->right;
+    spu_binary_t binary = {};
+    err_t err = binary.assemble(&program_);
+    if (err == NO_ERR) {
+        err = binary.write(ostream);
     }
+    binary.dtor();
+    program_.clear();
+    return err;
 }
 
-// NOTE :
-// EQ     // =
-// IE     // ==
-// INE    // !=
-// IA     // >
-// IAEQ   // >=
-// IB     // <
-// IBEQ   // <=
-// IF
-// ELSE
-// WHILE
-void backend_t::print_equal(FILE* ostream, node_t* node, size_t ram_index) {
-    assert(ostream != nullptr);
-    if (node == nullptr) return;
-
-    push_expr(ostream, node->right, ram_index);
-    fprintf(ostream, "pop [hx+%zu]\n", (size_t) node->left->value);
-}
-
-void backend_t::print_expr(FILE* ostream, node_t* node, size_t ram_index) {
-    assert(ostream != nullptr);
-    if (node == nullptr) return;
-
-    switch ((int) node->value) {
-        case DEF_VAR: {
-            push_expr(ostream, node->left->right, ram_index); // FIXME - check errors
-            fprintf(ostream, "pop [hx+%zu]\n", (size_t) node->left->left->value);
-            break;
-        }
-        case CALL: {
-            size_t i = 0;
-            node_t* current_node = node->left;
-            while (1) {
-                if (current_node == nullptr) break;
-                if (current_node->type ==  OP && (int) current_node->value == SEMICOLON) {
-                    push_expr(ostream, current_node->left, ram_index);
-                    fprintf(ostream, "pop %s\n", reg_by_num(i));
-                    current_node = current_node->right;
-                    i++;
-                }
-                else {
-                    push_expr(ostream, current_node, ram_index);
-                    fprintf(ostream, "pop %s\n", reg_by_num(i));
-                    break;
-                }
-            }
-            fprintf(ostream, "call %s:\n", prog_tree_.var_nametable_[(int) node->right->value].name);
-            break;
-        }
-        case RETURN: {
-            fprintf(ostream, "push hx\n");
-            fprintf(ostream, "push 100\n");
-            fprintf(ostream, "sub\n");
-            fprintf(ostream, "pop hx\n");
-            fprintf(ostream, "ret\n");
-            break;
-        }
-        case IF: {
-            break;
-         //NOTE -
-        }
-        case SEMICOLON: {
-            print_if_else(ostream, node, ram_index);
-            break;
-        }
-        case EQ: {
-            print_equal(ostream, node, ram_index);
-            break;
+// NOTE - the tree is only read from here on, so functions are compiled in parallel,
+//        each into its own spu_code_t with jump labels numbered from 0. They are
+//        printed in declaration order, labels moved past the ones of the previous
+//        functions, so the output does not depend on the amount of jobs. Nothing
+//        is written unless every function compiles
+bool backend_t::translate(FILE* ostream) {
+    code_.add_num(SPU_PUSH, 0);
+    code_.add_reg(SPU_POP, SPU_REG_HX);
+    code_.add_label(SPU_CALL, func_label("main"));
+    code_.add(SPU_HLT);
+    if (code_.is_alloc_err_) {
+        code_.clear();
+        return false;
+    }
+
+    size_t funcs_amount = 0;
+    for (node_t* decls = prog_tree_.root_; decls != nullptr && decls->left != nullptr; decls = decls->right) {
+        funcs_amount++;
+    }
+
+    spu_jobs_t jobs = {};
+    jobs.tree     = &prog_tree_;
+    jobs.decls    = (node_t**) calloc(funcs_amount + 1, sizeof(node_t*));
+    jobs.codes    = (spu_code_t*) calloc(funcs_amount + 1, sizeof(spu_code_t));
+    jobs.labels   = (size_t*) calloc(funcs_amount + 1, sizeof(size_t));
+    jobs.is_ok    = true;
+    jobs.peephole = &peephole_;
+    if (jobs.decls == nullptr || jobs.codes == nullptr || jobs.labels == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(jobs.decls);
+        free(jobs.codes);
+        free(jobs.labels);
+        code_.clear();
+        return false;
+    }
+
+    for (node_t* decls = prog_tree_.root_; decls != nullptr && decls->left != nullptr; decls = decls->right) {
+        jobs.decls[jobs.funcs_amount++] = decls->left;
+    }
+
+    if (!run_jobs(&jobs, jobs_ < funcs_amount ? jobs_ : funcs_amount)) {
+        jobs.is_ok = false;
+    }
+
+    if (jobs.is_ok) {
+        flush(ostream, &code_);
+    }
+    code_.clear();
+
+    size_t labels_base = prog_tree_.jmp_cnt_;
+    for (size_t i = 0; i < funcs_amount; i++) {
+        if (jobs.is_ok) {
+            jobs.codes[i].move_labels(labels_base);
+            labels_base += jobs.labels[i];
+            flush(ostream, &jobs.codes[i]);
         }
-        case IN: {
-            fprintf(ostream, "in\n");
-            fprintf(ostream, "pop [hx+%zu]\n", (size_t) node->left->value);
-            break;
-        }
-        case OUT: {
-            fprintf(ostream, "push [hx+%zu]\n", (size_t) node->left->value);
-            fprintf(ostream, "out\n");
-            break;
-        }
-        default:
-            break;
+        jobs.codes[i].dtor();
     }
-}
-
-void backend_t::print_if_else(FILE* ostream, node_t* node, size_t ram_index) {
-    assert(ostream != nullptr);
-    if (node == nullptr) return;
+    prog_tree_.jmp_cnt_ = labels_base;
 
+    free(jobs.decls);
+    free(jobs.codes);
+    free(jobs.labels);
+    peephole_.report();
+    return jobs.is_ok;
+}
 
-    node_t* if_node = node->left;
-    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF) {
-        LOG(ERROR, "Syntax err\n");
-        return;
+void backend_t::flush(FILE* ostream, spu_code_t* code) {
+    if (is_binary_) {
+        program_.append(code);
     }
-
-    node_t* else_node = node->right;
-    if (else_node == nullptr || else_node->type != OP || (int) else_node->value != ELSE) {
-        LOG(ERROR, "Syntax err\n");
-        return;
+    else {
+        code->print(ostream);
     }
+    code->clear();
+}
 
-    push_expr(ostream, if_node->left->left, ram_index);
-    push_expr(ostream, if_node->left->right, ram_index);
+// NOTE - the calling thread is one of the workers, so a single job needs no threads.
+//        A thread that fails to start only leaves more work to the others
+static bool run_jobs(spu_jobs_t* jobs, size_t threads_amount) {
+    assert(jobs != nullptr);
 
-    size_t num = prog_tree_.jmp_cnt_++;
-    switch ((int) if_node->left->value) {
-        case IAEQ:
-            fprintf(ostream, "jae %zu:\n", num);
-            break;
-        case IB:
-            fprintf(ostream, "jb %zu:\n", num);
-            break;
-        case IE:
-            fprintf(ostream, "je %zu:\n", num);
-            break;
-        case INE:
-            fprintf(ostream, "jne %zu:\n", num);
-            break;
-        case IA:
-            fprintf(ostream, "ja %zu:\n", num);
-            break;
-        case IBEQ:
-            fprintf(ostream, "jbe %zu:\n", num);
-            break;
-        default:
-            break;
+    pthread_t* threads = (pthread_t*) calloc(threads_amount + 1, sizeof(pthread_t));
+    if (threads == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
     }
+    pthread_mutex_init(&jobs->lock, nullptr);
 
-    node_t* my_node = else_node->left;
-    while (my_node != nullptr) {
-        print_expr(ostream, my_node->left, ram_index);
-        my_node = my_node->right;
+    size_t started = 0;
+    while (started + 1 < threads_amount) {
+        if (pthread_create(&threads[started], nullptr, compile_funcs, jobs) != 0) {
+            LOG(WARNING, "Failed to start a compiler thread, %zu are running\n", started + 1);
+            break;
+        }
+        started++;
     }
 
-    fprintf(ostream, "jmp finish_%zu:\n", num);
-    fprintf(ostream, "%zu:\n", num);
-
-    my_node = if_node->right;
-    while (my_node != nullptr) {
-        print_expr(ostream, my_node->left, ram_index);
-        my_node = my_node->right;
+    compile_funcs(jobs);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], nullptr);
     }
 
-    fprintf(ostream, "finish_%zu:\n", num);
+    free(threads);
+    pthread_mutex_destroy(&jobs->lock);
+    return true;
 }
 
-void backend_t::push_expr(FILE* ostream, node_t* node, size_t ram_index) {
-    assert(ostream != nullptr);
-    if (node == nullptr) return;
+static void* compile_funcs(void* arg) {
+    assert(arg != nullptr);
 
-    if (node->type == NUM) {
-        fprintf(ostream, "push %lg\n", node->value);
-    }
-    else if (node->type == VAR) {
-        fprintf(ostream, "push [hx+%zu]\n", (size_t) node->value);
-    }
-    else if (node->type == FUNC) {
-        fprintf(ostream, "call %s:\n", prog_tree_.var_nametable_[(int)node->value].name);
-    }
-    else {
-        print_op_expr_r(ostream, node, ram_index);
-    }
-}
+    spu_jobs_t* jobs = (spu_jobs_t*) arg;
+    spu_codegen_t codegen = {};
 
-void backend_t::print_op_expr_r(FILE* ostream, node_t* node, size_t ram_index) {
-    assert(ostream != nullptr);
-    if (node == nullptr) return;
+    while (true) {
+        pthread_mutex_lock(&jobs->lock);
+        size_t i = jobs->next++;
+        bool is_done = !jobs->is_ok || i >= jobs->funcs_amount;
+        pthread_mutex_unlock(&jobs->lock);
+        if (is_done) {
+            break;
+        }
 
-    if (node->left != nullptr) {
-        push_expr(ostream, node->left, ram_index);
+        if (!codegen.compile(jobs->tree, jobs->decls[i], &jobs->codes[i], &jobs->labels[i])) {
+            pthread_mutex_lock(&jobs->lock);
+            jobs->is_ok = false;
+            pthread_mutex_unlock(&jobs->lock);
+        }
     }
 
-    if (node->right != nullptr) {
-        push_expr(ostream, node->right, ram_index);
-    }
+    pthread_mutex_lock(&jobs->lock);
+    jobs->peephole->add(codegen.peephole());
+    pthread_mutex_unlock(&jobs->lock);
 
-    print_op(ostream, node, ram_index);
+    codegen.dtor();
+    return nullptr;
 }
 
-void backend_t::print_op(FILE* ostream, node_t* node, size_t ram_index) { //NOTE -  unsued ram
-    switch ((int) node->value) {
-        case ADD:
-            fprintf(ostream, "add\n");
-            break;
-        case SUB:
-            fprintf(ostream, "sub\n");
-            break;
-        case DIV:
-            fprintf(ostream, "div\n");
-            break;
-        case MUL:
-            fprintf(ostream, "mul\n");
-            break;
-        case POW:
-            fprintf(ostream, "pow\n");
-            break;
-        case LOG:
-            fprintf(ostream, "log\n");
-            break;
-        case LN:
-            fprintf(ostream, "ln\n");
-            break;
-        case EXP:
-            fprintf(ostream, "exp\n");
-            break;
-        case ARCSIN:
-            fprintf(ostream, "arcsin\n");
-            break;
-        case ARCCOS:
-            fprintf(ostream, "arccos\n");
-            break;
-        case ARCTG:
-            fprintf(ostream, "arctg\n");
-            break;
-        case ARCCTG:
-            fprintf(ostream, "arcctg\n");
-            break;
-        case ARCCH:
-            fprintf(ostream, "arcch\n");
-            break;
-        case ARCSH:
-            fprintf(ostream, "arcsh\n");
-            break;
-        case ARCTH:
-            fprintf(ostream, "arcth\n");
-            break;
-        case ARCCTH:
-            fprintf(ostream, "arccth\n");
-            break;
-        case SIN:
-            fprintf(ostream, "sin\n");
-            break;
-        case COS:
-            fprintf(ostream, "cos\n");
-            break;
-        case TG:
-            fprintf(ostream, "tg\n");
-            break;
-        case CTG:
-            fprintf(ostream, "ctg\n");
-            break;
-        case SH:
-            fprintf(ostream, "sh\n");
-            break;
-        case CH:
-            fprintf(ostream, "ch\n");
-            break;
-        case TH:
-            fprintf(ostream, "th\n");
-            break;
-        case CTH:
-            fprintf(ostream, "cth\n");
-            break;
-
-    }
+static spu_label_t func_label(const char* name) {
+    spu_label_t label = {};
+    label.kind = SPU_LABEL_FUNC;
+    label.name = name;
+    return label;
 }
 
 void backend_t::set_dump_ostream(FILE* ostream) {
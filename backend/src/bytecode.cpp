@@ -0,0 +1,470 @@
+#include <assert.h>
+#include <string.h>
+#include "bytecode.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+static const char* bc_op_name(uint32_t op);
+
+err_t bytecode_t::compile(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    tree_ = tree;
+    names_amount_ = tree->var_nametable_size();
+
+    for (node_t* list = tree->root_; list != nullptr; list = list->right) {
+        funcs_amount_++;
+    }
+
+    funcs_         = (bc_func_t*) calloc(funcs_amount_ + 1, sizeof(bc_func_t));
+    func_by_name_  = (size_t*)    calloc(names_amount_ + 1, sizeof(size_t));
+    regs_by_name_  = (uint32_t*)  calloc(names_amount_ + 1, sizeof(uint32_t));
+    if (funcs_ == nullptr || func_by_name_ == nullptr || regs_by_name_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return MEM_ALLOC_ERR;
+    }
+
+    // NOTE - all functions get their indices first, so calls may go forward
+    bool has_main = false;
+    size_t i = 0;
+    for (node_t* list = tree->root_; list != nullptr; list = list->right, i++) {
+        node_t* decl = list->left;
+        if (decl == nullptr || decl->type != OP || (int) decl->value != DECL ||
+            decl->left == nullptr || decl->left->left == nullptr || decl->left->left->type != FUNC) {
+            LOG(ERROR, "Syntax err at %p: expected a function declaration\n", decl);
+            return SYNTAX_ERR;
+        }
+
+        size_t name = (size_t) decl->left->left->value;
+        func_by_name_[name] = i + 1;
+        funcs_[i].name = tree->var_nametable_[name].name;
+
+        for (node_t* params = decl->left->right; next_item(&params) != nullptr;) {
+            funcs_[i].params_amount++;
+        }
+        funcs_[i].params = (uint32_t*) calloc(funcs_[i].params_amount + 1, sizeof(uint32_t));
+        if (funcs_[i].params == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return MEM_ALLOC_ERR;
+        }
+
+        if (strcmp(funcs_[i].name, "main") == 0) {
+            main_ = i;
+            has_main = true;
+        }
+    }
+
+    if (!has_main) {
+        LOG(ERROR, "Function main was not declared\n");
+        return SYNTAX_ERR;
+    }
+
+    i = 0;
+    for (node_t* list = tree->root_; list != nullptr; list = list->right, i++) {
+        err_t error = compile_func(&funcs_[i], list->left);
+        if (error != NO_ERR) {
+            return error;
+        }
+    }
+    return NO_ERR;
+}
+
+void bytecode_t::dtor() {
+    for (size_t i = 0; i < funcs_amount_ && funcs_ != nullptr; i++) {
+        free(funcs_[i].code);
+        free(funcs_[i].consts);
+        free(funcs_[i].params);
+    }
+    free(funcs_);
+    funcs_ = nullptr;
+    funcs_amount_ = 0;
+
+    free(func_by_name_);
+    func_by_name_ = nullptr;
+    free(regs_by_name_);
+    regs_by_name_ = nullptr;
+    names_amount_ = 0;
+}
+
+void bytecode_t::print(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    for (size_t i = 0; i < funcs_amount_; i++) {
+        bc_func_t* func = &funcs_[i];
+        fprintf(ostream, "%s: regs = %zu, params = %zu\n", func->name, func->regs_amount, func->params_amount);
+
+        for (size_t ip = 0; ip < func->code_size; ip++) {
+            bc_instr_t* instr = &func->code[ip];
+            fprintf(ostream, "\t%4zu: %-6s %u %u %u", ip, bc_op_name(instr->op), instr->a, instr->b, instr->c);
+            if (instr->op == BC_LOADK) {
+                fprintf(ostream, " (%lg)", func->consts[instr->b]);
+            }
+            fprintf(ostream, "\n");
+        }
+    }
+}
+
+//=========================================================================================
+
+err_t bytecode_t::compile_func(bc_func_t* func, node_t* decl) {
+    if (!assign_var_regs(func, decl)) {
+        return SYNTAX_ERR;
+    }
+
+    if (!compile_list(func, decl->right)) {
+        LOG(ERROR, "Failed to compile function %s\n", func->name);
+        return SYNTAX_ERR;
+    }
+    if (emit(func, BC_RET, 0, 0, 0) == BC_NO_INSTR) {
+        return MEM_ALLOC_ERR;
+    }
+
+    func->regs_amount = temps_base_ + temps_max_;
+    return NO_ERR;
+}
+
+// NOTE - variables take the first registers (parameters in order), temporaries follow them
+bool bytecode_t::assign_var_regs(bc_func_t* func, node_t* decl) {
+    for (size_t i = 0; i < names_amount_; i++) {
+        regs_by_name_[i] = BC_NO_REG;
+    }
+
+    uint32_t regs = 0;
+    size_t i = 0;
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr; i++) {
+        if (param->type != VAR) {
+            LOG(ERROR, "Syntax err at %p: expected a parameter\n", param);
+            return false;
+        }
+
+        if (regs_by_name_[(size_t) param->value] == BC_NO_REG) {
+            regs_by_name_[(size_t) param->value] = regs++;
+        }
+        func->params[i] = regs_by_name_[(size_t) param->value];
+    }
+
+    tree_walk_t walk = {};
+    walk.init(decl->right);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        node_t* node = step.node;
+        if (step.event != WALK_ENTER || node->type != VAR) {
+            continue;
+        }
+
+        bool is_callee = node->parent != nullptr && node->parent->type == OP &&
+                         (int) node->parent->value == CALL && node->parent->right == node;
+        if (!is_callee && regs_by_name_[(size_t) node->value] == BC_NO_REG) {
+            regs_by_name_[(size_t) node->value] = regs++;
+        }
+    }
+    bool is_ok = !walk.is_alloc_err();
+    walk.dtor();
+    if (!is_ok) {
+        return false;
+    }
+
+    temps_base_ = regs;
+    temps_used_ = 0;
+    temps_max_  = 0;
+    return true;
+}
+
+bool bytecode_t::compile_list(bc_func_t* func, node_t* list) {
+    while (list != nullptr && list->type == OP && (int) list->value == SEMICOLON) {
+        if (!compile_stmt(func, list->left)) {
+            return false;
+        }
+        list = list->right;
+    }
+    return true;
+}
+
+bool bytecode_t::compile_stmt(bc_func_t* func, node_t* stmt) {
+    if (stmt == nullptr) {
+        return true;
+    }
+    if (stmt->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a statement\n", stmt);
+        return false;
+    }
+
+    // NOTE - temporaries live only inside one statement
+    temps_used_ = 0;
+
+    bool is_ok = true;
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            is_ok = compile_stmt(func, stmt->left);
+            break;
+        case EQ: {
+            uint32_t dst = var_reg(stmt->left);
+            is_ok = dst != BC_NO_REG && compile_expr_to(func, stmt->right, dst);
+            break;
+        }
+        case CALL:
+            is_ok = compile_call(func, stmt);
+            break;
+        case RETURN:
+            is_ok = emit(func, BC_RET, 0, 0, 0) != BC_NO_INSTR;
+            break;
+        case IF:
+            is_ok = compile_if(func, stmt, nullptr);
+            break;
+        case SEMICOLON:
+            is_ok = compile_if(func, stmt->left, stmt->right);
+            break;
+        case IN: {
+            uint32_t dst = var_reg(stmt->left);
+            is_ok = dst != BC_NO_REG && emit(func, BC_IN, dst, 0, 0) != BC_NO_INSTR;
+            break;
+        }
+        case OUT: {
+            uint32_t src = compile_expr(func, stmt->left);
+            is_ok = src != BC_NO_REG && emit(func, BC_OUT, src, 0, 0) != BC_NO_INSTR;
+            break;
+        }
+        default:
+            LOG(ERROR, "Unsupported statement %s at %p\n", op_to_name((int) stmt->value), stmt);
+            is_ok = false;
+            break;
+    }
+
+    return is_ok;
+}
+
+bool bytecode_t::compile_if(bc_func_t* func, node_t* if_node, node_t* else_node) {
+    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF ||
+        if_node->left == nullptr || if_node->left->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected if\n", if_node);
+        return false;
+    }
+
+    node_t* cmp = if_node->left;
+    uint32_t lhs = compile_expr(func, cmp->left);
+    uint32_t rhs = compile_expr(func, cmp->right);
+    if (lhs == BC_NO_REG || rhs == BC_NO_REG) {
+        return false;
+    }
+
+    // NOTE - jump over the if body when the condition is false, the negated jumps
+    //        are taken on NaN the way the interpreter finds the condition false
+    bc_op_t jump = BC_JMP;
+    switch ((int) cmp->value) {
+        case IE:   jump = BC_JNE;  break;
+        case INE:  jump = BC_JE;   break;
+        case IA:   jump = BC_JNA;  break;
+        case IAEQ: jump = BC_JNAE; break;
+        case IB:   jump = BC_JNB;  break;
+        case IBEQ: jump = BC_JNBE; break;
+        default:
+            LOG(ERROR, "Unknown comparison %s\n", op_to_name((int) cmp->value));
+            return false;
+    }
+    size_t skip_if = emit(func, jump, 0, lhs, rhs);
+    if (skip_if == BC_NO_INSTR || !compile_list(func, if_node->right)) {
+        return false;
+    }
+
+    if (else_node == nullptr) {
+        func->code[skip_if].a = (uint32_t) func->code_size;
+        return true;
+    }
+
+    size_t skip_else = emit(func, BC_JMP, 0, 0, 0);
+    if (skip_else == BC_NO_INSTR) {
+        return false;
+    }
+    func->code[skip_if].a = (uint32_t) func->code_size;
+
+    if (!compile_list(func, else_node->left)) {
+        return false;
+    }
+    func->code[skip_else].a = (uint32_t) func->code_size;
+    return true;
+}
+
+bool bytecode_t::compile_call(bc_func_t* func, node_t* call) {
+    node_t* name = call->right;
+    if (name == nullptr || name->value < 0 || (size_t) name->value >= names_amount_ ||
+        func_by_name_[(size_t) name->value] == 0) {
+        LOG(ERROR, "Call of an undeclared function at %p\n", call);
+        return false;
+    }
+    size_t callee = func_by_name_[(size_t) name->value] - 1;
+
+    // NOTE - arguments go to consecutive temporaries, reserved before any of them
+    //        is compiled since an argument expression takes temporaries of its own
+    uint32_t amount = 0;
+    for (node_t* args = call->left; next_item(&args) != nullptr;) {
+        amount++;
+    }
+
+    uint32_t first = temps_base_ + temps_used_;
+    for (uint32_t i = 0; i < amount; i++) {
+        new_temp(func);
+    }
+
+    uint32_t i = 0;
+    for (node_t* args = call->left, *arg = nullptr; (arg = next_item(&args)) != nullptr; i++) {
+        if (!compile_expr_to(func, arg, first + i)) {
+            return false;
+        }
+    }
+
+    if (amount != funcs_[callee].params_amount) {
+        LOG(ERROR, "Function %s takes %zu arguments, %u given\n",
+                   funcs_[callee].name, funcs_[callee].params_amount, amount);
+        return false;
+    }
+
+    return emit(func, BC_CALL, (uint32_t) callee, first, amount) != BC_NO_INSTR;
+}
+
+uint32_t bytecode_t::compile_expr(bc_func_t* func, node_t* node) {
+    if (node != nullptr && node->type == VAR) {
+        return var_reg(node);
+    }
+
+    uint32_t dst = new_temp(func);
+    return compile_expr_to(func, node, dst) ? dst : BC_NO_REG;
+}
+
+bool bytecode_t::compile_expr_to(bc_func_t* func, node_t* node, uint32_t dst) {
+    if (node == nullptr) {
+        LOG(ERROR, "Missing operand\n");
+        return false;
+    }
+
+    switch (node->type) {
+        case NUM: {
+            uint32_t index = add_const(func, node->value);
+            return index != BC_NO_CONST && emit(func, BC_LOADK, dst, index, 0) != BC_NO_INSTR;
+        }
+        case VAR: {
+            uint32_t src = var_reg(node);
+            if (src == BC_NO_REG) {
+                return false;
+            }
+            return emit(func, BC_MOV, dst, src, 0) != BC_NO_INSTR;
+        }
+        case OP:
+            break;
+        case FUNC:
+        default:
+            LOG(ERROR, "Unexpected node %d in an expression\n", node->type);
+            return false;
+    }
+
+    uint32_t lhs = compile_expr(func, node->left);
+    if (lhs == BC_NO_REG) {
+        return false;
+    }
+
+    if (node->right == nullptr) {
+        switch ((int) node->value) {
+            case SUB:
+                return emit(func, BC_NEG, dst, lhs, 0) != BC_NO_INSTR;
+            case ADD:
+                return emit(func, BC_MOV, dst, lhs, 0) != BC_NO_INSTR;
+            default:
+                return emit(func, BC_MATH, dst, lhs, (uint32_t) node->value) != BC_NO_INSTR;
+        }
+    }
+
+    uint32_t rhs = compile_expr(func, node->right);
+    if (rhs == BC_NO_REG) {
+        return false;
+    }
+
+    switch ((int) node->value) {
+        case ADD: return emit(func, BC_ADD, dst, lhs, rhs) != BC_NO_INSTR;
+        case SUB: return emit(func, BC_SUB, dst, lhs, rhs) != BC_NO_INSTR;
+        case MUL: return emit(func, BC_MUL, dst, lhs, rhs) != BC_NO_INSTR;
+        case DIV: return emit(func, BC_DIV, dst, lhs, rhs) != BC_NO_INSTR;
+        case POW: return emit(func, BC_POW, dst, lhs, rhs) != BC_NO_INSTR;
+        case LOG: return emit(func, BC_LOG, dst, lhs, rhs) != BC_NO_INSTR;
+        default:
+            LOG(ERROR, "Unsupported binary operation %s\n", op_to_name((int) node->value));
+            return false;
+    }
+}
+
+uint32_t bytecode_t::new_temp(bc_func_t* func) {
+    (void) func;
+
+    temps_used_++;
+    if (temps_used_ > temps_max_) {
+        temps_max_ = temps_used_;
+    }
+    return temps_base_ + temps_used_ - 1;
+}
+
+// NOTE - argument and parameter lists end either with nullptr or with a bare last item
+node_t* bytecode_t::next_item(node_t** list) {
+    node_t* node = *list;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->type == OP && (int) node->value == SEMICOLON) {
+        *list = node->right;
+        return node->left;
+    }
+    *list = nullptr;
+    return node;
+}
+
+uint32_t bytecode_t::var_reg(node_t* var) {
+    if (var == nullptr || var->type != VAR || var->value < 0 || (size_t) var->value >= names_amount_ ||
+        regs_by_name_[(size_t) var->value] == BC_NO_REG) {
+        LOG(ERROR, "Expected a variable at %p\n", var);
+        return BC_NO_REG;
+    }
+    return regs_by_name_[(size_t) var->value];
+}
+
+size_t bytecode_t::emit(bc_func_t* func, bc_op_t op, uint32_t a, uint32_t b, uint32_t c) {
+    if (func->code_size == func->code_capacity) {
+        size_t capacity = (func->code_capacity == 0) ? BC_CODE_MIN_CAPACITY : func->code_capacity * 2;
+        bc_instr_t* code = (bc_instr_t*) realloc(func->code, sizeof(bc_instr_t) * capacity);
+        if (code == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return BC_NO_INSTR;
+        }
+        func->code = code;
+        func->code_capacity = capacity;
+    }
+
+    bc_instr_t* instr = &func->code[func->code_size];
+    instr->op = op;
+    instr->a  = a;
+    instr->b  = b;
+    instr->c  = c;
+    return func->code_size++;
+}
+
+uint32_t bytecode_t::add_const(bc_func_t* func, double value) {
+    if (func->consts_size == func->consts_capacity) {
+        size_t capacity = (func->consts_capacity == 0) ? BC_CODE_MIN_CAPACITY : func->consts_capacity * 2;
+        double* consts = (double*) realloc(func->consts, sizeof(double) * capacity);
+        if (consts == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return BC_NO_CONST;
+        }
+        func->consts = consts;
+        func->consts_capacity = capacity;
+    }
+
+    func->consts[func->consts_size] = value;
+    return (uint32_t) func->consts_size++;
+}
+
+static const char* bc_op_name(uint32_t op) {
+    static const char* names[BC_OPS_AMOUNT] = {
+        "loadk", "mov", "neg", "add", "sub", "mul", "div", "pow", "log", "math",
+        "jmp", "je", "jne", "jna", "jnae", "jnb", "jnbe", "in", "out", "call", "ret"};
+
+    return (op < BC_OPS_AMOUNT) ? names[op] : "?";
+}
@@ -0,0 +1,800 @@
+#include <assert.h>
+#include <string.h>
+#include "ir.h"
+#include "logger.h"
+
+static ir_operand_t const_operand(double num);
+static ir_operand_t value_operand(size_t value);
+static void print_operand(FILE* ostream, const ir_operand_t* operand);
+
+err_t ir_t::build(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    node_t* decls = tree->root_;
+    while (decls != nullptr && decls->left != nullptr) {
+        if (build_func(tree, decls->left) == nullptr) {
+            return SYNTAX_ERR;
+        }
+        decls = decls->right;
+    }
+
+    LOG(INFO, "Lowered %zu functions to IR\n", funcs_amount_);
+    return NO_ERR;
+}
+
+// NOTE - only reads the tree, so separate ir_t may lower functions of one tree at once
+ir_func_t* ir_t::build_func(prog_tree_t* tree, node_t* decl) {
+    assert(tree != nullptr);
+    assert(decl != nullptr);
+
+    tree_ = tree;
+    names_amount_ = tree->var_nametable_size();
+
+    ir_func_t* func = new_func();
+    if (func == nullptr || !lower_func(func, decl)) {
+        return nullptr;
+    }
+
+    if (!link_blocks(func) || !remove_unreachable(func) || !split_critical_edges(func) ||
+        !build_ssa(func) || !optimize(func)) {
+        return nullptr;
+    }
+    return func;
+}
+
+void ir_t::dtor() {
+    for (size_t i = 0; i < funcs_amount_; i++) {
+        ir_func_t* func = &funcs_[i];
+        for (size_t j = 0; j < func->blocks_size; j++) {
+            ir_block_t* block = &func->blocks[j];
+            for (size_t k = 0; k < block->size; k++) {
+                free(block->instrs[k].list);
+            }
+            free(block->instrs);
+            free(block->preds);
+        }
+        free(func->blocks);
+        free(func->params);
+    }
+    free(funcs_);
+    funcs_ = nullptr;
+    funcs_amount_ = 0;
+
+    free(defs_);
+    defs_ = nullptr;
+    free(undo_vars_);
+    undo_vars_ = nullptr;
+    free(undo_values_);
+    undo_values_ = nullptr;
+    undo_size_ = 0;
+    undo_capacity_ = 0;
+}
+
+//=========================================================================================
+
+ir_func_t* ir_t::new_func() {
+    if (funcs_amount_ % IR_FUNCS_MIN_CAPACITY == 0) {
+        ir_func_t* funcs = (ir_func_t*) realloc(funcs_, sizeof(ir_func_t) * (funcs_amount_ + IR_FUNCS_MIN_CAPACITY));
+        if (funcs == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return nullptr;
+        }
+        funcs_ = funcs;
+    }
+
+    ir_func_t* func = &funcs_[funcs_amount_++];
+    memset(func, 0, sizeof(ir_func_t));
+    return func;
+}
+
+size_t ir_t::new_block(ir_func_t* func) {
+    if (func->blocks_size == func->blocks_capacity) {
+        size_t capacity = (func->blocks_capacity == 0) ? IR_BLOCKS_MIN_CAPACITY : func->blocks_capacity * 2;
+        ir_block_t* blocks = (ir_block_t*) realloc(func->blocks, sizeof(ir_block_t) * capacity);
+        if (blocks == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return IR_NO_BLOCK;
+        }
+        func->blocks = blocks;
+        func->blocks_capacity = capacity;
+    }
+
+    ir_block_t* block = &func->blocks[func->blocks_size];
+    memset(block, 0, sizeof(ir_block_t));
+    block->idom = IR_NO_BLOCK;
+    return func->blocks_size++;
+}
+
+ir_instr_t* ir_t::add_instr(ir_func_t* func, size_t block_index, ir_opcode_t opcode) {
+    ir_block_t* block = &func->blocks[block_index];
+    if (block->size == block->capacity) {
+        size_t capacity = (block->capacity == 0) ? IR_INSTRS_MIN_CAPACITY : block->capacity * 2;
+        ir_instr_t* instrs = (ir_instr_t*) realloc(block->instrs, sizeof(ir_instr_t) * capacity);
+        if (instrs == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return nullptr;
+        }
+        block->instrs = instrs;
+        block->capacity = capacity;
+    }
+
+    ir_instr_t* instr = &block->instrs[block->size++];
+    memset(instr, 0, sizeof(ir_instr_t));
+    instr->opcode = opcode;
+    instr->dst = IR_NO_VALUE;
+    instr->targets[0] = IR_NO_BLOCK;
+    instr->targets[1] = IR_NO_BLOCK;
+    return instr;
+}
+
+size_t ir_t::new_value(ir_func_t* func) {
+    return func->values_amount++;
+}
+
+bool ir_t::is_terminated(ir_func_t* func, size_t block_index) {
+    ir_block_t* block = &func->blocks[block_index];
+    if (block->size == 0) {
+        return false;
+    }
+
+    ir_opcode_t opcode = block->instrs[block->size - 1].opcode;
+    return opcode == IR_BR || opcode == IR_JMP || opcode == IR_RET;
+}
+
+// NOTE - falls from the current block to target unless it has already left
+bool ir_t::terminate(ir_func_t* func, size_t target) {
+    if (is_terminated(func, current_)) {
+        return true;
+    }
+
+    ir_instr_t* jmp = add_instr(func, current_, IR_JMP);
+    if (jmp == nullptr) {
+        return false;
+    }
+    jmp->targets[0] = target;
+    return true;
+}
+
+static ir_operand_t const_operand(double num) {
+    ir_operand_t operand = {};
+    operand.kind = IR_CONST;
+    operand.num  = num;
+    return operand;
+}
+
+static ir_operand_t value_operand(size_t value) {
+    ir_operand_t operand = {};
+    operand.kind  = IR_VALUE;
+    operand.value = value;
+    return operand;
+}
+
+//=========================================================================================
+
+bool ir_t::lower_func(ir_func_t* func, node_t* decl) {
+    if (decl->left == nullptr || decl->left->type != OP || (int) decl->left->value != SPEC ||
+        decl->left->left == nullptr || decl->left->left->type != FUNC) {
+        LOG(ERROR, "Syntax err at %p: expected a function declaration\n", decl);
+        return false;
+    }
+
+    func->name = tree_->var_nametable_[(size_t) decl->left->left->value].name;
+    func->values_amount = names_amount_;
+
+    size_t params_amount = 0;
+    for (node_t* params = decl->left->right; next_item(&params) != nullptr;) {
+        params_amount++;
+    }
+
+    func->params = (size_t*) calloc(params_amount + 1, sizeof(size_t));
+    if (func->params == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr;) {
+        size_t value = var_value(param);
+        if (value == IR_NO_VALUE) {
+            return false;
+        }
+        func->params[func->params_amount++] = value;
+    }
+
+    current_ = new_block(func);
+    if (current_ == IR_NO_BLOCK || !lower_list(func, decl->right)) {
+        LOG(ERROR, "Failed to lower function %s\n", func->name);
+        return false;
+    }
+
+    // NOTE - falling off the end of a function returns from it
+    if (!is_terminated(func, current_)) {
+        return add_instr(func, current_, IR_RET) != nullptr;
+    }
+    return true;
+}
+
+bool ir_t::lower_list(ir_func_t* func, node_t* list) {
+    while (list != nullptr && list->type == OP && (int) list->value == SEMICOLON) {
+        if (!lower_stmt(func, list->left)) {
+            return false;
+        }
+        list = list->right;
+    }
+    return true;
+}
+
+bool ir_t::lower_stmt(ir_func_t* func, node_t* stmt) {
+    if (stmt == nullptr) {
+        return true;
+    }
+    if (stmt->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a statement\n", stmt);
+        return false;
+    }
+
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            return lower_stmt(func, stmt->left);
+        case EQ: {
+            size_t dst = var_value(stmt->left);
+            ir_operand_t src = lower_expr(func, stmt->right);
+            if (dst == IR_NO_VALUE || src.kind == IR_NONE) {
+                return false;
+            }
+
+            ir_instr_t* instr = add_instr(func, current_, IR_MOV);
+            if (instr == nullptr) {
+                return false;
+            }
+            instr->dst = dst;
+            instr->a   = src;
+            return true;
+        }
+        case CALL:
+            return lower_call(func, stmt);
+        case RETURN:
+            // NOTE - whatever follows a return goes to a block nobody jumps to
+            if (add_instr(func, current_, IR_RET) == nullptr) {
+                return false;
+            }
+            current_ = new_block(func);
+            return current_ != IR_NO_BLOCK;
+        case IF:
+            return lower_if(func, stmt, nullptr);
+        case SEMICOLON:
+            return lower_if(func, stmt->left, stmt->right);
+        case IN: {
+            size_t dst = var_value(stmt->left);
+            if (dst == IR_NO_VALUE) {
+                return false;
+            }
+            ir_instr_t* instr = add_instr(func, current_, IR_IN);
+            if (instr == nullptr) {
+                return false;
+            }
+            instr->dst = dst;
+            return true;
+        }
+        case OUT: {
+            ir_operand_t src = lower_expr(func, stmt->left);
+            if (src.kind == IR_NONE) {
+                return false;
+            }
+            ir_instr_t* instr = add_instr(func, current_, IR_OUT);
+            if (instr == nullptr) {
+                return false;
+            }
+            instr->a = src;
+            return true;
+        }
+        default:
+            LOG(ERROR, "Unsupported statement %s at %p\n", op_to_name((int) stmt->value), stmt);
+            return false;
+    }
+}
+
+// NOTE - blocks are created in the order they are laid out: condition, if body,
+//        else body, then the block both of them fall into
+bool ir_t::lower_if(ir_func_t* func, node_t* if_node, node_t* else_node) {
+    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF ||
+        if_node->left == nullptr || if_node->left->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected if\n", if_node);
+        return false;
+    }
+    if (else_node != nullptr && (else_node->type != OP || (int) else_node->value != ELSE)) {
+        LOG(ERROR, "Syntax err at %p: expected else\n", else_node);
+        return false;
+    }
+
+    node_t* cmp = if_node->left;
+    switch ((int) cmp->value) {
+        case IE:
+        case INE:
+        case IA:
+        case IAEQ:
+        case IB:
+        case IBEQ:
+            break;
+        default:
+            LOG(ERROR, "Unknown comparison %s\n", op_to_name((int) cmp->value));
+            return false;
+    }
+
+    ir_operand_t lhs = lower_expr(func, cmp->left);
+    ir_operand_t rhs = lower_expr(func, cmp->right);
+    if (lhs.kind == IR_NONE || rhs.kind == IR_NONE) {
+        return false;
+    }
+
+    size_t cond = current_;
+    size_t branch_index = func->blocks[cond].size;
+    ir_instr_t* branch = add_instr(func, cond, IR_BR);
+    if (branch == nullptr) {
+        return false;
+    }
+    branch->op = (int) cmp->value;
+    branch->a  = lhs;
+    branch->b  = rhs;
+
+    size_t if_block = new_block(func);
+    if (if_block == IR_NO_BLOCK) {
+        return false;
+    }
+    func->blocks[cond].instrs[branch_index].targets[0] = if_block;
+    current_ = if_block;
+    if (!lower_list(func, if_node->right)) {
+        return false;
+    }
+    size_t if_end = current_;
+
+    size_t else_end = IR_NO_BLOCK;
+    if (else_node != nullptr) {
+        size_t else_block = new_block(func);
+        if (else_block == IR_NO_BLOCK) {
+            return false;
+        }
+        func->blocks[cond].instrs[branch_index].targets[1] = else_block;
+        current_ = else_block;
+        if (!lower_list(func, else_node->left)) {
+            return false;
+        }
+        else_end = current_;
+    }
+
+    size_t join = new_block(func);
+    if (join == IR_NO_BLOCK) {
+        return false;
+    }
+    if (else_node == nullptr) {
+        func->blocks[cond].instrs[branch_index].targets[1] = join;
+    }
+    else {
+        current_ = else_end;
+        if (!terminate(func, join)) {
+            return false;
+        }
+    }
+    current_ = if_end;
+    if (!terminate(func, join)) {
+        return false;
+    }
+
+    current_ = join;
+    return true;
+}
+
+bool ir_t::lower_call(ir_func_t* func, node_t* call) {
+    node_t* name = call->right;
+    if (name == nullptr || name->value < 0 || (size_t) name->value >= names_amount_) {
+        LOG(ERROR, "Call of an unknown function at %p\n", call);
+        return false;
+    }
+
+    size_t amount = 0;
+    for (node_t* args = call->left; next_item(&args) != nullptr;) {
+        amount++;
+    }
+
+    ir_operand_t* list = (ir_operand_t*) calloc(amount + 1, sizeof(ir_operand_t));
+    if (list == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    size_t i = 0;
+    for (node_t* args = call->left, *arg = nullptr; (arg = next_item(&args)) != nullptr; i++) {
+        list[i] = lower_expr(func, arg);
+        if (list[i].kind == IR_NONE) {
+            free(list);
+            return false;
+        }
+    }
+
+    ir_instr_t* instr = add_instr(func, current_, IR_CALL);
+    if (instr == nullptr) {
+        free(list);
+        return false;
+    }
+    instr->func      = (size_t) name->value;
+    instr->list      = list;
+    instr->list_size = amount;
+    return true;
+}
+
+ir_operand_t ir_t::lower_expr(ir_func_t* func, node_t* node) {
+    ir_operand_t none = {};
+    if (node == nullptr) {
+        LOG(ERROR, "Missing operand\n");
+        return none;
+    }
+
+    switch (node->type) {
+        case NUM:
+            return const_operand(node->value);
+        case VAR: {
+            size_t value = var_value(node);
+            return (value == IR_NO_VALUE) ? none : value_operand(value);
+        }
+        case OP:
+            break;
+        case FUNC:
+        default:
+            LOG(ERROR, "Unexpected node %d in an expression\n", node->type);
+            return none;
+    }
+
+    ir_operand_t lhs = lower_expr(func, node->left);
+    if (lhs.kind == IR_NONE) {
+        return none;
+    }
+
+    if (node->right == nullptr) {
+        if ((int) node->value == ADD) {
+            return lhs;
+        }
+
+        ir_instr_t* instr = add_instr(func, current_, ((int) node->value == SUB) ? IR_NEG : IR_MATH);
+        if (instr == nullptr) {
+            return none;
+        }
+        instr->op  = (int) node->value;
+        instr->a   = lhs;
+        instr->dst = new_value(func);
+        return value_operand(instr->dst);
+    }
+
+    ir_operand_t rhs = lower_expr(func, node->right);
+    if (rhs.kind == IR_NONE) {
+        return none;
+    }
+
+    ir_opcode_t opcode = IR_MOV;
+    switch ((int) node->value) {
+        case ADD: opcode = IR_ADD; break;
+        case SUB: opcode = IR_SUB; break;
+        case MUL: opcode = IR_MUL; break;
+        case DIV: opcode = IR_DIV; break;
+        case POW: opcode = IR_POW; break;
+        case LOG: opcode = IR_LOG; break;
+        default:
+            LOG(ERROR, "Unsupported binary operation %s\n", op_to_name((int) node->value));
+            return none;
+    }
+
+    ir_instr_t* instr = add_instr(func, current_, opcode);
+    if (instr == nullptr) {
+        return none;
+    }
+    instr->a   = lhs;
+    instr->b   = rhs;
+    instr->dst = new_value(func);
+    return value_operand(instr->dst);
+}
+
+size_t ir_t::var_value(node_t* var) {
+    if (var == nullptr || var->type != VAR || var->value < 0 || (size_t) var->value >= names_amount_) {
+        LOG(ERROR, "Expected a variable at %p\n", var);
+        return IR_NO_VALUE;
+    }
+    return (size_t) var->value;
+}
+
+// NOTE - argument and parameter lists end either with nullptr or with a bare last item
+node_t* ir_t::next_item(node_t** list) {
+    node_t* node = *list;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->type == OP && (int) node->value == SEMICOLON) {
+        *list = node->right;
+        return node->left;
+    }
+    *list = nullptr;
+    return node;
+}
+
+//=========================================================================================
+
+// NOTE - successors come from the terminators, predecessors are listed in block order
+bool ir_t::link_blocks(ir_func_t* func) {
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        func->blocks[i].preds_size = 0;
+        func->blocks[i].succs_size = 0;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        if (block->size == 0) {
+            continue;
+        }
+
+        ir_instr_t* last = &block->instrs[block->size - 1];
+        size_t targets = (last->opcode == IR_BR) ? 2 : (last->opcode == IR_JMP) ? 1 : 0;
+        for (size_t j = 0; j < targets; j++) {
+            block->succs[block->succs_size++] = last->targets[j];
+            if (!add_pred(&func->blocks[last->targets[j]], i)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ir_t::add_pred(ir_block_t* block, size_t pred) {
+    if (block->preds_size == block->preds_capacity) {
+        size_t capacity = (block->preds_capacity == 0) ? 2 : block->preds_capacity * 2;
+        size_t* preds = (size_t*) realloc(block->preds, sizeof(size_t) * capacity);
+        if (preds == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        block->preds = preds;
+        block->preds_capacity = capacity;
+    }
+    block->preds[block->preds_size++] = pred;
+    return true;
+}
+
+// NOTE - code after a return is dropped here, the layout order of the rest is kept
+bool ir_t::remove_unreachable(ir_func_t* func) {
+    size_t* index = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* stack = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    if (index == nullptr || stack == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(index);
+        free(stack);
+        return false;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        index[i] = IR_NO_BLOCK;
+    }
+
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+    index[0] = 0;
+    while (stack_size > 0) {
+        ir_block_t* block = &func->blocks[stack[--stack_size]];
+        for (size_t i = 0; i < block->succs_size; i++) {
+            if (index[block->succs[i]] == IR_NO_BLOCK) {
+                index[block->succs[i]] = 0;
+                stack[stack_size++] = block->succs[i];
+            }
+        }
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        if (index[i] == IR_NO_BLOCK) {
+            for (size_t j = 0; j < func->blocks[i].size; j++) {
+                free(func->blocks[i].instrs[j].list);
+            }
+            free(func->blocks[i].instrs);
+            free(func->blocks[i].preds);
+            continue;
+        }
+        index[i] = size;
+        func->blocks[size++] = func->blocks[i];
+    }
+    func->blocks_size = size;
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        ir_instr_t* last = &block->instrs[block->size - 1];
+        for (size_t j = 0; j < 2; j++) {
+            if (last->targets[j] != IR_NO_BLOCK) {
+                last->targets[j] = index[last->targets[j]];
+            }
+        }
+    }
+
+    free(stack);
+    free(index);
+    return link_blocks(func);
+}
+
+// NOTE - an edge from a branch to a block with several predecessors gets a block
+//        of its own, so leave_ssa() always has a place for the copies of phis.
+//        The new block is laid out right before the one it jumps to
+bool ir_t::split_critical_edges(ir_func_t* func) {
+    size_t blocks_size = func->blocks_size;
+    size_t edges = 0;
+    for (size_t i = 0; i < blocks_size; i++) {
+        for (size_t j = 0; func->blocks[i].succs_size == 2 && j < 2; j++) {
+            edges += func->blocks[func->blocks[i].succs[j]].preds_size > 1;
+        }
+    }
+    if (edges == 0) {
+        return true;
+    }
+
+    ir_block_t* old_blocks = func->blocks;
+    size_t* index   = (size_t*) calloc(blocks_size, sizeof(size_t));
+    size_t* edge_of = (size_t*) calloc(blocks_size * 2, sizeof(size_t));  // edge block + 1 of a branch target
+    func->blocks = (ir_block_t*) calloc(blocks_size + edges, sizeof(ir_block_t));
+    if (index == nullptr || edge_of == nullptr || func->blocks == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(func->blocks);
+        func->blocks = old_blocks;
+        free(edge_of);
+        free(index);
+        return false;
+    }
+    func->blocks_size = 0;
+    func->blocks_capacity = blocks_size + edges;
+
+    for (size_t i = 0; i < blocks_size; i++) {
+        for (size_t j = 0; old_blocks[i].preds_size > 1 && j < old_blocks[i].preds_size; j++) {
+            size_t pred = old_blocks[i].preds[j];
+            if (old_blocks[pred].succs_size != 2) {
+                continue;
+            }
+
+            size_t slot = (old_blocks[pred].succs[0] == i && edge_of[pred * 2] == 0) ? 0 : 1;
+            size_t edge = new_block(func);
+            ir_instr_t* jump = (edge == IR_NO_BLOCK) ? nullptr : add_instr(func, edge, IR_JMP);
+            if (jump == nullptr) {
+                free(edge_of);
+                free(index);
+                free(old_blocks);
+                return false;
+            }
+            jump->targets[0] = i;
+            edge_of[pred * 2 + slot] = edge + 1;
+        }
+
+        index[i] = func->blocks_size;
+        func->blocks[func->blocks_size++] = old_blocks[i];
+    }
+
+    for (size_t i = 0; i < blocks_size; i++) {
+        ir_block_t* block = &func->blocks[index[i]];
+        ir_instr_t* last = &block->instrs[block->size - 1];
+        for (size_t j = 0; j < 2; j++) {
+            if (last->targets[j] != IR_NO_BLOCK) {
+                last->targets[j] = (edge_of[i * 2 + j] != 0) ? edge_of[i * 2 + j] - 1 : index[last->targets[j]];
+            }
+            if (edge_of[i * 2 + j] != 0) {
+                ir_instr_t* jump = &func->blocks[edge_of[i * 2 + j] - 1].instrs[0];
+                jump->targets[0] = index[jump->targets[0]];
+            }
+        }
+    }
+
+    free(edge_of);
+    free(index);
+    free(old_blocks);
+    return link_blocks(func);
+}
+
+//=========================================================================================
+
+void ir_t::print(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    for (size_t i = 0; i < funcs_amount_; i++) {
+        ir_func_t* func = &funcs_[i];
+        fprintf(ostream, "%s(", func->name);
+        for (size_t j = 0; j < func->params_amount; j++) {
+            fprintf(ostream, (j == 0) ? "v%zu" : ", v%zu", func->params[j]);
+        }
+        fprintf(ostream, "):\n");
+
+        for (size_t j = 0; j < func->blocks_size; j++) {
+            ir_block_t* block = &func->blocks[j];
+            fprintf(ostream, "b%zu:", j);
+            for (size_t k = 0; k < block->preds_size; k++) {
+                fprintf(ostream, (k == 0) ? " ; preds b%zu" : ", b%zu", block->preds[k]);
+            }
+            fprintf(ostream, "\n");
+
+            for (size_t k = 0; k < block->size; k++) {
+                ir_instr_t* instr = &block->instrs[k];
+                fprintf(ostream, "\t");
+                if (instr->dst != IR_NO_VALUE) {
+                    fprintf(ostream, "v%zu = ", instr->dst);
+                }
+
+                if (instr->opcode == IR_MATH) {
+                    fprintf(ostream, "%s", op_to_name(instr->op));
+                }
+                else {
+                    fprintf(ostream, "%s", ir_opcode_name(instr->opcode));
+                }
+                if (instr->opcode == IR_CALL) {
+                    fprintf(ostream, " %s", tree_->var_nametable_[instr->func].name);
+                }
+
+                if (instr->a.kind != IR_NONE) {
+                    fprintf(ostream, " ");
+                    print_operand(ostream, &instr->a);
+                }
+                if (instr->opcode == IR_BR) {
+                    fprintf(ostream, " %s", op_to_name(instr->op));
+                }
+                if (instr->b.kind != IR_NONE) {
+                    fprintf(ostream, (instr->opcode == IR_BR) ? " " : ", ");
+                    print_operand(ostream, &instr->b);
+                }
+                for (size_t l = 0; l < instr->list_size; l++) {
+                    fprintf(ostream, (l == 0) ? " " : ", ");
+                    print_operand(ostream, &instr->list[l]);
+                }
+
+                if (instr->opcode == IR_BR) {
+                    fprintf(ostream, " ? b%zu : b%zu", instr->targets[0], instr->targets[1]);
+                }
+                else if (instr->opcode == IR_JMP) {
+                    fprintf(ostream, " b%zu", instr->targets[0]);
+                }
+                fprintf(ostream, "\n");
+            }
+        }
+        fprintf(ostream, "\n");
+    }
+}
+
+static void print_operand(FILE* ostream, const ir_operand_t* operand) {
+    if (operand->kind == IR_CONST) {
+        fprintf(ostream, "%lg", operand->num);
+    }
+    else if (operand->kind == IR_VALUE) {
+        fprintf(ostream, "v%zu", operand->value);
+    }
+}
+
+const char* ir_opcode_name(ir_opcode_t opcode) {
+    static const char* names[IR_OPCODES_AMOUNT] = {
+        "mov", "add", "sub", "mul", "div", "pow", "log", "neg",
+        "math", "in", "out", "call", "phi", "br", "jmp", "ret"};
+
+    return ((size_t) opcode < IR_OPCODES_AMOUNT) ? names[opcode] : "?";
+}
+
+// NOTE - a and b, then the list
+size_t ir_operands_amount(const ir_instr_t* instr) {
+    return 2 + instr->list_size;
+}
+
+ir_operand_t* ir_operand(ir_instr_t* instr, size_t i) {
+    switch (i) {
+        case 0:  return &instr->a;
+        case 1:  return &instr->b;
+        default: return &instr->list[i - 2];
+    }
+}
+
+// NOTE - constants are compared bitwise, 0 and -0 are different operands
+bool ir_same_operand(const ir_operand_t* operand1, const ir_operand_t* operand2) {
+    if (operand1->kind != operand2->kind) {
+        return false;
+    }
+    if (operand1->kind == IR_CONST) {
+        return memcmp(&operand1->num, &operand2->num, sizeof(double)) == 0;
+    }
+    return operand1->kind == IR_NONE || operand1->value == operand2->value;
+}
+
+bool ir_is_pure(ir_opcode_t opcode) {
+    return opcode <= IR_MATH || opcode == IR_PHI;
+}
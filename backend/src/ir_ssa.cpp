@@ -0,0 +1,519 @@
+#include <assert.h>
+#include <string.h>
+#include "ir.h"
+#include "logger.h"
+
+static void set_bit(uint64_t* set, size_t bit);
+static bool has_bit(const uint64_t* set, size_t bit);
+
+static void set_bit(uint64_t* set, size_t bit) {
+    set[bit / 64] |= (uint64_t) 1 << (bit % 64);
+}
+
+static bool has_bit(const uint64_t* set, size_t bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+// NOTE - reverse postorder of the reachable blocks, the entry comes first
+size_t* ir_t::order_blocks(ir_func_t* func) {
+    size_t* order   = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* stack   = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* next    = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    bool* is_seen   = (bool*) calloc(func->blocks_size, sizeof(bool));
+    if (order == nullptr || stack == nullptr || next == nullptr || is_seen == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(is_seen);
+        free(next);
+        free(stack);
+        free(order);
+        return nullptr;
+    }
+
+    size_t order_size = func->blocks_size;
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+    is_seen[0] = true;
+    while (stack_size > 0) {
+        size_t block = stack[stack_size - 1];
+        if (next[block] < func->blocks[block].succs_size) {
+            size_t succ = func->blocks[block].succs[next[block]++];
+            if (!is_seen[succ]) {
+                is_seen[succ] = true;
+                stack[stack_size++] = succ;
+            }
+            continue;
+        }
+
+        order[--order_size] = block;
+        stack_size--;
+    }
+    assert(order_size == 0);
+
+    free(is_seen);
+    free(next);
+    free(stack);
+    return order;
+}
+
+// NOTE - Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+bool ir_t::find_dominators(ir_func_t* func, size_t* order) {
+    size_t* rpo = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    if (rpo == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        rpo[order[i]] = i;
+        func->blocks[i].idom = IR_NO_BLOCK;
+    }
+    func->blocks[0].idom = 0;
+
+    bool is_changed = true;
+    while (is_changed) {
+        is_changed = false;
+        for (size_t i = 1; i < func->blocks_size; i++) {
+            ir_block_t* block = &func->blocks[order[i]];
+
+            size_t idom = IR_NO_BLOCK;
+            for (size_t j = 0; j < block->preds_size; j++) {
+                size_t pred = block->preds[j];
+                if (func->blocks[pred].idom == IR_NO_BLOCK) {
+                    continue;
+                }
+                if (idom == IR_NO_BLOCK) {
+                    idom = pred;
+                    continue;
+                }
+
+                size_t finger = pred;
+                while (finger != idom) {
+                    while (rpo[finger] > rpo[idom]) finger = func->blocks[finger].idom;
+                    while (rpo[idom] > rpo[finger]) idom = func->blocks[idom].idom;
+                }
+            }
+
+            if (block->idom != idom) {
+                block->idom = idom;
+                is_changed = true;
+            }
+        }
+    }
+
+    free(rpo);
+    return true;
+}
+
+// NOTE - one bitset of blocks per block, words_amount words each
+uint64_t* ir_t::find_frontiers(ir_func_t* func) {
+    size_t words = func->blocks_size / 64 + 1;
+    uint64_t* frontiers = (uint64_t*) calloc(func->blocks_size * words, sizeof(uint64_t));
+    if (frontiers == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        if (block->preds_size < 2) {
+            continue;
+        }
+
+        for (size_t j = 0; j < block->preds_size; j++) {
+            for (size_t runner = block->preds[j]; runner != block->idom; runner = func->blocks[runner].idom) {
+                set_bit(&frontiers[runner * words], i);
+            }
+        }
+    }
+    return frontiers;
+}
+
+// NOTE - minimal SSA: a variable gets a phi in the iterated dominance frontier of
+//        its assignments, the phis nobody reads are removed by remove_dead_code()
+bool ir_t::place_phis(ir_func_t* func, uint64_t* frontiers) {
+    size_t words = func->blocks_size / 64 + 1;
+
+    // NOTE - blocks assigning every variable, grouped by the variable
+    size_t* first = (size_t*) calloc(names_amount_ + 1, sizeof(size_t));
+    size_t sites_amount = func->params_amount;
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        for (size_t j = 0; j < func->blocks[i].size; j++) {
+            sites_amount += func->blocks[i].instrs[j].dst < names_amount_;
+        }
+    }
+    size_t* sites    = (size_t*) calloc(sites_amount + 1, sizeof(size_t));
+    size_t* worklist = (size_t*) calloc(func->blocks_size + sites_amount + 1, sizeof(size_t));
+    size_t* has_phi  = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* in_work  = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    bool is_ok = first != nullptr && sites != nullptr && worklist != nullptr && has_phi != nullptr && in_work != nullptr;
+    if (!is_ok) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(in_work);
+        free(has_phi);
+        free(worklist);
+        free(sites);
+        free(first);
+        return false;
+    }
+
+    for (size_t i = 0; i < func->params_amount; i++) {
+        first[func->params[i] + 1]++;
+    }
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        for (size_t j = 0; j < func->blocks[i].size; j++) {
+            size_t dst = func->blocks[i].instrs[j].dst;
+            if (dst < names_amount_) first[dst + 1]++;
+        }
+    }
+    for (size_t i = 0; i < names_amount_; i++) {
+        first[i + 1] += first[i];
+    }
+    for (size_t i = 0; i < func->params_amount; i++) {
+        sites[first[func->params[i]]++] = 0;
+    }
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        for (size_t j = 0; j < func->blocks[i].size; j++) {
+            size_t dst = func->blocks[i].instrs[j].dst;
+            if (dst < names_amount_) sites[first[dst]++] = i;
+        }
+    }
+    // NOTE - first[var] now points past the sites of var, so they start at first[var - 1]
+
+    for (size_t var = 0; is_ok && var < names_amount_; var++) {
+        size_t begin = (var == 0) ? 0 : first[var - 1];
+        size_t stamp = var + 1;
+
+        size_t work_size = 0;
+        for (size_t i = begin; i < first[var]; i++) {
+            if (in_work[sites[i]] != stamp) {
+                in_work[sites[i]] = stamp;
+                worklist[work_size++] = sites[i];
+            }
+        }
+
+        while (is_ok && work_size > 0) {
+            uint64_t* frontier = &frontiers[worklist[--work_size] * words];
+            for (size_t block = 0; block < func->blocks_size; block++) {
+                if (!has_bit(frontier, block) || has_phi[block] == stamp) {
+                    continue;
+                }
+                has_phi[block] = stamp;
+
+                ir_operand_t* list = (ir_operand_t*) calloc(func->blocks[block].preds_size, sizeof(ir_operand_t));
+                if (list == nullptr) {
+                    LOG(ERROR, "Memory allocation error\n");
+                    is_ok = false;
+                    break;
+                }
+
+                // NOTE - phis go first, the new instruction is moved to the front
+                if (add_instr(func, block, IR_PHI) == nullptr) {
+                    free(list);
+                    is_ok = false;
+                    break;
+                }
+                ir_block_t* phi_block = &func->blocks[block];
+                ir_instr_t phi = phi_block->instrs[phi_block->size - 1];
+                memmove(&phi_block->instrs[1], &phi_block->instrs[0], sizeof(ir_instr_t) * (phi_block->size - 1));
+                phi.dst       = var;
+                phi.func      = var;
+                phi.list      = list;
+                phi.list_size = phi_block->preds_size;
+                phi_block->instrs[0] = phi;
+
+                if (in_work[block] != stamp) {
+                    in_work[block] = stamp;
+                    worklist[work_size++] = block;
+                }
+            }
+        }
+    }
+
+    free(in_work);
+    free(has_phi);
+    free(worklist);
+    free(sites);
+    free(first);
+    return is_ok;
+}
+
+bool ir_t::rename(ir_func_t* func, size_t block_index, size_t* children, size_t* siblings) {
+    size_t mark = undo_size_;
+    ir_block_t* block = &func->blocks[block_index];
+
+    for (size_t i = 0; i < block->size; i++) {
+        ir_instr_t* instr = &block->instrs[i];
+        if (instr->opcode != IR_PHI) {
+            for (size_t j = 0; j < ir_operands_amount(instr); j++) {
+                ir_operand_t* operand = ir_operand(instr, j);
+                if (operand->kind != IR_VALUE || operand->value >= names_amount_) {
+                    continue;
+                }
+
+                // NOTE - a variable read before any assignment is 0, as in the interpreter
+                size_t value = defs_[operand->value];
+                if (value == IR_NO_VALUE) {
+                    operand->kind = IR_CONST;
+                    operand->num  = 0;
+                }
+                else {
+                    operand->value = value;
+                }
+            }
+        }
+
+        if (instr->dst < names_amount_) {
+            if (undo_size_ == undo_capacity_) {
+                size_t capacity = (undo_capacity_ == 0) ? IR_BLOCKS_MIN_CAPACITY : undo_capacity_ * 2;
+                size_t* vars   = (size_t*) realloc(undo_vars_, sizeof(size_t) * capacity);
+                if (vars != nullptr) undo_vars_ = vars;
+                size_t* values = (size_t*) realloc(undo_values_, sizeof(size_t) * capacity);
+                if (values != nullptr) undo_values_ = values;
+                if (vars == nullptr || values == nullptr) {
+                    LOG(ERROR, "Memory allocation error\n");
+                    return false;
+                }
+                undo_capacity_ = capacity;
+            }
+            undo_vars_[undo_size_]   = instr->dst;
+            undo_values_[undo_size_] = defs_[instr->dst];
+            undo_size_++;
+
+            size_t value = new_value(func);
+            defs_[instr->dst] = value;
+            instr->dst = value;
+        }
+    }
+
+    for (size_t i = 0; i < block->succs_size; i++) {
+        ir_block_t* succ = &func->blocks[block->succs[i]];
+        for (size_t j = 0; j < succ->preds_size; j++) {
+            if (succ->preds[j] != block_index) {
+                continue;
+            }
+
+            for (size_t k = 0; k < succ->size && succ->instrs[k].opcode == IR_PHI; k++) {
+                ir_operand_t* operand = &succ->instrs[k].list[j];
+                size_t value = defs_[succ->instrs[k].func];
+                if (value == IR_NO_VALUE) {
+                    operand->kind = IR_CONST;
+                    operand->num  = 0;
+                }
+                else {
+                    operand->kind  = IR_VALUE;
+                    operand->value = value;
+                }
+            }
+        }
+    }
+
+    for (size_t child = children[block_index]; child != IR_NO_BLOCK; child = siblings[child]) {
+        if (!rename(func, child, children, siblings)) {
+            return false;
+        }
+    }
+
+    while (undo_size_ > mark) {
+        undo_size_--;
+        defs_[undo_vars_[undo_size_]] = undo_values_[undo_size_];
+    }
+    return true;
+}
+
+bool ir_t::build_ssa(ir_func_t* func) {
+    size_t* order = order_blocks(func);
+    bool is_ok = order != nullptr && find_dominators(func, order);
+    free(order);
+    if (!is_ok) {
+        return false;
+    }
+
+    uint64_t* frontiers = find_frontiers(func);
+    is_ok = frontiers != nullptr && place_phis(func, frontiers);
+    free(frontiers);
+    if (!is_ok) {
+        return false;
+    }
+
+    size_t* children = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* siblings = (size_t*) calloc(func->blocks_size, sizeof(size_t));
+    size_t* defs     = (size_t*) realloc(defs_, sizeof(size_t) * (names_amount_ + 1));
+    if (defs != nullptr) defs_ = defs;
+    if (children == nullptr || siblings == nullptr || defs == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(siblings);
+        free(children);
+        return false;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        children[i] = IR_NO_BLOCK;
+        siblings[i] = IR_NO_BLOCK;
+    }
+    for (size_t i = func->blocks_size; i > 1; i--) {
+        size_t idom = func->blocks[i - 1].idom;
+        siblings[i - 1] = children[idom];
+        children[idom] = i - 1;
+    }
+
+    for (size_t i = 0; i < names_amount_; i++) {
+        defs_[i] = IR_NO_VALUE;
+    }
+    for (size_t i = 0; i < func->params_amount; i++) {
+        size_t value = new_value(func);
+        defs_[func->params[i]] = value;
+        func->params[i] = value;
+    }
+
+    undo_size_ = 0;
+    is_ok = rename(func, 0, children, siblings);
+
+    free(siblings);
+    free(children);
+    return is_ok;
+}
+
+//=========================================================================================
+
+// NOTE - in SSA a copy can simply be replaced by its source everywhere; a phi
+//        whose operands are all the same is a copy too. Both passes return false
+//        only on failure and tell whether they changed anything through is_changed
+bool ir_t::propagate_copies(ir_func_t* func, bool* is_changed) {
+    ir_operand_t* copies = (ir_operand_t*) calloc(func->values_amount, sizeof(ir_operand_t));
+    if (copies == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    size_t removed = 0;
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            if (instr->opcode == IR_PHI) {
+                bool is_copy = true;
+                for (size_t k = 1; k < instr->list_size; k++) {
+                    is_copy = is_copy && ir_same_operand(&instr->list[0], &instr->list[k]);
+                }
+                if (is_copy && instr->list_size > 0) {
+                    copies[instr->dst] = instr->list[0];
+                }
+            }
+            else if (instr->opcode == IR_MOV) {
+                copies[instr->dst] = instr->a;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        size_t size = 0;
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            if (instr->dst != IR_NO_VALUE && copies[instr->dst].kind != IR_NONE) {
+                free(instr->list);
+                removed++;
+                continue;
+            }
+
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                while (operand->kind == IR_VALUE && copies[operand->value].kind != IR_NONE) {
+                    *operand = copies[operand->value];
+                }
+            }
+            block->instrs[size++] = *instr;
+        }
+        block->size = size;
+    }
+
+    free(copies);
+    *is_changed = *is_changed || removed > 0;
+    return true;
+}
+
+bool ir_t::remove_dead_code(ir_func_t* func, bool* is_changed) {
+    size_t* uses = (size_t*) calloc(func->values_amount, sizeof(size_t));
+    if (uses == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                if (operand->kind == IR_VALUE) uses[operand->value]++;
+            }
+        }
+    }
+
+    size_t removed = 0;
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        size_t size = 0;
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            if (ir_is_pure(instr->opcode) && instr->dst != IR_NO_VALUE && uses[instr->dst] == 0) {
+                free(instr->list);
+                removed++;
+                continue;
+            }
+            block->instrs[size++] = *instr;
+        }
+        block->size = size;
+    }
+
+    free(uses);
+    *is_changed = *is_changed || removed > 0;
+    return true;
+}
+
+bool ir_t::optimize(ir_func_t* func) {
+    bool is_changed = true;
+    while (is_changed) {
+        is_changed = false;
+        if (!propagate_copies(func, &is_changed) || !remove_dead_code(func, &is_changed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE - the copies of a phi go to the ends of its predecessors. They are sequential:
+//        without loops a phi operand is never a phi of the same block
+bool ir_t::leave_ssa() {
+    for (size_t i = 0; i < funcs_amount_; i++) {
+        ir_func_t* func = &funcs_[i];
+        for (size_t j = 0; j < func->blocks_size; j++) {
+            size_t phis = 0;
+            while (phis < func->blocks[j].size && func->blocks[j].instrs[phis].opcode == IR_PHI) {
+                phis++;
+            }
+
+            for (size_t k = 0; k < phis; k++) {
+                for (size_t l = 0; l < func->blocks[j].preds_size; l++) {
+                    size_t pred = func->blocks[j].preds[l];
+                    ir_instr_t* copy = add_instr(func, pred, IR_MOV);
+                    if (copy == nullptr) {
+                        return false;
+                    }
+                    copy->dst = func->blocks[j].instrs[k].dst;
+                    copy->a   = func->blocks[j].instrs[k].list[l];
+
+                    ir_block_t* block = &func->blocks[pred];
+                    ir_instr_t last = block->instrs[block->size - 1];
+                    block->instrs[block->size - 1] = block->instrs[block->size - 2];
+                    block->instrs[block->size - 2] = last;
+                }
+                free(func->blocks[j].instrs[k].list);
+            }
+
+            ir_block_t* block = &func->blocks[j];
+            memmove(&block->instrs[0], &block->instrs[phis], sizeof(ir_instr_t) * (block->size - phis));
+            block->size -= phis;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,714 @@
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "jit.h"
+#include "prog_tree.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+// NOTE - opcodes of the encodings below, operands are filled in by the emitters
+const uint8_t X86_MOVSD_LOAD  = 0x10;  // F2 0F 10 /r
+const uint8_t X86_MOVSD_STORE = 0x11;  // F2 0F 11 /r
+const uint8_t X86_CALL_REL32  = 0xE8;
+const uint8_t X86_JMP_REL32   = 0xE9;
+const uint8_t X86_JE          = 0x84;  // 0F 8x rel32
+const uint8_t X86_JNE         = 0x85;
+const uint8_t X86_JB          = 0x82;
+const uint8_t X86_JAE         = 0x83;
+const uint8_t X86_JBE         = 0x86;
+const uint8_t X86_JA          = 0x87;
+const uint8_t X86_JP          = 0x8A;
+
+err_t jit_t::init(prog_tree_t* tree, FILE* istream, FILE* ostream) {
+    assert(tree != nullptr);
+    assert(istream != nullptr);
+    assert(ostream != nullptr);
+
+    tree_    = tree;
+    istream_ = istream;
+    ostream_ = ostream;
+
+    names_amount_ = tree->var_nametable_size();
+    decls_         = (node_t**) calloc(names_amount_ + 1, sizeof(node_t*));
+    params_amount_ = (size_t*)  calloc(names_amount_ + 1, sizeof(size_t));
+    func_offsets_  = (size_t*)  calloc(names_amount_ + 1, sizeof(size_t));
+    slots_         = (size_t*)  calloc(names_amount_ + 1, sizeof(size_t));
+    if (decls_ == nullptr || params_amount_ == nullptr || func_offsets_ == nullptr || slots_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return MEM_ALLOC_ERR;
+    }
+    return NO_ERR;
+}
+
+void jit_t::dtor() {
+    if (exec_ != nullptr && munmap(exec_, exec_size_) != 0) {
+        LOG(ERROR, "Failed to unmap the code\n");
+    }
+    exec_ = nullptr;
+    exec_size_ = 0;
+
+    free(code_);
+    code_ = nullptr;
+    code_size_ = 0;
+    code_capacity_ = 0;
+    is_alloc_err_ = false;
+
+    free(calls_);
+    calls_ = nullptr;
+    calls_size_ = 0;
+    calls_capacity_ = 0;
+
+    free(returns_);
+    returns_ = nullptr;
+    returns_size_ = 0;
+    returns_capacity_ = 0;
+
+    free(decls_);
+    decls_ = nullptr;
+    free(params_amount_);
+    params_amount_ = nullptr;
+    free(func_offsets_);
+    func_offsets_ = nullptr;
+    free(slots_);
+    slots_ = nullptr;
+    names_amount_ = 0;
+}
+
+err_t jit_t::compile() {
+    if (!index_funcs()) {
+        return SYNTAX_ERR;
+    }
+
+    for (node_t* list = tree_->root_; list != nullptr; list = list->right) {
+        if (!compile_func(list->left)) {
+            return SYNTAX_ERR;
+        }
+    }
+    if (is_alloc_err_) {
+        return MEM_ALLOC_ERR;
+    }
+
+    for (size_t i = 0; i < calls_size_; i++) {
+        patch_rel32(calls_[i].pos, func_offsets_[calls_[i].target]);
+    }
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    exec_size_ = (code_size_ + page - 1) / page * page;
+
+    void* exec = mmap(nullptr, exec_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (exec == MAP_FAILED) {
+        LOG(ERROR, "Failed to map %zu bytes of code\n", exec_size_);
+        exec_size_ = 0;
+        return MEM_ALLOC_ERR;
+    }
+    exec_ = (uint8_t*) exec;
+
+    memcpy(exec_, code_, code_size_);
+    if (mprotect(exec_, exec_size_, PROT_READ | PROT_EXEC) != 0) {
+        LOG(ERROR, "Failed to make the code executable\n");
+        return MEM_ALLOC_ERR;
+    }
+
+    LOG(INFO, "Jit compiled %zu bytes of code\n", code_size_);
+    return NO_ERR;
+}
+
+err_t jit_t::run() {
+    if (exec_ == nullptr) {
+        LOG(ERROR, "Nothing was compiled\n");
+        return SYNTAX_ERR;
+    }
+
+    // NOTE - runtime helpers jump back here on errors, the jitted frames have nothing to unwind
+    if (setjmp(abort_env_) != 0) {
+        return SYNTAX_ERR;
+    }
+
+    void (*entry)(void) = (void (*)(void)) (exec_ + main_offset_);
+    entry();
+    return NO_ERR;
+}
+
+void jit_t::scan_helper(jit_t* jit, double* slot) {
+    if (fscanf(jit->istream_, "%lf", slot) != 1) {
+        LOG(ERROR, "Failed to scan a value\n");
+        longjmp(jit->abort_env_, 1);
+    }
+}
+
+void jit_t::print_helper(jit_t* jit, double value) {
+    fprintf(jit->ostream_, "%lg\n", value);
+}
+
+// NOTE - argument and parameter lists end either with nullptr or with a bare last item
+node_t* jit_t::next_item(node_t** list) {
+    node_t* node = *list;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->type == OP && (int) node->value == SEMICOLON) {
+        *list = node->right;
+        return node->left;
+    }
+    *list = nullptr;
+    return node;
+}
+
+const char* jit_t::name(node_t* node) {
+    return tree_->var_nametable_[(size_t) node->value].name;
+}
+
+bool jit_t::index_funcs() {
+    bool has_main = false;
+    for (node_t* list = tree_->root_; list != nullptr; list = list->right) {
+        node_t* decl = list->left;
+        if (decl == nullptr || decl->type != OP || (int) decl->value != DECL ||
+            decl->left == nullptr || decl->left->left == nullptr || decl->left->left->type != FUNC) {
+            LOG(ERROR, "Syntax err at %p: expected a function declaration\n", decl);
+            return false;
+        }
+
+        size_t index = (size_t) decl->left->left->value;
+        decls_[index] = decl;
+        params_amount_[index] = 0;
+        for (node_t* params = decl->left->right; next_item(&params) != nullptr;) {
+            params_amount_[index]++;
+        }
+
+        if (params_amount_[index] > JIT_MAX_ARGS) {
+            LOG(ERROR, "Function %s takes %zu arguments, at most %zu are passed in registers\n",
+                       name(decl->left->left), params_amount_[index], JIT_MAX_ARGS);
+            return false;
+        }
+        has_main = has_main || strcmp(name(decl->left->left), "main") == 0;
+    }
+
+    if (!has_main) {
+        LOG(ERROR, "Function main was not declared\n");
+        return false;
+    }
+    return true;
+}
+
+bool jit_t::assign_slots(node_t* decl) {
+    for (size_t i = 0; i < names_amount_; i++) {
+        slots_[i] = JIT_NO_SLOT;
+    }
+    slots_amount_ = 0;
+
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr;) {
+        if (param->type != VAR) {
+            LOG(ERROR, "Syntax err at %p: expected a parameter\n", param);
+            return false;
+        }
+        if (slots_[(size_t) param->value] == JIT_NO_SLOT) {
+            slots_[(size_t) param->value] = slots_amount_++;
+        }
+    }
+
+    tree_walk_t walk = {};
+    walk.init(decl->right);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        node_t* node = step.node;
+        if (step.event != WALK_ENTER || node->type != VAR) {
+            continue;
+        }
+
+        bool is_callee = node->parent != nullptr && node->parent->type == OP &&
+                         (int) node->parent->value == CALL && node->parent->right == node;
+        if (!is_callee && slots_[(size_t) node->value] == JIT_NO_SLOT) {
+            slots_[(size_t) node->value] = slots_amount_++;
+        }
+    }
+    bool is_ok = !walk.is_alloc_err();
+    walk.dtor();
+    return is_ok;
+}
+
+long jit_t::slot_offset(node_t* var) {
+    if (var == nullptr || var->type != VAR || var->value < 0 || (size_t) var->value >= names_amount_ ||
+        slots_[(size_t) var->value] == JIT_NO_SLOT) {
+        LOG(ERROR, "Expected a variable at %p\n", var);
+        return 0;
+    }
+    return -8 * (long) (slots_[(size_t) var->value] + 1);
+}
+
+bool jit_t::compile_func(node_t* decl) {
+    assert(decl != nullptr);
+
+    size_t index = (size_t) decl->left->left->value;
+    func_offsets_[index] = code_size_;
+    if (strcmp(name(decl->left->left), "main") == 0) {
+        main_offset_ = code_size_;
+    }
+
+    if (!assign_slots(decl)) {
+        return false;
+    }
+
+    size_t frame = (slots_amount_ * sizeof(double) + 15) & ~(size_t) 15;
+    emit_bytes(1, 0x55);                // push rbp
+    emit_bytes(3, 0x48, 0x89, 0xE5);    // mov rbp, rsp
+    if (frame != 0) {
+        emit_bytes(3, 0x48, 0x81, 0xEC);  // sub rsp, imm32
+        emit_u32((uint32_t) frame);
+    }
+
+    size_t i = 0;
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr; i++) {
+        emit_slot(X86_MOVSD_STORE, (int) i, slot_offset(param));
+    }
+    if (params_amount_[index] < slots_amount_) {
+        emit_bytes(4, 0x66, 0x0F, 0xEF, 0xC0);  // pxor xmm0, xmm0
+    }
+    for (size_t slot = params_amount_[index]; slot < slots_amount_; slot++) {
+        emit_slot(X86_MOVSD_STORE, 0, -8 * (long) (slot + 1));
+    }
+
+    returns_size_ = 0;
+    if (!compile_list(decl->right)) {
+        return false;
+    }
+
+    for (size_t ret = 0; ret < returns_size_; ret++) {
+        patch_rel32(returns_[ret].pos, code_size_);
+    }
+    emit_bytes(2, 0xC9, 0xC3);  // leave; ret
+    return true;
+}
+
+bool jit_t::compile_list(node_t* list) {
+    while (list != nullptr && list->type == OP && (int) list->value == SEMICOLON) {
+        if (!compile_stmt(list->left)) {
+            return false;
+        }
+        list = list->right;
+    }
+    return true;
+}
+
+bool jit_t::compile_stmt(node_t* stmt) {
+    if (stmt == nullptr) {
+        return true;
+    }
+
+    if (stmt->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a statement\n", stmt);
+        return false;
+    }
+
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            return compile_stmt(stmt->left);
+        case EQ: {
+            long offset = slot_offset(stmt->left);
+            if (offset == 0 || !compile_expr(stmt->right)) {
+                return false;
+            }
+            emit_slot(X86_MOVSD_STORE, 0, offset);
+            return true;
+        }
+        case CALL:
+            return compile_call(stmt);
+        case RETURN:
+            add_patch(&returns_, &returns_size_, &returns_capacity_, emit_jump(X86_JMP_REL32), 0);
+            return true;
+        case IF:
+            return compile_if(stmt, nullptr);
+        case SEMICOLON:
+            return compile_if(stmt->left, stmt->right);
+        case IN: {
+            long offset = slot_offset(stmt->left);
+            if (offset == 0) {
+                return false;
+            }
+            emit_bytes(2, 0x48, 0xBF);          // mov rdi, imm64
+            emit_u64((uint64_t) this);
+            emit_bytes(3, 0x48, 0x8D, 0xB5);    // lea rsi, [rbp + disp32]
+            emit_u32((uint32_t) offset);
+            emit_call_abs((const void*) &jit_t::scan_helper);
+            return true;
+        }
+        case OUT:
+            if (!compile_expr(stmt->left)) {
+                return false;
+            }
+            emit_bytes(2, 0x48, 0xBF);          // mov rdi, imm64
+            emit_u64((uint64_t) this);
+            emit_call_abs((const void*) &jit_t::print_helper);
+            return true;
+        default:
+            LOG(ERROR, "Unsupported statement %s at %p\n", op_to_name((int) stmt->value), stmt);
+            return false;
+    }
+}
+
+bool jit_t::compile_if(node_t* if_node, node_t* else_node) {
+    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF ||
+        if_node->left == nullptr || if_node->left->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected if\n", if_node);
+        return false;
+    }
+    if (else_node != nullptr && (else_node->type != OP || (int) else_node->value != ELSE)) {
+        LOG(ERROR, "Syntax err at %p: expected else\n", else_node);
+        return false;
+    }
+
+    // NOTE - jump over the body when the comparison is false. A NaN operand sets ZF, PF
+    //        and CF at once: then != is true and the rest are false, as in the interpreter
+    uint8_t jump = 0;
+    switch ((int) if_node->left->value) {
+        case IE:   jump = X86_JNE; break;
+        case INE:  jump = X86_JE;  break;
+        case IA:   jump = X86_JBE; break;
+        case IAEQ: jump = X86_JB;  break;
+        case IB:   jump = X86_JAE; break;
+        case IBEQ: jump = X86_JA;  break;
+        default:
+            LOG(ERROR, "Unknown comparison %s\n", op_to_name((int) if_node->left->value));
+            return false;
+    }
+
+    if (!compile_expr(if_node->left->left)) {
+        return false;
+    }
+    push_xmm0();
+    if (!compile_expr(if_node->left->right)) {
+        return false;
+    }
+    emit_bytes(4, 0x66, 0x0F, 0x28, 0xC8);  // movapd xmm1, xmm0
+    pop_xmm(0);
+    emit_bytes(4, 0x66, 0x0F, 0x2E, 0xC1);  // ucomisd xmm0, xmm1
+
+    bool is_unordered_true = (int) if_node->left->value == INE;
+    size_t to_unordered = emit_jump(X86_JP);
+    size_t to_else = emit_jump(jump);
+    if (is_unordered_true) {
+        patch_rel32(to_unordered, code_size_);
+    }
+    if (!compile_list(if_node->right)) {
+        return false;
+    }
+
+    size_t to_finish = 0;
+    if (else_node != nullptr) {
+        to_finish = emit_jump(X86_JMP_REL32);
+    }
+    patch_rel32(to_else, code_size_);
+    if (!is_unordered_true) {
+        patch_rel32(to_unordered, code_size_);
+    }
+    if (else_node == nullptr) {
+        return true;
+    }
+
+    if (!compile_list(else_node->left)) {
+        return false;
+    }
+    patch_rel32(to_finish, code_size_);
+    return true;
+}
+
+bool jit_t::compile_call(node_t* call) {
+    node_t* callee = call->right;
+    if (callee == nullptr || callee->value < 0 || (size_t) callee->value >= names_amount_ ||
+        decls_[(size_t) callee->value] == nullptr) {
+        LOG(ERROR, "Call of an undeclared function at %p\n", call);
+        return false;
+    }
+
+    size_t args_amount = 0;
+    for (node_t* args = call->left, *arg = nullptr; (arg = next_item(&args)) != nullptr; args_amount++) {
+        if (!compile_expr(arg)) {
+            return false;
+        }
+        push_xmm0();
+    }
+
+    if (args_amount != params_amount_[(size_t) callee->value]) {
+        LOG(ERROR, "Function %s takes %zu arguments, %zu given\n",
+                   name(callee), params_amount_[(size_t) callee->value], args_amount);
+        return false;
+    }
+
+    for (size_t i = args_amount; i > 0; i--) {
+        pop_xmm((int) i - 1);
+    }
+
+    // NOTE - callee may be not compiled yet, rel32 is patched when all offsets are known
+    add_patch(&calls_, &calls_size_, &calls_capacity_, emit_jump(X86_CALL_REL32), (size_t) callee->value);
+    return true;
+}
+
+// NOTE - postorder walk, the top of the value stack is kept in xmm0
+bool jit_t::compile_expr(node_t* node) {
+    if (node == nullptr) {
+        LOG(ERROR, "Missing operand\n");
+        return false;
+    }
+
+    tree_walk_t walk = {};
+    walk.init(node);
+
+    bool is_ok = true;
+    size_t depth = 0;
+    walk_step_t step = {};
+    while (is_ok && walk.next(&step)) {
+        node_t* cur = step.node;
+        if (step.event == WALK_ENTER) {
+            continue;
+        }
+
+        switch (cur->type) {
+            case NUM:
+            case VAR: {
+                if (depth++ != 0) {
+                    push_xmm0();
+                }
+
+                if (cur->type == NUM) {
+                    emit_load_imm(cur->value, 0);
+                    break;
+                }
+
+                long offset = slot_offset(cur);
+                is_ok = offset != 0;
+                emit_slot(X86_MOVSD_LOAD, 0, offset);
+                break;
+            }
+            case OP:
+                if (cur->left == nullptr) {
+                    LOG(ERROR, "Missing operand of %s\n", op_to_name((int) cur->value));
+                    is_ok = false;
+                    break;
+                }
+                is_ok = compile_op(cur);
+                if (cur->right != nullptr) {
+                    depth--;
+                }
+                break;
+            case FUNC:
+            default:
+                LOG(ERROR, "Unexpected node %d in an expression\n", cur->type);
+                is_ok = false;
+                break;
+        }
+    }
+    if (walk.is_alloc_err()) {
+        is_ok = false;
+    }
+    walk.dtor();
+    return is_ok;
+}
+
+bool jit_t::compile_op(node_t* node) {
+    if (node->right == nullptr) {
+        switch ((int) node->value) {
+            case SUB:
+                emit_bytes(2, 0x48, 0xB8);              // mov rax, imm64
+                emit_u64(0x8000000000000000);
+                emit_bytes(5, 0x66, 0x48, 0x0F, 0x6E, 0xC8);  // movq xmm1, rax
+                emit_bytes(4, 0x66, 0x0F, 0x57, 0xC1);  // xorpd xmm0, xmm1
+                return true;
+            case ADD:
+                return true;
+            default:
+                return compile_math((int) node->value);
+        }
+    }
+
+    emit_bytes(4, 0x66, 0x0F, 0x28, 0xC8);  // movapd xmm1, xmm0
+    pop_xmm(0);
+
+    switch ((int) node->value) {
+        case ADD:
+            emit_bytes(4, 0xF2, 0x0F, 0x58, 0xC1);  // addsd xmm0, xmm1
+            return true;
+        case SUB:
+            emit_bytes(4, 0xF2, 0x0F, 0x5C, 0xC1);  // subsd xmm0, xmm1
+            return true;
+        case MUL:
+            emit_bytes(4, 0xF2, 0x0F, 0x59, 0xC1);  // mulsd xmm0, xmm1
+            return true;
+        case DIV:
+            emit_bytes(4, 0xF2, 0x0F, 0x5E, 0xC1);  // divsd xmm0, xmm1
+            return true;
+        case POW: {
+            double (*func)(double, double) = pow;
+            emit_call_abs((const void*) func);
+            return true;
+        }
+        case LOG: {
+            // NOTE - log_xmm0(xmm1) = ln(xmm1) / ln(xmm0)
+            double (*func)(double) = log;
+            push_xmm0();
+            emit_bytes(4, 0x66, 0x0F, 0x28, 0xC1);        // movapd xmm0, xmm1
+            emit_call_abs((const void*) func);
+            push_xmm0();
+            emit_bytes(6, 0xF2, 0x0F, 0x10, 0x44, 0x24, 0x10);  // movsd xmm0, [rsp + 16]
+            emit_call_abs((const void*) func);
+            emit_bytes(4, 0x66, 0x0F, 0x28, 0xC8);        // movapd xmm1, xmm0
+            pop_xmm(0);
+            emit_bytes(4, 0x48, 0x83, 0xC4, 0x10);        // add rsp, 16
+            emit_bytes(4, 0xF2, 0x0F, 0x5E, 0xC1);        // divsd xmm0, xmm1
+            return true;
+        }
+        default:
+            LOG(ERROR, "Unsupported binary operation %s\n", op_to_name((int) node->value));
+            return false;
+    }
+}
+
+bool jit_t::compile_math(int op) {
+    double (*func)(double) = nullptr;
+    switch (op) {
+        case SIN:    func = sin;   break;
+        case COS:    func = cos;   break;
+        case TG:     func = tan;   break;
+        case CTG:    func = tan;   break;
+        case SH:     func = sinh;  break;
+        case CH:     func = cosh;  break;
+        case TH:     func = tanh;  break;
+        case CTH:    func = tanh;  break;
+        case ARCSIN: func = asin;  break;
+        case ARCCOS: func = acos;  break;
+        case ARCTG:  func = atan;  break;
+        case ARCCTG: func = atan;  break;
+        case ARCSH:  func = asinh; break;
+        case ARCCH:  func = acosh; break;
+        case ARCTH:  func = atanh; break;
+        case ARCCTH: func = atanh; break;
+        case LN:     func = log;   break;
+        case EXP:    func = exp;   break;
+        default:
+            LOG(ERROR, "Undefined operation %s\n", op_to_name(op));
+            return false;
+    }
+    emit_call_abs((const void*) func);
+
+    // NOTE - results of the middleend's calculate_op for the same operation
+    if (op == CTG || op == CTH) {
+        emit_bytes(4, 0x66, 0x0F, 0x28, 0xC8);  // movapd xmm1, xmm0
+        emit_load_imm(1, 0);
+        emit_bytes(4, 0xF2, 0x0F, 0x5E, 0xC1);  // divsd xmm0, xmm1
+    }
+    else if (op == ARCCTG) {
+        emit_bytes(4, 0x66, 0x0F, 0x28, 0xC8);  // movapd xmm1, xmm0
+        emit_load_imm(M_PI / 2, 0);
+        emit_bytes(4, 0xF2, 0x0F, 0x5C, 0xC1);  // subsd xmm0, xmm1
+    }
+    return true;
+}
+
+// NOTE - after a failed allocation nothing more is emitted or patched,
+//        compile() sees is_alloc_err_ once the functions are done
+void jit_t::emit_bytes(size_t amount, ...) {
+    if (is_alloc_err_) {
+        return;
+    }
+    if (code_size_ + amount > code_capacity_) {
+        size_t capacity = (code_capacity_ == 0) ? JIT_CODE_MIN_CAPACITY : code_capacity_ * 2;
+        uint8_t* code = (uint8_t*) realloc(code_, capacity);
+        if (code == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            is_alloc_err_ = true;
+            return;
+        }
+        code_ = code;
+        code_capacity_ = capacity;
+    }
+
+    va_list bytes;
+    va_start(bytes, amount);
+    for (size_t i = 0; i < amount; i++) {
+        code_[code_size_++] = (uint8_t) va_arg(bytes, int);
+    }
+    va_end(bytes);
+}
+
+void jit_t::emit_u32(uint32_t value) {
+    emit_bytes(4, value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF);
+}
+
+void jit_t::emit_u64(uint64_t value) {
+    emit_u32((uint32_t) value);
+    emit_u32((uint32_t) (value >> 32));
+}
+
+// NOTE - movsd between xmm<reg> and [rbp + disp32]
+void jit_t::emit_slot(uint8_t opcode, int reg, long offset) {
+    emit_bytes(4, 0xF2, 0x0F, opcode, 0x85 | (reg << 3));
+    emit_u32((uint32_t) offset);
+}
+
+void jit_t::emit_load_imm(double value, int reg) {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    emit_bytes(2, 0x48, 0xB8);                              // mov rax, imm64
+    emit_u64(bits);
+    emit_bytes(5, 0x66, 0x48, 0x0F, 0x6E, 0xC0 | (reg << 3));  // movq xmm<reg>, rax
+}
+
+void jit_t::emit_call_abs(const void* func) {
+    emit_bytes(2, 0x48, 0xB8);  // mov rax, imm64
+    emit_u64((uint64_t) func);
+    emit_bytes(2, 0xFF, 0xD0);  // call rax
+}
+
+// NOTE - returns the position of the rel32 operand, it is filled by patch_rel32
+size_t jit_t::emit_jump(uint8_t opcode) {
+    if (opcode == X86_JMP_REL32 || opcode == X86_CALL_REL32) {
+        emit_bytes(1, opcode);
+    }
+    else {
+        emit_bytes(2, 0x0F, opcode);
+    }
+
+    size_t pos = code_size_;
+    emit_u32(0);
+    return pos;
+}
+
+void jit_t::patch_rel32(size_t pos, size_t target) {
+    if (is_alloc_err_) {
+        return;
+    }
+    int32_t rel = (int32_t) ((long) target - (long) (pos + sizeof(int32_t)));
+    memcpy(code_ + pos, &rel, sizeof(rel));
+}
+
+void jit_t::add_patch(jit_patch_t** patches, size_t* size, size_t* capacity, size_t pos, size_t target) {
+    if (*size == *capacity) {
+        size_t new_capacity = (*capacity == 0) ? JIT_PATCHES_MIN_CAPACITY : *capacity * 2;
+        jit_patch_t* new_patches = (jit_patch_t*) realloc(*patches, sizeof(jit_patch_t) * new_capacity);
+        if (new_patches == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            is_alloc_err_ = true;
+            return;
+        }
+        *patches = new_patches;
+        *capacity = new_capacity;
+    }
+
+    (*patches)[*size].pos    = pos;
+    (*patches)[*size].target = target;
+    (*size)++;
+}
+
+void jit_t::push_xmm0() {
+    emit_bytes(4, 0x48, 0x83, 0xEC, 0x10);        // sub rsp, 16
+    emit_bytes(5, 0xF2, 0x0F, 0x11, 0x04, 0x24);  // movsd [rsp], xmm0
+}
+
+void jit_t::pop_xmm(int reg) {
+    emit_bytes(5, 0xF2, 0x0F, 0x10, 0x04 | (reg << 3), 0x24);  // movsd xmm<reg>, [rsp]
+    emit_bytes(4, 0x48, 0x83, 0xC4, 0x10);                     // add rsp, 16
+}
@@ -15,7 +15,7 @@ int main() {
     LoggerSetFile(logger);
     LoggerSetLevel(INFO);
 
-    FILE* istream = fopen("m_out.txt", "r");
+    FILE* istream = fopen("m_out.ast", "rb");
     if (istream == nullptr) {
         LOG(ERROR, "Failed to open an input data file\n");
         return 1;
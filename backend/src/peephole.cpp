@@ -0,0 +1,213 @@
+#include <assert.h>
+#include <string.h>
+#include "peephole.h"
+#include "logger.h"
+
+// NOTE - marks an instruction removed until sweep()
+const spu_cmd_t SPU_REMOVED = SPU_CMDS_AMOUNT;
+
+static const char* const rule_names[PEEPHOLE_RULES_AMOUNT] = {
+    "push X; pop X",
+    "push 0; add/sub",
+    "push 1; mul/div/pow",
+    "unreachable code",
+    "jmp to the next label",
+    "dead store",
+    "unused label",
+};
+
+static bool is_num(const spu_instr_t* instr, double value);
+static bool is_jump(spu_cmd_t cmd);
+static bool is_operand(const spu_instr_t* instr);
+
+void peephole_t::run(spu_code_t* code) {
+    assert(code != nullptr);
+
+    bool changed = true;
+    while (changed) {
+        changed = compact(code);
+        changed = remove_jumps_to_next(code) || changed;
+        changed = remove_dead_stores(code) || changed;
+        changed = remove_dead_labels(code) || changed;
+    }
+}
+
+void peephole_t::add(const peephole_t* other) {
+    assert(other != nullptr);
+
+    for (size_t i = 0; i < PEEPHOLE_RULES_AMOUNT; i++) {
+        hits_[i] += other->hits_[i];
+    }
+}
+
+void peephole_t::report() {
+    for (size_t i = 0; i < PEEPHOLE_RULES_AMOUNT; i++) {
+        LOG(INFO, "Peephole rule \"%s\": %zu hits\n", rule_names[i], hits_[i]);
+    }
+}
+
+static bool is_num(const spu_instr_t* instr, double value) {
+    return instr->arg == SPU_ARG_NUM && memcmp(&instr->num, &value, sizeof(double)) == 0;
+}
+
+static bool is_jump(spu_cmd_t cmd) {
+    return cmd >= SPU_JMP && cmd <= SPU_JNE;
+}
+
+static bool is_operand(const spu_instr_t* instr) {
+    return instr->arg == SPU_ARG_REG || instr->arg == SPU_ARG_MEM;
+}
+
+// NOTE - instructions are moved down one by one and the rules are tried on the tail,
+//        so a removed pair lets the instructions around it match in the same pass:
+//        push ax; push bx; pop bx; pop ax disappears completely
+bool peephole_t::compact(spu_code_t* code) {
+    bool changed = false;
+    bool is_dead = false;
+    size_t size = 0;
+
+    for (size_t i = 0; i < code->size_; i++) {
+        spu_instr_t* instr = &code->instrs_[i];
+        if (is_dead && instr->cmd != SPU_LABEL) {
+            hits_[PEEPHOLE_DEAD_CODE]++;
+            changed = true;
+            continue;
+        }
+
+        is_dead = instr->cmd == SPU_JMP || instr->cmd == SPU_RET || instr->cmd == SPU_HLT;
+        code->instrs_[size++] = *instr;
+        while (fold_tail(code->instrs_, &size)) {
+            changed = true;
+        }
+    }
+
+    code->size_ = size;
+    return changed;
+}
+
+bool peephole_t::fold_tail(spu_instr_t* instrs, size_t* size) {
+    if (*size < 2) {
+        return false;
+    }
+
+    spu_instr_t* first  = &instrs[*size - 2];
+    spu_instr_t* second = &instrs[*size - 1];
+    if (first->cmd != SPU_PUSH) {
+        return false;
+    }
+
+    if (second->cmd == SPU_POP && is_operand(first) && spu_same_arg(first, second)) {
+        hits_[PEEPHOLE_PUSH_POP]++;
+    }
+    else if ((second->cmd == SPU_ADD || second->cmd == SPU_SUB) && is_num(first, 0)) {
+        hits_[PEEPHOLE_ADD_ZERO]++;
+    }
+    else if ((second->cmd == SPU_MUL || second->cmd == SPU_DIV || second->cmd == SPU_POW) && is_num(first, 1)) {
+        hits_[PEEPHOLE_MUL_ONE]++;
+    }
+    else {
+        return false;
+    }
+
+    *size -= 2;
+    return true;
+}
+
+bool peephole_t::remove_jumps_to_next(spu_code_t* code) {
+    bool changed = false;
+    for (size_t i = 0; i < code->size_; i++) {
+        if (code->instrs_[i].cmd != SPU_JMP) {
+            continue;
+        }
+
+        for (size_t j = i + 1; j < code->size_ && code->instrs_[j].cmd == SPU_LABEL; j++) {
+            if (spu_same_label(&code->instrs_[i].label, &code->instrs_[j].label)) {
+                code->instrs_[i].cmd = SPU_REMOVED;
+                hits_[PEEPHOLE_JMP_NEXT]++;
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    sweep(code);
+    return changed;
+}
+
+// NOTE - pop X; push X only keeps the value on the stack if X is written again
+//        before anyone reads it, then both instructions go
+bool peephole_t::remove_dead_stores(spu_code_t* code) {
+    bool changed = false;
+    for (size_t i = 0; i + 1 < code->size_; i++) {
+        spu_instr_t* pop  = &code->instrs_[i];
+        spu_instr_t* push = &code->instrs_[i + 1];
+        if (pop->cmd != SPU_POP || push->cmd != SPU_PUSH || !is_operand(pop) || !spu_same_arg(pop, push)) {
+            continue;
+        }
+
+        if (is_dead_store(code, i)) {
+            pop->cmd  = SPU_REMOVED;
+            push->cmd = SPU_REMOVED;
+            hits_[PEEPHOLE_DEAD_STORE]++;
+            changed = true;
+            i++;
+        }
+    }
+
+    sweep(code);
+    return changed;
+}
+
+// NOTE - looks only inside the basic block; hx is the frame base, touching it ends the search
+bool peephole_t::is_dead_store(spu_code_t* code, size_t pop) {
+    spu_instr_t* target = &code->instrs_[pop];
+    for (size_t i = pop + 2; i < code->size_; i++) {
+        spu_instr_t* instr = &code->instrs_[i];
+        if (instr->cmd == SPU_LABEL || instr->cmd == SPU_CALL || instr->cmd == SPU_RET ||
+            instr->cmd == SPU_HLT || is_jump(instr->cmd)) {
+            return false;
+        }
+        if (instr->arg == SPU_ARG_REG && instr->index == SPU_REG_HX) {
+            return false;
+        }
+        if (spu_same_arg(instr, target)) {
+            return instr->cmd == SPU_POP;
+        }
+    }
+    return false;
+}
+
+// NOTE - jump labels are local to the function, the ones nobody jumps to only split
+//        blocks and keep the other rules from matching across them
+bool peephole_t::remove_dead_labels(spu_code_t* code) {
+    bool changed = false;
+    for (size_t i = 0; i < code->size_; i++) {
+        spu_instr_t* label = &code->instrs_[i];
+        if (label->cmd != SPU_LABEL || label->label.kind == SPU_LABEL_FUNC) {
+            continue;
+        }
+
+        bool is_used = false;
+        for (size_t j = 0; j < code->size_ && !is_used; j++) {
+            is_used = is_jump(code->instrs_[j].cmd) && spu_same_label(&code->instrs_[j].label, &label->label);
+        }
+        if (!is_used) {
+            label->cmd = SPU_REMOVED;
+            hits_[PEEPHOLE_DEAD_LABEL]++;
+            changed = true;
+        }
+    }
+
+    sweep(code);
+    return changed;
+}
+
+void peephole_t::sweep(spu_code_t* code) {
+    size_t size = 0;
+    for (size_t i = 0; i < code->size_; i++) {
+        if (code->instrs_[i].cmd != SPU_REMOVED) {
+            code->instrs_[size++] = code->instrs_[i];
+        }
+    }
+    code->size_ = size;
+}
@@ -0,0 +1,393 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include "regalloc.h"
+#include "logger.h"
+
+typedef struct {
+    size_t uses;
+    size_t value;
+} hotness_t;
+
+static int compare_calls(const void* call1, const void* call2);
+static int compare_hotness(const void* value1, const void* value2);
+static void reset_interval(live_interval_t* interval);
+static bool has_bit(const uint64_t* set, size_t bit);
+
+// NOTE - live sets of block b: live-in at 2 * b, live-out at 2 * b + 1 (set_words_ words each)
+bool regalloc_t::allocate(ir_func_t* func, const bool* on_stack) {
+    assert(func != nullptr);
+
+    if (!reserve(func->values_amount)) {
+        return false;
+    }
+    calls_size_ = 0;
+
+    uint64_t* live = solve_liveness(func);
+    if (live == nullptr) {
+        return false;
+    }
+    build_intervals(func, live, on_stack);
+    bool is_ok = assign_regs() && find_call_sites(func, live);
+    free(live);
+    if (!is_ok) {
+        return false;
+    }
+
+    if (calls_size_ > 0) {
+        qsort(calls_, calls_size_, sizeof(call_site_t), compare_calls);
+    }
+    assign_slots();
+    return true;
+}
+
+void regalloc_t::dtor() {
+    free(intervals_);
+    intervals_ = nullptr;
+    free(values_);
+    values_ = nullptr;
+    free(is_saved_);
+    is_saved_ = nullptr;
+    values_amount_ = 0;
+    values_capacity_ = 0;
+    values_size_ = 0;
+
+    free(calls_);
+    calls_ = nullptr;
+    calls_size_ = 0;
+    calls_capacity_ = 0;
+}
+
+bool regalloc_t::reserve(size_t values_amount) {
+    if (values_amount > values_capacity_) {
+        free(intervals_);
+        free(values_);
+        free(is_saved_);
+        intervals_ = (live_interval_t*) calloc(values_amount, sizeof(live_interval_t));
+        values_    = (size_t*) calloc(values_amount, sizeof(size_t));
+        is_saved_  = (bool*) calloc(values_amount, sizeof(bool));
+        if (intervals_ == nullptr || values_ == nullptr || is_saved_ == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            dtor();
+            return false;
+        }
+        values_capacity_ = values_amount;
+    }
+
+    values_amount_ = values_amount;
+    set_words_ = values_amount / 64 + 1;
+    values_size_ = 0;
+    for (size_t i = 0; i < values_amount_; i++) {
+        reset_interval(&intervals_[i]);
+        is_saved_[i] = false;
+    }
+    return true;
+}
+
+static void reset_interval(live_interval_t* interval) {
+    interval->first = SIZE_MAX;
+    interval->last  = 0;
+    interval->uses  = 0;
+    interval->reg   = REGALLOC_NO_REG;
+    interval->slot  = REGALLOC_NO_SLOT;
+}
+
+static bool has_bit(const uint64_t* set, size_t bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+// NOTE - live-in = used before defined in the block + (live-out - defined in the block),
+//        live-out = union of live-in of the successors, iterated until nothing changes
+uint64_t* regalloc_t::solve_liveness(ir_func_t* func) {
+    size_t words = set_words_;
+    uint64_t* live = (uint64_t*) calloc(func->blocks_size * 2 * words, sizeof(uint64_t));
+    uint64_t* uses = (uint64_t*) calloc(func->blocks_size * 2 * words, sizeof(uint64_t));
+    if (live == nullptr || uses == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(uses);
+        free(live);
+        return nullptr;
+    }
+
+    // NOTE - uses has the upward exposed uses at 2 * b and the definitions at 2 * b + 1
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        uint64_t* used    = &uses[i * 2 * words];
+        uint64_t* defined = &uses[(i * 2 + 1) * words];
+        ir_block_t* block = &func->blocks[i];
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                if (operand->kind == IR_VALUE && !has_bit(defined, operand->value)) {
+                    used[operand->value / 64] |= (uint64_t) 1 << (operand->value % 64);
+                }
+            }
+            if (instr->dst != IR_NO_VALUE) {
+                defined[instr->dst / 64] |= (uint64_t) 1 << (instr->dst % 64);
+            }
+        }
+    }
+
+    bool is_changed = true;
+    while (is_changed) {
+        is_changed = false;
+        for (size_t i = func->blocks_size; i > 0; i--) {
+            ir_block_t* block = &func->blocks[i - 1];
+            uint64_t* live_in  = &live[(i - 1) * 2 * words];
+            uint64_t* live_out = &live[((i - 1) * 2 + 1) * words];
+            uint64_t* used     = &uses[(i - 1) * 2 * words];
+            uint64_t* defined  = &uses[((i - 1) * 2 + 1) * words];
+
+            for (size_t w = 0; w < words; w++) {
+                uint64_t out = 0;
+                for (size_t j = 0; j < block->succs_size; j++) {
+                    out |= live[block->succs[j] * 2 * words + w];
+                }
+
+                uint64_t in = used[w] | (out & ~defined[w]);
+                if (in != live_in[w] || out != live_out[w]) {
+                    is_changed = true;
+                }
+                live_in[w]  = in;
+                live_out[w] = out;
+            }
+        }
+    }
+
+    free(uses);
+    return live;
+}
+
+// NOTE - instruction i of the layout reads at 2 * i and writes at 2 * i + 1,
+//        so a value dying in an instruction can share a register with its result
+void regalloc_t::build_intervals(ir_func_t* func, const uint64_t* live, const bool* on_stack) {
+    for (size_t i = 0; i < func->params_amount; i++) {
+        extend(func->params[i], 0);
+        intervals_[func->params[i]].uses++;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        if (block->size == 0) {
+            continue;
+        }
+
+        size_t start = 2 * pos;
+        size_t end   = 2 * (pos + block->size - 1) + 1;
+        for (size_t w = 0; w < set_words_; w++) {
+            uint64_t live_in  = live[i * 2 * set_words_ + w];
+            uint64_t live_out = live[(i * 2 + 1) * set_words_ + w];
+            for (size_t bit = 0; bit < 64 && ((live_in | live_out) >> bit) != 0; bit++) {
+                if ((live_in >> bit) & 1)  extend(w * 64 + bit, start);
+                if ((live_out >> bit) & 1) extend(w * 64 + bit, end);
+            }
+        }
+
+        for (size_t j = 0; j < block->size; j++, pos++) {
+            ir_instr_t* instr = &block->instrs[j];
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                if (operand->kind == IR_VALUE) {
+                    extend(operand->value, 2 * pos);
+                    intervals_[operand->value].uses++;
+                }
+            }
+            if (instr->dst != IR_NO_VALUE) {
+                extend(instr->dst, 2 * pos + 1);
+                intervals_[instr->dst].uses++;
+            }
+        }
+    }
+
+    for (size_t value = 0; value < values_amount_; value++) {
+        if (intervals_[value].uses > 0 && (on_stack == nullptr || !on_stack[value])) {
+            values_[values_size_++] = value;
+        }
+    }
+}
+
+void regalloc_t::extend(size_t value, size_t pos) {
+    live_interval_t* interval = &intervals_[value];
+    if (pos < interval->first) interval->first = pos;
+    if (pos > interval->last)  interval->last  = pos;
+}
+
+// NOTE - hottest first, equally hot values in order of their numbers
+bool regalloc_t::assign_regs() {
+    hotness_t* hotness = (hotness_t*) calloc(values_size_ + 1, sizeof(hotness_t));
+    if (hotness == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    for (size_t i = 0; i < values_size_; i++) {
+        hotness[i].uses  = intervals_[values_[i]].uses;
+        hotness[i].value = values_[i];
+    }
+    qsort(hotness, values_size_, sizeof(hotness_t), compare_hotness);
+    for (size_t i = 0; i < values_size_; i++) {
+        values_[i] = hotness[i].value;
+    }
+    free(hotness);
+
+    size_t allocated = 0;
+    for (size_t i = 0; i < values_size_; i++) {
+        for (size_t reg = 0; reg < REGALLOC_REGS_AMOUNT; reg++) {
+            if (!overlaps(values_[i], reg, false, i)) {
+                intervals_[values_[i]].reg = reg;
+                allocated++;
+                break;
+            }
+        }
+    }
+
+    LOG(INFO, "Registers were given to %zu of %zu values\n", allocated, values_size_);
+    return true;
+}
+
+bool regalloc_t::overlaps(size_t value, size_t place, bool is_slot, size_t assigned) {
+    live_interval_t* interval = &intervals_[value];
+    for (size_t i = 0; i < assigned; i++) {
+        live_interval_t* other = &intervals_[values_[i]];
+        size_t other_place = is_slot ? other->slot : other->reg;
+        if (other_place == place && other->first <= interval->last && interval->first <= other->last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE - walks every block backwards from its live-out, what is live right after
+//        a call and sits in a register has to survive it in a slot
+bool regalloc_t::find_call_sites(ir_func_t* func, const uint64_t* live) {
+    uint64_t* current = (uint64_t*) calloc(set_words_, sizeof(uint64_t));
+    if (current == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        memcpy(current, &live[(i * 2 + 1) * set_words_], set_words_ * sizeof(uint64_t));
+
+        for (size_t j = block->size; j > 0; j--) {
+            ir_instr_t* instr = &block->instrs[j - 1];
+            if (instr->opcode == IR_CALL && !add_call_site(i, j - 1, current)) {
+                free(current);
+                return false;
+            }
+
+            if (instr->dst != IR_NO_VALUE) {
+                current[instr->dst / 64] &= ~((uint64_t) 1 << (instr->dst % 64));
+            }
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                if (operand->kind == IR_VALUE) {
+                    current[operand->value / 64] |= (uint64_t) 1 << (operand->value % 64);
+                }
+            }
+        }
+    }
+
+    free(current);
+    return true;
+}
+
+bool regalloc_t::add_call_site(size_t block, size_t index, const uint64_t* live) {
+    if (calls_size_ == calls_capacity_) {
+        size_t capacity = (calls_capacity_ == 0) ? REGALLOC_CALLS_MIN_CAPACITY : calls_capacity_ * 2;
+        call_site_t* calls = (call_site_t*) realloc(calls_, sizeof(call_site_t) * capacity);
+        if (calls == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        calls_ = calls;
+        calls_capacity_ = capacity;
+    }
+
+    call_site_t* site = &calls_[calls_size_++];
+    site->block = block;
+    site->index = index;
+    site->live_amount = 0;
+    for (size_t i = 0; i < values_size_; i++) {
+        size_t value = values_[i];
+        if (intervals_[value].reg != REGALLOC_NO_REG && has_bit(live, value) &&
+            site->live_amount < REGALLOC_REGS_AMOUNT) {
+            site->live[site->live_amount++] = value;
+            is_saved_[value] = true;
+        }
+    }
+    return true;
+}
+
+// NOTE - the first free slot always exists: at most i values hold one already
+void regalloc_t::assign_slots() {
+    frame_size_ = 0;
+    for (size_t i = 0; i < values_size_; i++) {
+        size_t value = values_[i];
+        if (intervals_[value].reg != REGALLOC_NO_REG && !is_saved_[value]) {
+            continue;
+        }
+
+        size_t slot = 0;
+        while (overlaps(value, slot, true, i)) {
+            slot++;
+        }
+        intervals_[value].slot = slot;
+        if (slot + 1 > frame_size_) {
+            frame_size_ = slot + 1;
+        }
+    }
+}
+
+size_t regalloc_t::reg_of(size_t value) {
+    return (value < values_amount_) ? intervals_[value].reg : REGALLOC_NO_REG;
+}
+
+size_t regalloc_t::slot_of(size_t value) {
+    return (value < values_amount_) ? intervals_[value].slot : REGALLOC_NO_SLOT;
+}
+
+size_t regalloc_t::frame_size() {
+    return frame_size_;
+}
+
+// NOTE - fills values with the values kept in registers that are read after the call
+size_t regalloc_t::live_across(size_t block, size_t index, size_t* values) {
+    assert(values != nullptr);
+
+    if (calls_size_ == 0) {
+        return 0;
+    }
+
+    call_site_t key = {};
+    key.block = block;
+    key.index = index;
+    call_site_t* site = (call_site_t*) bsearch(&key, calls_, calls_size_, sizeof(call_site_t), compare_calls);
+    if (site == nullptr) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < site->live_amount; i++) {
+        values[i] = site->live[i];
+    }
+    return site->live_amount;
+}
+
+static int compare_calls(const void* call1, const void* call2) {
+    const call_site_t* site1 = (const call_site_t*) call1;
+    const call_site_t* site2 = (const call_site_t*) call2;
+    if (site1->block != site2->block) {
+        return (site1->block > site2->block) - (site1->block < site2->block);
+    }
+    return (site1->index > site2->index) - (site1->index < site2->index);
+}
+
+static int compare_hotness(const void* value1, const void* value2) {
+    const hotness_t* hot1 = (const hotness_t*) value1;
+    const hotness_t* hot2 = (const hotness_t*) value2;
+    if (hot1->uses != hot2->uses) {
+        return (hot1->uses < hot2->uses) - (hot1->uses > hot2->uses);
+    }
+    return (hot1->value > hot2->value) - (hot1->value < hot2->value);
+}
@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <string.h>
+#include "spu_binary.h"
+#include "logger.h"
+
+static int compare_labels(const void* label1, const void* label2);
+static spu_bin_mode_t mode_of(const spu_instr_t* instr);
+
+err_t spu_binary_t::assemble(const spu_code_t* code) {
+    assert(code != nullptr);
+
+    size_ = 0;
+    labels_size_ = 0;
+    size_t code_size = 0;
+    if (!place_labels(code, &code_size)) {
+        return SYNTAX_ERR;
+    }
+    if (!reserve(code_size)) {
+        return MEM_ALLOC_ERR;
+    }
+    if (!encode(code)) {
+        return SYNTAX_ERR;
+    }
+
+    LOG(INFO, "Assembled %zu instructions into %zu bytes, %zu labels\n", code->size_, size_, labels_size_);
+    return NO_ERR;
+}
+
+err_t spu_binary_t::write(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    spu_bin_header_t header = {};
+    header.signature = SPU_BIN_SIGNATURE;
+    header.version   = SPU_BIN_VERSION;
+    header.code_size = size_;
+
+    if (fwrite(&header, sizeof(spu_bin_header_t), 1, ostream) != 1 ||
+        (size_ > 0 && fwrite(bytes_, size_, 1, ostream) != 1)) {
+        LOG(ERROR, "Failed to write %zu bytes of SPU code\n", size_);
+        return SYNTAX_ERR;
+    }
+    return NO_ERR;
+}
+
+void spu_binary_t::dtor() {
+    free(bytes_);
+    bytes_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+
+    free(labels_);
+    labels_ = nullptr;
+    labels_size_ = 0;
+    labels_capacity_ = 0;
+}
+
+static spu_bin_mode_t mode_of(const spu_instr_t* instr) {
+    switch (instr->arg) {
+        case SPU_ARG_NUM:
+        case SPU_ARG_LABEL:
+            return SPU_BIN_IMM;
+        case SPU_ARG_REG:
+            return SPU_BIN_REG;
+        case SPU_ARG_MEM:
+            return SPU_BIN_MEM;
+        case SPU_ARG_NONE:
+        default:
+            return SPU_BIN_NONE;
+    }
+}
+
+size_t spu_bin_instr_size(const spu_instr_t* instr) {
+    if (instr->cmd == SPU_LABEL) {
+        return 0;
+    }
+
+    switch (mode_of(instr)) {
+        case SPU_BIN_IMM:
+            return 1 + sizeof(double);
+        case SPU_BIN_REG:
+            return 1 + 1;
+        case SPU_BIN_MEM:
+            return 1 + 1 + sizeof(double);
+        case SPU_BIN_NONE:
+        default:
+            return 1;
+    }
+}
+
+// NOTE - code_size is how many bytes encode() is going to emit
+bool spu_binary_t::place_labels(const spu_code_t* code, size_t* code_size) {
+    size_t addr = 0;
+    for (size_t i = 0; i < code->size_; i++) {
+        const spu_instr_t* instr = &code->instrs_[i];
+        if (instr->cmd == SPU_LABEL && !add_label(&instr->label, addr)) {
+            return false;
+        }
+        addr += spu_bin_instr_size(instr);
+    }
+    *code_size = addr;
+
+    if (labels_size_ > 0) {
+        qsort(labels_, labels_size_, sizeof(spu_bin_label_t), compare_labels);
+    }
+    for (size_t i = 1; i < labels_size_; i++) {
+        if (compare_labels(&labels_[i - 1], &labels_[i]) == 0) {
+            LOG(ERROR, "Label %s/%zu is defined twice\n",
+                labels_[i].label.name ? labels_[i].label.name : "", labels_[i].label.num);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool spu_binary_t::encode(const spu_code_t* code) {
+    for (size_t i = 0; i < code->size_; i++) {
+        const spu_instr_t* instr = &code->instrs_[i];
+        if (instr->cmd == SPU_LABEL) {
+            continue;
+        }
+
+        spu_bin_mode_t mode = mode_of(instr);
+        emit_byte((uint8_t) (((uint8_t) instr->cmd & SPU_BIN_CMD_MASK) | (mode << SPU_BIN_MODE_SHIFT)));
+
+        switch (instr->arg) {
+            case SPU_ARG_NUM:
+                emit_double(instr->num);
+                break;
+            case SPU_ARG_REG:
+                emit_byte((uint8_t) instr->index);
+                break;
+            case SPU_ARG_MEM:
+                emit_byte((uint8_t) SPU_REG_HX);
+                emit_double((double) instr->index);
+                break;
+            case SPU_ARG_LABEL: {
+                size_t addr = 0;
+                if (!find_label(&instr->label, &addr)) {
+                    LOG(ERROR, "Undefined label %s/%zu in %s\n",
+                        instr->label.name ? instr->label.name : "", instr->label.num, spu_cmd_name(instr->cmd));
+                    return false;
+                }
+                emit_double((double) addr);
+                break;
+            }
+            case SPU_ARG_NONE:
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+bool spu_binary_t::add_label(const spu_label_t* label, size_t addr) {
+    if (labels_size_ == labels_capacity_) {
+        size_t capacity = (labels_capacity_ == 0) ? SPU_BIN_LABELS_MIN_CAPACITY : labels_capacity_ * 2;
+        spu_bin_label_t* labels = (spu_bin_label_t*) realloc(labels_, sizeof(spu_bin_label_t) * capacity);
+        if (labels == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        labels_ = labels;
+        labels_capacity_ = capacity;
+    }
+
+    labels_[labels_size_].label = *label;
+    labels_[labels_size_].addr  = addr;
+    labels_size_++;
+    return true;
+}
+
+bool spu_binary_t::find_label(const spu_label_t* label, size_t* addr) {
+    if (labels_size_ == 0) {
+        return false;
+    }
+
+    spu_bin_label_t key = {};
+    key.label = *label;
+    spu_bin_label_t* found = (spu_bin_label_t*) bsearch(&key, labels_, labels_size_,
+                                                         sizeof(spu_bin_label_t), compare_labels);
+    if (found == nullptr) {
+        return false;
+    }
+
+    *addr = found->addr;
+    return true;
+}
+
+bool spu_binary_t::reserve(size_t size) {
+    if (size <= capacity_) {
+        return true;
+    }
+
+    size_t capacity = (size < SPU_BIN_MIN_CAPACITY) ? SPU_BIN_MIN_CAPACITY : size;
+    uint8_t* bytes = (uint8_t*) realloc(bytes_, capacity);
+    if (bytes == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    bytes_ = bytes;
+    capacity_ = capacity;
+    return true;
+}
+
+// NOTE - the bytes are reserved by assemble() before encoding
+void spu_binary_t::emit_byte(uint8_t byte) {
+    assert(size_ < capacity_);
+
+    bytes_[size_++] = byte;
+}
+
+void spu_binary_t::emit_double(double value) {
+    uint8_t bytes[sizeof(double)] = {};
+    memcpy(bytes, &value, sizeof(double));
+    for (size_t i = 0; i < sizeof(double); i++) {
+        emit_byte(bytes[i]);
+    }
+}
+
+static int compare_labels(const void* label1, const void* label2) {
+    const spu_label_t* first  = &((const spu_bin_label_t*) label1)->label;
+    const spu_label_t* second = &((const spu_bin_label_t*) label2)->label;
+    if (first->kind != second->kind) {
+        return (first->kind > second->kind) - (first->kind < second->kind);
+    }
+    if (first->kind == SPU_LABEL_FUNC) {
+        return strcmp(first->name, second->name);
+    }
+    return (first->num > second->num) - (first->num < second->num);
+}
@@ -0,0 +1,237 @@
+#include <assert.h>
+#include <string.h>
+#include "spu_code.h"
+#include "logger.h"
+
+static void print_label(FILE* ostream, const spu_label_t* label);
+
+const char* spu_cmd_name(spu_cmd_t cmd) {
+    switch (cmd) {
+        case SPU_LABEL:  return "";
+        case SPU_PUSH:   return "push";
+        case SPU_POP:    return "pop";
+        case SPU_ADD:    return "add";
+        case SPU_SUB:    return "sub";
+        case SPU_MUL:    return "mul";
+        case SPU_DIV:    return "div";
+        case SPU_POW:    return "pow";
+        case SPU_LOG:    return "log";
+        case SPU_LN:     return "ln";
+        case SPU_EXP:    return "exp";
+        case SPU_SIN:    return "sin";
+        case SPU_COS:    return "cos";
+        case SPU_TG:     return "tg";
+        case SPU_CTG:    return "ctg";
+        case SPU_SH:     return "sh";
+        case SPU_CH:     return "ch";
+        case SPU_TH:     return "th";
+        case SPU_CTH:    return "cth";
+        case SPU_ARCSIN: return "arcsin";
+        case SPU_ARCCOS: return "arccos";
+        case SPU_ARCTG:  return "arctg";
+        case SPU_ARCCTG: return "arcctg";
+        case SPU_ARCSH:  return "arcsh";
+        case SPU_ARCCH:  return "arcch";
+        case SPU_ARCTH:  return "arcth";
+        case SPU_ARCCTH: return "arccth";
+        case SPU_IN:     return "in";
+        case SPU_OUT:    return "out";
+        case SPU_JMP:    return "jmp";
+        case SPU_JA:     return "ja";
+        case SPU_JAE:    return "jae";
+        case SPU_JB:     return "jb";
+        case SPU_JBE:    return "jbe";
+        case SPU_JE:     return "je";
+        case SPU_JNE:    return "jne";
+        case SPU_CALL:   return "call";
+        case SPU_RET:    return "ret";
+        case SPU_HLT:    return "hlt";
+        case SPU_CMDS_AMOUNT:
+        default:         return "";
+    }
+}
+
+const char* spu_reg_name(size_t reg) {
+    switch (reg) {
+        case 0: return "ax";
+        case 1: return "bx";
+        case 2: return "cx";
+        case 3: return "dx";
+        case 4: return "ex";
+        case 5: return "fx";
+        case 6: return "gx";
+        case 7: return "hx";
+        default: return "";
+    }
+}
+
+bool spu_same_label(const spu_label_t* label1, const spu_label_t* label2) {
+    if (label1->kind != label2->kind) {
+        return false;
+    }
+    if (label1->kind == SPU_LABEL_FUNC) {
+        return strcmp(label1->name, label2->name) == 0;
+    }
+    return label1->num == label2->num;
+}
+
+// NOTE - numbers are compared bitwise, the rules never treat 0.0 and -0.0 as the same push
+bool spu_same_arg(const spu_instr_t* instr1, const spu_instr_t* instr2) {
+    if (instr1->arg != instr2->arg) {
+        return false;
+    }
+
+    switch (instr1->arg) {
+        case SPU_ARG_NONE:
+            return true;
+        case SPU_ARG_NUM:
+            return memcmp(&instr1->num, &instr2->num, sizeof(double)) == 0;
+        case SPU_ARG_REG:
+        case SPU_ARG_MEM:
+            return instr1->index == instr2->index;
+        case SPU_ARG_LABEL:
+            return spu_same_label(&instr1->label, &instr2->label);
+        default:
+            return false;
+    }
+}
+
+spu_instr_t* spu_code_t::new_instr(spu_cmd_t cmd, spu_arg_t arg) {
+    if (size_ == capacity_) {
+        size_t capacity = (capacity_ == 0) ? SPU_CODE_MIN_CAPACITY : capacity_ * 2;
+        spu_instr_t* instrs = (spu_instr_t*) realloc(instrs_, sizeof(spu_instr_t) * capacity);
+        if (instrs == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            is_alloc_err_ = true;
+            return nullptr;
+        }
+        instrs_ = instrs;
+        capacity_ = capacity;
+    }
+
+    spu_instr_t* instr = &instrs_[size_++];
+    memset(instr, 0, sizeof(spu_instr_t));
+    instr->cmd = cmd;
+    instr->arg = arg;
+    return instr;
+}
+
+void spu_code_t::add(spu_cmd_t cmd) {
+    new_instr(cmd, SPU_ARG_NONE);
+}
+
+void spu_code_t::add_num(spu_cmd_t cmd, double num) {
+    spu_instr_t* instr = new_instr(cmd, SPU_ARG_NUM);
+    if (instr != nullptr) {
+        instr->num = num;
+    }
+}
+
+void spu_code_t::add_reg(spu_cmd_t cmd, size_t reg) {
+    assert(reg < SPU_REGS_AMOUNT);
+
+    spu_instr_t* instr = new_instr(cmd, SPU_ARG_REG);
+    if (instr != nullptr) {
+        instr->index = reg;
+    }
+}
+
+void spu_code_t::add_mem(spu_cmd_t cmd, size_t offset) {
+    spu_instr_t* instr = new_instr(cmd, SPU_ARG_MEM);
+    if (instr != nullptr) {
+        instr->index = offset;
+    }
+}
+
+void spu_code_t::add_label(spu_cmd_t cmd, spu_label_t label) {
+    spu_instr_t* instr = new_instr(cmd, SPU_ARG_LABEL);
+    if (instr != nullptr) {
+        instr->label = label;
+    }
+}
+
+void spu_code_t::append(const spu_code_t* code) {
+    assert(code != nullptr);
+
+    for (size_t i = 0; i < code->size_; i++) {
+        spu_instr_t* instr = new_instr(code->instrs_[i].cmd, code->instrs_[i].arg);
+        if (instr == nullptr) {
+            return;
+        }
+        *instr = code->instrs_[i];
+    }
+}
+
+// NOTE - jump labels of a function compiled on its own start from 0, base moves
+//        them after the labels of the functions before it
+void spu_code_t::move_labels(size_t base) {
+    for (size_t i = 0; i < size_; i++) {
+        spu_instr_t* instr = &instrs_[i];
+        if (instr->arg == SPU_ARG_LABEL && instr->label.kind != SPU_LABEL_FUNC) {
+            instr->label.num += base;
+        }
+    }
+}
+
+static void print_label(FILE* ostream, const spu_label_t* label) {
+    switch (label->kind) {
+        case SPU_LABEL_FUNC:
+            fprintf(ostream, "%s:", label->name);
+            break;
+        case SPU_LABEL_ELSE:
+            fprintf(ostream, "%zu:", label->num);
+            break;
+        case SPU_LABEL_FINISH:
+            fprintf(ostream, "finish_%zu:", label->num);
+            break;
+        default:
+            break;
+    }
+}
+
+void spu_code_t::print(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    for (size_t i = 0; i < size_; i++) {
+        spu_instr_t* instr = &instrs_[i];
+        if (instr->cmd == SPU_LABEL) {
+            print_label(ostream, &instr->label);
+            fprintf(ostream, "\n");
+            continue;
+        }
+
+        fprintf(ostream, "%s", spu_cmd_name(instr->cmd));
+        switch (instr->arg) {
+            case SPU_ARG_NUM:
+                fprintf(ostream, " %.17g", instr->num);
+                break;
+            case SPU_ARG_REG:
+                fprintf(ostream, " %s", spu_reg_name(instr->index));
+                break;
+            case SPU_ARG_MEM:
+                fprintf(ostream, " [hx+%zu]", instr->index);
+                break;
+            case SPU_ARG_LABEL:
+                fprintf(ostream, " ");
+                print_label(ostream, &instr->label);
+                break;
+            case SPU_ARG_NONE:
+            default:
+                break;
+        }
+        fprintf(ostream, "\n");
+    }
+}
+
+void spu_code_t::clear() {
+    size_ = 0;
+    is_alloc_err_ = false;
+}
+
+void spu_code_t::dtor() {
+    free(instrs_);
+    instrs_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+    is_alloc_err_ = false;
+}
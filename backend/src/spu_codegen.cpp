@@ -0,0 +1,550 @@
+#include <assert.h>
+#include "spu_codegen.h"
+#include "prog_tree.h"
+#include "ir.h"
+#include "spu_code.h"
+#include "logger.h"
+
+typedef struct {
+    size_t defs;
+    size_t uses;
+    size_t def_block;
+    size_t use_block;
+} value_info_t;
+
+static spu_label_t func_label(const char* name);
+static spu_label_t jmp_label(spu_label_kind_t kind, size_t num);
+static spu_cmd_t arith_cmd(ir_opcode_t opcode);
+static spu_cmd_t math_cmd(int op);
+static spu_cmd_t jump_cmd(int op);
+static int mirror_cmp(int op);
+
+// NOTE - jump labels of the function are numbered from 0 by block, labels_amount
+//        is how many numbers it took
+bool spu_codegen_t::compile(prog_tree_t* tree, node_t* decl, spu_code_t* code, size_t* labels_amount) {
+    assert(tree != nullptr);
+    assert(decl != nullptr);
+    assert(code != nullptr);
+    assert(labels_amount != nullptr);
+
+    tree_ = tree;
+    code_ = code;
+    *labels_amount = 0;
+
+    ir_func_t* func = ir_.build_func(tree, decl);
+    bool is_ok = func != nullptr;
+    if (is_ok) {
+        is_ok = ir_.leave_ssa() && print_func(func);
+        *labels_amount = func->blocks_size;
+    }
+
+    ir_.dtor();
+    return is_ok;
+}
+
+void spu_codegen_t::dtor() {
+    ir_.dtor();
+    regalloc_.dtor();
+
+    free(on_stack_);
+    on_stack_ = nullptr;
+    free(pending_);
+    pending_ = nullptr;
+    pending_size_ = 0;
+    values_capacity_ = 0;
+}
+
+const peephole_t* spu_codegen_t::peephole() {
+    return &peephole_;
+}
+
+bool spu_codegen_t::reserve(size_t values_amount) {
+    if (values_amount <= values_capacity_) {
+        return true;
+    }
+
+    free(on_stack_);
+    free(pending_);
+    on_stack_ = (bool*) calloc(values_amount, sizeof(bool));
+    pending_  = (size_t*) calloc(values_amount, sizeof(size_t));
+    if (on_stack_ == nullptr || pending_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(on_stack_);
+        on_stack_ = nullptr;
+        free(pending_);
+        pending_ = nullptr;
+        values_capacity_ = 0;
+        return false;
+    }
+    values_capacity_ = values_amount;
+    return true;
+}
+
+// NOTE - a value defined once and read once later in the same block is a candidate
+//        to stay on the stack. The blocks are replayed with the SPU stack in mind:
+//        an instruction pops its stacked operands from the top, so they have to be
+//        there in the right order with nothing of ours above them. Every candidate
+//        breaking that goes back to memory and the replay starts over
+bool spu_codegen_t::plan_stack(ir_func_t* func) {
+    if (!reserve(func->values_amount)) {
+        return false;
+    }
+
+    value_info_t* info = (value_info_t*) calloc(func->values_amount + 1, sizeof(value_info_t));
+    if (info == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < func->params_amount; i++) {
+        info[func->params[i]].defs++;
+    }
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        ir_block_t* block = &func->blocks[i];
+        for (size_t j = 0; j < block->size; j++) {
+            ir_instr_t* instr = &block->instrs[j];
+            if (instr->opcode == IR_CALL && instr->list_size > SPU_CODEGEN_MAX_OPERANDS) {
+                LOG(ERROR, "Function %s passes more than %zu arguments\n", func->name, SPU_CODEGEN_MAX_OPERANDS);
+                free(info);
+                return false;
+            }
+
+            for (size_t k = 0; k < ir_operands_amount(instr); k++) {
+                ir_operand_t* operand = ir_operand(instr, k);
+                if (operand->kind == IR_VALUE) {
+                    info[operand->value].uses++;
+                    info[operand->value].use_block = i;
+                }
+            }
+            if (instr->dst != IR_NO_VALUE) {
+                info[instr->dst].defs++;
+                info[instr->dst].def_block = i;
+            }
+        }
+    }
+
+    for (size_t value = 0; value < func->values_amount; value++) {
+        on_stack_[value] = info[value].defs == 1 && info[value].uses == 1 &&
+                           info[value].def_block == info[value].use_block;
+    }
+    free(info);
+
+    bool is_changed = true;
+    while (is_changed) {
+        is_changed = false;
+        for (size_t i = 0; i < func->blocks_size; i++) {
+            ir_block_t* block = &func->blocks[i];
+            pending_size_ = 0;
+
+            for (size_t j = 0; j < block->size; j++) {
+                ir_instr_t* instr = &block->instrs[j];
+                ir_operand_t operands[SPU_CODEGEN_MAX_OPERANDS] = {};
+                int op = 0;
+                size_t amount = stack_operands(instr, operands, &op);
+                if (!take(operands, amount, true)) {
+                    is_changed = true;
+                }
+                if (instr->dst != IR_NO_VALUE && on_stack_[instr->dst]) {
+                    pending_[pending_size_++] = instr->dst;
+                }
+            }
+
+            if (pending_size_ > 0) {
+                for (size_t k = 0; k < pending_size_; k++) {
+                    on_stack_[pending_[k]] = false;
+                }
+                pending_size_ = 0;
+                is_changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+// NOTE - operands in the order they are pushed; add, mul and comparisons put
+//        a stacked right operand first, it is already where it has to be
+size_t spu_codegen_t::stack_operands(ir_instr_t* instr, ir_operand_t* operands, int* op) {
+    assert(instr != nullptr);
+    assert(operands != nullptr);
+    assert(op != nullptr);
+
+    *op = instr->op;
+    switch ((int) instr->opcode) {
+        case IR_ADD:
+        case IR_MUL:
+        case IR_BR: {
+            if (!is_stacked(&instr->a) && is_stacked(&instr->b)) {
+                operands[0] = instr->b;
+                operands[1] = instr->a;
+                if (instr->opcode == IR_BR) {
+                    *op = mirror_cmp(instr->op);
+                }
+            }
+            else {
+                operands[0] = instr->a;
+                operands[1] = instr->b;
+            }
+            return 2;
+        }
+        case IR_SUB:
+        case IR_DIV:
+        case IR_POW:
+        case IR_LOG: {
+            operands[0] = instr->a;
+            operands[1] = instr->b;
+            return 2;
+        }
+        case IR_MOV:
+        case IR_NEG:
+        case IR_MATH:
+        case IR_OUT: {
+            operands[0] = instr->a;
+            return 1;
+        }
+        case IR_CALL: {
+            size_t amount = (instr->list_size < SPU_CODEGEN_MAX_OPERANDS) ? instr->list_size : SPU_CODEGEN_MAX_OPERANDS;
+            for (size_t i = 0; i < amount; i++) {
+                operands[i] = instr->list[i];
+            }
+            return amount;
+        }
+        default:
+            return 0;
+    }
+}
+
+bool spu_codegen_t::is_stacked(const ir_operand_t* operand) {
+    return operand->kind == IR_VALUE && on_stack_[operand->value];
+}
+
+// NOTE - the leading stacked operands must be the top of pending_ in the same order
+//        and no later operand may be stacked. While planning a mismatch sends every
+//        value involved back to memory, when printing it is a bug
+bool spu_codegen_t::take(ir_operand_t* operands, size_t amount, bool is_planning) {
+    size_t stacked = 0;
+    while (stacked < amount && is_stacked(&operands[stacked])) {
+        stacked++;
+    }
+
+    bool is_ok = stacked <= pending_size_;
+    for (size_t i = 0; i < stacked && is_ok; i++) {
+        is_ok = pending_[pending_size_ - stacked + i] == operands[i].value;
+    }
+    for (size_t i = stacked; i < amount && is_ok; i++) {
+        is_ok = !is_stacked(&operands[i]);
+    }
+
+    if (is_ok) {
+        pending_size_ -= stacked;
+        if (!is_planning) {
+            for (size_t i = stacked; i < amount; i++) {
+                print_operand(&operands[i]);
+            }
+        }
+        return true;
+    }
+
+    if (!is_planning) {
+        LOG(ERROR, "Operands are not on top of the stack\n");
+        return false;
+    }
+    for (size_t i = 0; i < pending_size_; i++) {
+        on_stack_[pending_[i]] = false;
+    }
+    for (size_t i = 0; i < amount; i++) {
+        if (operands[i].kind == IR_VALUE) {
+            on_stack_[operands[i].value] = false;
+        }
+    }
+    pending_size_ = 0;
+    return false;
+}
+
+bool spu_codegen_t::print_func(ir_func_t* func) {
+    assert(func != nullptr);
+
+    if (func->params_amount > REGALLOC_REGS_AMOUNT) {
+        LOG(ERROR, "Function %s has more than %zu parameters\n", func->name, REGALLOC_REGS_AMOUNT);
+        return false;
+    }
+    if (!plan_stack(func) || !regalloc_.allocate(func, on_stack_)) {
+        return false;
+    }
+
+    code_->add_label(SPU_LABEL, func_label(func->name));
+
+    // NOTE - parameters may move to other registers, so all of them are pushed
+    //        first and popped to their places in reverse order
+    for (size_t i = 0; i < func->params_amount; i++) {
+        code_->add_reg(SPU_PUSH, i);
+    }
+    for (size_t i = func->params_amount; i > 0; i--) {
+        print_value(SPU_POP, func->params[i - 1]);
+    }
+
+    for (size_t i = 0; i < func->blocks_size; i++) {
+        if (i > 0) {
+            code_->add_label(SPU_LABEL, jmp_label(SPU_LABEL_ELSE, i));
+        }
+
+        pending_size_ = 0;
+        for (size_t j = 0; j < func->blocks[i].size; j++) {
+            if (!print_instr(func, i, j)) {
+                code_->clear();
+                return false;
+            }
+        }
+    }
+
+    if (code_->is_alloc_err_) {
+        code_->clear();
+        return false;
+    }
+
+    peephole_.run(code_);
+    return true;
+}
+
+bool spu_codegen_t::print_instr(ir_func_t* func, size_t block, size_t index) {
+    ir_instr_t* instr = &func->blocks[block].instrs[index];
+    switch ((int) instr->opcode) {
+        case IR_CALL:
+            return print_call(instr, block, index);
+        case IR_BR:
+            return print_branch(instr, block);
+        case IR_JMP: {
+            if (instr->targets[0] != block + 1) {
+                code_->add_label(SPU_JMP, jmp_label(SPU_LABEL_ELSE, instr->targets[0]));
+            }
+            return true;
+        }
+        case IR_RET: {
+            code_->add(SPU_RET);
+            return true;
+        }
+        case IR_IN: {
+            code_->add(SPU_IN);
+            store(instr->dst);
+            return true;
+        }
+        case IR_PHI: {
+            LOG(ERROR, "Phi in %s is left after SSA\n", func->name);
+            return false;
+        }
+        default:
+            break;
+    }
+
+    ir_operand_t operands[SPU_CODEGEN_MAX_OPERANDS] = {};
+    int op = 0;
+    size_t amount = stack_operands(instr, operands, &op);
+    if (!take(operands, amount, false)) {
+        return false;
+    }
+
+    switch ((int) instr->opcode) {
+        case IR_MOV:
+            break;
+        case IR_NEG: {
+            code_->add_num(SPU_PUSH, -1);
+            code_->add(SPU_MUL);
+            break;
+        }
+        case IR_MATH: {
+            spu_cmd_t cmd = math_cmd(op);
+            if (cmd == SPU_CMDS_AMOUNT) {
+                LOG(ERROR, "Unknown function %d\n", op);
+                return false;
+            }
+            code_->add(cmd);
+            break;
+        }
+        case IR_OUT: {
+            code_->add(SPU_OUT);
+            return true;
+        }
+        default:
+            code_->add(arith_cmd(instr->opcode));
+            break;
+    }
+
+    store(instr->dst);
+    return true;
+}
+
+// NOTE - arguments are pushed before any of them is popped to ax.., they may read
+//        the registers being filled. Registers live across the call are clobbered
+//        by the callee, so they go to [hx+N] before it and come back after it.
+//        The callee's frame starts right past the caller's one.
+bool spu_codegen_t::print_call(ir_instr_t* instr, size_t block, size_t index) {
+    assert(instr != nullptr);
+
+    size_t saved[REGALLOC_REGS_AMOUNT] = {};
+    size_t saved_amount = regalloc_.live_across(block, index, saved);
+    for (size_t i = 0; i < saved_amount; i++) {
+        code_->add_reg(SPU_PUSH, regalloc_.reg_of(saved[i]));
+        code_->add_mem(SPU_POP, regalloc_.slot_of(saved[i]));
+    }
+
+    ir_operand_t operands[SPU_CODEGEN_MAX_OPERANDS] = {};
+    int op = 0;
+    size_t amount = stack_operands(instr, operands, &op);
+    if (!take(operands, amount, false)) {
+        return false;
+    }
+    for (size_t i = amount; i > 0; i--) {
+        code_->add_reg(SPU_POP, i - 1);
+    }
+
+    move_frame(SPU_ADD);
+    code_->add_label(SPU_CALL, func_label(tree_->var_nametable_[instr->func].name));
+    move_frame(SPU_SUB);
+
+    for (size_t i = 0; i < saved_amount; i++) {
+        code_->add_mem(SPU_PUSH, regalloc_.slot_of(saved[i]));
+        code_->add_reg(SPU_POP, regalloc_.reg_of(saved[i]));
+    }
+    return true;
+}
+
+// NOTE - the block laid out next is reached by falling through. The jump is never
+//        inverted: with a NaN operand no SPU comparison holds, so the else target
+//        is taken as the interpreter takes it
+bool spu_codegen_t::print_branch(ir_instr_t* instr, size_t block) {
+    assert(instr != nullptr);
+
+    ir_operand_t operands[SPU_CODEGEN_MAX_OPERANDS] = {};
+    int op = 0;
+    size_t amount = stack_operands(instr, operands, &op);
+    if (!take(operands, amount, false)) {
+        return false;
+    }
+
+    if (jump_cmd(op) == SPU_JMP) {
+        LOG(ERROR, "Unknown comparison %d\n", op);
+        return false;
+    }
+
+    spu_label_t taken     = jmp_label(SPU_LABEL_ELSE, instr->targets[0]);
+    spu_label_t not_taken = jmp_label(SPU_LABEL_ELSE, instr->targets[1]);
+    code_->add_label(jump_cmd(op), taken);
+    if (instr->targets[1] != block + 1) {
+        code_->add_label(SPU_JMP, not_taken);
+    }
+    return true;
+}
+
+// NOTE - a function without slots leaves hx as it is
+void spu_codegen_t::move_frame(spu_cmd_t cmd) {
+    size_t frame_size = regalloc_.frame_size();
+    if (frame_size == 0) {
+        return;
+    }
+
+    code_->add_reg(SPU_PUSH, SPU_REG_HX);
+    code_->add_num(SPU_PUSH, (double) frame_size);
+    code_->add(cmd);
+    code_->add_reg(SPU_POP, SPU_REG_HX);
+}
+
+void spu_codegen_t::print_operand(const ir_operand_t* operand) {
+    if (operand->kind == IR_CONST) {
+        code_->add_num(SPU_PUSH, operand->num);
+    }
+    else {
+        print_value(SPU_PUSH, operand->value);
+    }
+}
+
+void spu_codegen_t::print_value(spu_cmd_t cmd, size_t value) {
+    size_t reg = regalloc_.reg_of(value);
+    if (reg != REGALLOC_NO_REG) {
+        code_->add_reg(cmd, reg);
+    }
+    else {
+        assert(regalloc_.slot_of(value) != REGALLOC_NO_SLOT);
+        code_->add_mem(cmd, regalloc_.slot_of(value));
+    }
+}
+
+void spu_codegen_t::store(size_t value) {
+    if (on_stack_[value]) {
+        pending_[pending_size_++] = value;
+    }
+    else {
+        print_value(SPU_POP, value);
+    }
+}
+
+static spu_label_t func_label(const char* name) {
+    spu_label_t label = {};
+    label.kind = SPU_LABEL_FUNC;
+    label.name = name;
+    return label;
+}
+
+static spu_label_t jmp_label(spu_label_kind_t kind, size_t num) {
+    spu_label_t label = {};
+    label.kind = kind;
+    label.num  = num;
+    return label;
+}
+
+static spu_cmd_t arith_cmd(ir_opcode_t opcode) {
+    switch ((int) opcode) {
+        case IR_ADD: return SPU_ADD;
+        case IR_SUB: return SPU_SUB;
+        case IR_MUL: return SPU_MUL;
+        case IR_DIV: return SPU_DIV;
+        case IR_POW: return SPU_POW;
+        case IR_LOG: return SPU_LOG;
+        default:     return SPU_CMDS_AMOUNT;
+    }
+}
+
+static spu_cmd_t math_cmd(int op) {
+    switch (op) {
+        case LN:     return SPU_LN;
+        case EXP:    return SPU_EXP;
+        case SIN:    return SPU_SIN;
+        case COS:    return SPU_COS;
+        case TG:     return SPU_TG;
+        case CTG:    return SPU_CTG;
+        case SH:     return SPU_SH;
+        case CH:     return SPU_CH;
+        case TH:     return SPU_TH;
+        case CTH:    return SPU_CTH;
+        case ARCSIN: return SPU_ARCSIN;
+        case ARCCOS: return SPU_ARCCOS;
+        case ARCTG:  return SPU_ARCTG;
+        case ARCCTG: return SPU_ARCCTG;
+        case ARCSH:  return SPU_ARCSH;
+        case ARCCH:  return SPU_ARCCH;
+        case ARCTH:  return SPU_ARCTH;
+        case ARCCTH: return SPU_ARCCTH;
+        default:     return SPU_CMDS_AMOUNT;
+    }
+}
+
+// NOTE - SPU_JMP stands for an unknown comparison
+static spu_cmd_t jump_cmd(int op) {
+    switch (op) {
+        case IA:   return SPU_JA;
+        case IAEQ: return SPU_JAE;
+        case IB:   return SPU_JB;
+        case IBEQ: return SPU_JBE;
+        case IE:   return SPU_JE;
+        case INE:  return SPU_JNE;
+        default:   return SPU_JMP;
+    }
+}
+
+static int mirror_cmp(int op) {
+    switch (op) {
+        case IA:   return IB;
+        case IAEQ: return IBEQ;
+        case IB:   return IA;
+        case IBEQ: return IAEQ;
+        default:   return op;
+    }
+}
@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "bytecode.h"
+#include "logger.h"
+
+const double VM_EPSILON = 1e-12;
+
+static double vm_math(uint32_t op, double val);
+
+err_t vm_t::init(bytecode_t* bytecode, FILE* istream, FILE* ostream) {
+    assert(bytecode != nullptr);
+    assert(istream != nullptr);
+    assert(ostream != nullptr);
+
+    bytecode_ = bytecode;
+    istream_  = istream;
+    ostream_  = ostream;
+    return NO_ERR;
+}
+
+void vm_t::dtor() {
+    for (size_t i = 0; code_ != nullptr && i < bytecode_->funcs_amount_; i++) {
+        free(code_[i]);
+    }
+    free(code_);
+    code_ = nullptr;
+
+    free(regs_);
+    regs_ = nullptr;
+    regs_size_ = 0;
+    regs_capacity_ = 0;
+
+    free(frames_);
+    frames_ = nullptr;
+    frames_size_ = 0;
+    frames_capacity_ = 0;
+}
+
+// NOTE - direct threading: every instruction keeps the address of its handler
+bool vm_t::thread_code(const void* const* handlers) {
+    code_ = (vm_instr_t**) calloc(bytecode_->funcs_amount_ + 1, sizeof(vm_instr_t*));
+    if (code_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < bytecode_->funcs_amount_; i++) {
+        bc_func_t* func = &bytecode_->funcs_[i];
+
+        code_[i] = (vm_instr_t*) calloc(func->code_size + 1, sizeof(vm_instr_t));
+        if (code_[i] == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+
+        for (size_t ip = 0; ip < func->code_size; ip++) {
+            bc_instr_t* instr = &func->code[ip];
+            if (instr->op >= BC_OPS_AMOUNT) {
+                LOG(ERROR, "Unknown bytecode %u in %s:%zu\n", instr->op, func->name, ip);
+                return false;
+            }
+
+            code_[i][ip].handler = handlers[instr->op];
+            code_[i][ip].a = instr->a;
+            code_[i][ip].b = instr->b;
+            code_[i][ip].c = instr->c;
+        }
+    }
+    return true;
+}
+
+bool vm_t::push_frame(size_t func, size_t ret_pc) {
+    if (frames_size_ == VM_MAX_DEPTH) {
+        LOG(ERROR, "Call depth exceeded %zu\n", VM_MAX_DEPTH);
+        return false;
+    }
+
+    if (frames_size_ == frames_capacity_) {
+        size_t capacity = (frames_capacity_ == 0) ? VM_FRAMES_MIN_CAPACITY : frames_capacity_ * 2;
+        vm_frame_t* frames = (vm_frame_t*) realloc(frames_, sizeof(vm_frame_t) * capacity);
+        if (frames == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        frames_ = frames;
+        frames_capacity_ = capacity;
+    }
+
+    size_t regs_amount = bytecode_->funcs_[func].regs_amount;
+    if (regs_size_ + regs_amount > regs_capacity_) {
+        size_t capacity = (regs_capacity_ == 0) ? VM_REGS_MIN_CAPACITY : regs_capacity_ * 2;
+        while (capacity < regs_size_ + regs_amount) {
+            capacity *= 2;
+        }
+
+        double* regs = (double*) realloc(regs_, sizeof(double) * capacity);
+        if (regs == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        regs_ = regs;
+        regs_capacity_ = capacity;
+    }
+
+    vm_frame_t* frame = &frames_[frames_size_++];
+    frame->func   = func;
+    frame->ret_pc = ret_pc;
+    frame->base   = regs_size_;
+
+    memset(regs_ + regs_size_, 0, sizeof(double) * regs_amount);
+    regs_size_ += regs_amount;
+    return true;
+}
+
+err_t vm_t::run() {
+    static const void* const handlers[BC_OPS_AMOUNT] = {
+        &&op_loadk, &&op_mov, &&op_neg, &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_pow,
+        &&op_log, &&op_math, &&op_jmp, &&op_je, &&op_jne, &&op_jna, &&op_jnae, &&op_jnb, &&op_jnbe,
+        &&op_in, &&op_out, &&op_call, &&op_ret};
+
+    if (code_ == nullptr && !thread_code(handlers)) {
+        return MEM_ALLOC_ERR;
+    }
+
+    size_t func = bytecode_->main_;
+    if (!push_frame(func, 0)) {
+        return MEM_ALLOC_ERR;
+    }
+
+    err_t status = NO_ERR;
+    const vm_instr_t* code = code_[func];
+    const vm_instr_t* ip = code;
+    const double* consts = bytecode_->funcs_[func].consts;
+    double* regs = regs_;
+
+    #define DISPATCH() goto *ip->handler
+    #define NEXT()     do { ip++; goto *ip->handler; } while (0)
+    #define JUMP_IF(cond)                   \
+        do {                                \
+            if (cond) ip = code + ip->a;    \
+            else      ip++;                 \
+            DISPATCH();                     \
+        } while (0)
+    #define EQUAL() (fabs(regs[ip->b] - regs[ip->c]) < VM_EPSILON)
+
+    DISPATCH();
+
+op_loadk: regs[ip->a] = consts[ip->b];                  NEXT();
+op_mov:   regs[ip->a] = regs[ip->b];                    NEXT();
+op_neg:   regs[ip->a] = -regs[ip->b];                   NEXT();
+op_add:   regs[ip->a] = regs[ip->b] + regs[ip->c];      NEXT();
+op_sub:   regs[ip->a] = regs[ip->b] - regs[ip->c];      NEXT();
+op_mul:   regs[ip->a] = regs[ip->b] * regs[ip->c];      NEXT();
+op_div:   regs[ip->a] = regs[ip->b] / regs[ip->c];      NEXT();
+op_pow:   regs[ip->a] = pow(regs[ip->b], regs[ip->c]);  NEXT();
+op_log:   regs[ip->a] = log(regs[ip->c]) / log(regs[ip->b]); NEXT();
+op_math:  regs[ip->a] = vm_math(ip->c, regs[ip->b]);    NEXT();
+
+op_jmp:   ip = code + ip->a;                                      DISPATCH();
+op_je:    JUMP_IF(EQUAL());
+op_jne:   JUMP_IF(!EQUAL());
+op_jna:   JUMP_IF(!(!EQUAL() && regs[ip->b] > regs[ip->c]));
+op_jnae:  JUMP_IF(!(EQUAL() || regs[ip->b] > regs[ip->c]));
+op_jnb:   JUMP_IF(!(!EQUAL() && regs[ip->b] < regs[ip->c]));
+op_jnbe:  JUMP_IF(!(EQUAL() || regs[ip->b] < regs[ip->c]));
+
+op_in:
+    if (fscanf(istream_, "%lf", &regs[ip->a]) != 1) {
+        LOG(ERROR, "Failed to scan a value\n");
+        status = SYNTAX_ERR;
+        goto finish;
+    }
+    NEXT();
+op_out:
+    fprintf(ostream_, "%lg\n", regs[ip->a]);
+    NEXT();
+
+op_call: {
+    size_t callee = ip->a;
+    size_t caller_base = (size_t) (regs - regs_);
+    size_t ret_pc = (size_t) (ip - code) + 1;
+    uint32_t first = ip->b;
+    uint32_t amount = ip->c;
+
+    if (!push_frame(callee, ret_pc)) {
+        status = MEM_ALLOC_ERR;
+        goto finish;
+    }
+
+    const uint32_t* params = bytecode_->funcs_[callee].params;
+    double* caller_regs = regs_ + caller_base;
+    regs = regs_ + frames_[frames_size_ - 1].base;
+    for (uint32_t i = 0; i < amount; i++) {
+        regs[params[i]] = caller_regs[first + i];
+    }
+
+    code = code_[callee];
+    consts = bytecode_->funcs_[callee].consts;
+    ip = code;
+    DISPATCH();
+}
+op_ret: {
+    vm_frame_t* frame = &frames_[--frames_size_];
+    regs_size_ = frame->base;
+    if (frames_size_ == 0) {
+        goto finish;
+    }
+
+    size_t ret_pc = frame->ret_pc;
+    vm_frame_t* caller = &frames_[frames_size_ - 1];
+    code = code_[caller->func];
+    consts = bytecode_->funcs_[caller->func].consts;
+    regs = regs_ + caller->base;
+    ip = code + ret_pc;
+    DISPATCH();
+}
+
+    #undef DISPATCH
+    #undef NEXT
+    #undef JUMP_IF
+    #undef EQUAL
+
+finish:
+    frames_size_ = 0;
+    regs_size_ = 0;
+    return status;
+}
+
+static double vm_math(uint32_t op, double val) {
+    switch (op) {
+        case SIN:    return sin(val);
+        case COS:    return cos(val);
+        case TG:     return tan(val);
+        case CTG:    return 1 / tan(val);
+        case SH:     return sinh(val);
+        case CH:     return cosh(val);
+        case TH:     return tanh(val);
+        case CTH:    return 1 / tanh(val);
+        case ARCSIN: return asin(val);
+        case ARCCOS: return acos(val);
+        case ARCTG:  return atan(val);
+        case ARCCTG: return M_PI / 2 - atan(val);
+        case ARCSH:  return asinh(val);
+        case ARCCH:  return acosh(val);
+        case ARCTH:  return atanh(val);
+        case ARCCTH: return atanh(val);
+        case LN:     return log(val);
+        case EXP:    return exp(val);
+        default:
+            LOG(ERROR, "Undefined operation %u\n", op);
+            return NAN;
+    }
+}
@@ -0,0 +1,597 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include "x86_backend.h"
+#include "prog_tree.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+void x86_backend_t::init(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    prog_tree_ = *tree;
+    *tree = prog_tree_t();
+}
+
+void x86_backend_t::dtor() {
+    prog_tree_.tree_dtor();
+
+    free(decls_);
+    decls_ = nullptr;
+    free(params_amount_);
+    params_amount_ = nullptr;
+    free(slots_);
+    slots_ = nullptr;
+    names_amount_ = 0;
+
+    free(consts_);
+    consts_ = nullptr;
+    consts_size_ = 0;
+    consts_capacity_ = 0;
+}
+
+err_t x86_backend_t::translate_to_x86(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    ostream_ = ostream;
+    names_amount_ = prog_tree_.var_nametable_size();
+    decls_         = (node_t**) calloc(names_amount_ + 1, sizeof(node_t*));
+    params_amount_ = (size_t*)  calloc(names_amount_ + 1, sizeof(size_t));
+    slots_         = (size_t*)  calloc(names_amount_ + 1, sizeof(size_t));
+    if (decls_ == nullptr || params_amount_ == nullptr || slots_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return MEM_ALLOC_ERR;
+    }
+
+    if (!index_funcs()) {
+        return SYNTAX_ERR;
+    }
+
+    print_runtime();
+    for (node_t* list = prog_tree_.root_; list != nullptr; list = list->right) {
+        if (!print_func(list->left)) {
+            return SYNTAX_ERR;
+        }
+    }
+    print_consts();
+    return NO_ERR;
+}
+
+// NOTE - argument and parameter lists end either with nullptr or with a bare last item
+node_t* x86_backend_t::next_item(node_t** list) {
+    node_t* node = *list;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->type == OP && (int) node->value == SEMICOLON) {
+        *list = node->right;
+        return node->left;
+    }
+    *list = nullptr;
+    return node;
+}
+
+const char* x86_backend_t::name(node_t* node) {
+    return prog_tree_.var_nametable_[(size_t) node->value].name;
+}
+
+bool x86_backend_t::index_funcs() {
+    bool has_main = false;
+    for (node_t* list = prog_tree_.root_; list != nullptr; list = list->right) {
+        node_t* decl = list->left;
+        if (decl == nullptr || decl->type != OP || (int) decl->value != DECL ||
+            decl->left == nullptr || decl->left->left == nullptr || decl->left->left->type != FUNC) {
+            LOG(ERROR, "Syntax err at %p: expected a function declaration\n", decl);
+            return false;
+        }
+
+        size_t index = (size_t) decl->left->left->value;
+        decls_[index] = decl;
+        params_amount_[index] = 0;
+        for (node_t* params = decl->left->right; next_item(&params) != nullptr;) {
+            params_amount_[index]++;
+        }
+
+        if (params_amount_[index] > X86_MAX_ARGS) {
+            LOG(ERROR, "Function %s takes %zu arguments, at most %zu are passed in registers\n",
+                       name(decl->left->left), params_amount_[index], X86_MAX_ARGS);
+            return false;
+        }
+        has_main = has_main || strcmp(name(decl->left->left), "main") == 0;
+    }
+
+    if (!has_main) {
+        LOG(ERROR, "Function main was not declared\n");
+        return false;
+    }
+    return true;
+}
+
+void x86_backend_t::print_runtime() {
+    fprintf(ostream_, "    .text\n");
+    fprintf(ostream_, "    .globl main\n");
+    fprintf(ostream_, "    .type main, @function\n");
+    fprintf(ostream_, "main:\n");
+    fprintf(ostream_, "    subq $8, %%rsp\n");
+    fprintf(ostream_, "    call lang_main\n");
+    fprintf(ostream_, "    xorl %%eax, %%eax\n");
+    fprintf(ostream_, "    addq $8, %%rsp\n");
+    fprintf(ostream_, "    ret\n");
+    fprintf(ostream_, "    .size main, .-main\n");
+
+    // NOTE - rdi = address of the slot, exits with 1 when the input is not a number
+    fprintf(ostream_, "\n.Lrt_scan:\n");
+    fprintf(ostream_, "    subq $8, %%rsp\n");
+    fprintf(ostream_, "    movq %%rdi, %%rsi\n");
+    fprintf(ostream_, "    leaq .Lscan_fmt(%%rip), %%rdi\n");
+    fprintf(ostream_, "    xorl %%eax, %%eax\n");
+    fprintf(ostream_, "    call scanf@PLT\n");
+    fprintf(ostream_, "    cmpl $1, %%eax\n");
+    fprintf(ostream_, "    jne .Lrt_scan_fail\n");
+    fprintf(ostream_, "    addq $8, %%rsp\n");
+    fprintf(ostream_, "    ret\n");
+    fprintf(ostream_, ".Lrt_scan_fail:\n");
+    fprintf(ostream_, "    movl $1, %%edi\n");
+    fprintf(ostream_, "    call exit@PLT\n");
+
+    // NOTE - xmm0 = value
+    fprintf(ostream_, "\n.Lrt_print:\n");
+    fprintf(ostream_, "    subq $8, %%rsp\n");
+    fprintf(ostream_, "    leaq .Lprint_fmt(%%rip), %%rdi\n");
+    fprintf(ostream_, "    movl $1, %%eax\n");
+    fprintf(ostream_, "    call printf@PLT\n");
+    fprintf(ostream_, "    addq $8, %%rsp\n");
+    fprintf(ostream_, "    ret\n");
+}
+
+void x86_backend_t::print_consts() {
+    fprintf(ostream_, "\n    .section .rodata\n");
+    fprintf(ostream_, "    .align 16\n");
+    fprintf(ostream_, ".Lsign_mask:\n");
+    fprintf(ostream_, "    .quad 0x8000000000000000, 0\n");
+    fprintf(ostream_, ".Lscan_fmt:\n");
+    fprintf(ostream_, "    .string \"%%lf\"\n");
+    fprintf(ostream_, ".Lprint_fmt:\n");
+    fprintf(ostream_, "    .string \"%%lg\\n\"\n");
+
+    fprintf(ostream_, "    .align 8\n");
+    for (size_t i = 0; i < consts_size_; i++) {
+        fprintf(ostream_, ".LC%zu:\n", i);
+        fprintf(ostream_, "    .quad 0x%016" PRIx64 "\n", consts_[i]);
+    }
+    fprintf(ostream_, "    .section .note.GNU-stack,\"\",@progbits\n");
+}
+
+bool x86_backend_t::assign_slots(node_t* decl) {
+    for (size_t i = 0; i < names_amount_; i++) {
+        slots_[i] = X86_NO_SLOT;
+    }
+    slots_amount_ = 0;
+
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr;) {
+        if (param->type != VAR) {
+            LOG(ERROR, "Syntax err at %p: expected a parameter\n", param);
+            return false;
+        }
+        if (slots_[(size_t) param->value] == X86_NO_SLOT) {
+            slots_[(size_t) param->value] = slots_amount_++;
+        }
+    }
+
+    tree_walk_t walk = {};
+    walk.init(decl->right);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        node_t* node = step.node;
+        if (step.event != WALK_ENTER || node->type != VAR) {
+            continue;
+        }
+
+        bool is_callee = node->parent != nullptr && node->parent->type == OP &&
+                         (int) node->parent->value == CALL && node->parent->right == node;
+        if (!is_callee && slots_[(size_t) node->value] == X86_NO_SLOT) {
+            slots_[(size_t) node->value] = slots_amount_++;
+        }
+    }
+    bool is_ok = !walk.is_alloc_err();
+    walk.dtor();
+    return is_ok;
+}
+
+long x86_backend_t::slot_offset(node_t* var) {
+    if (var == nullptr || var->type != VAR || var->value < 0 || (size_t) var->value >= names_amount_ ||
+        slots_[(size_t) var->value] == X86_NO_SLOT) {
+        LOG(ERROR, "Expected a variable at %p\n", var);
+        return 0;
+    }
+    return -8 * (long) (slots_[(size_t) var->value] + 1);
+}
+
+bool x86_backend_t::print_func(node_t* decl) {
+    assert(decl != nullptr);
+
+    func_name_ = name(decl->left->left);
+    if (!assign_slots(decl)) {
+        return false;
+    }
+
+    size_t frame = (slots_amount_ * sizeof(double) + 15) & ~(size_t) 15;
+    fprintf(ostream_, "\n    .globl lang_%s\n", func_name_);
+    fprintf(ostream_, "    .type lang_%s, @function\n", func_name_);
+    fprintf(ostream_, "lang_%s:\n", func_name_);
+    fprintf(ostream_, "    pushq %%rbp\n");
+    fprintf(ostream_, "    movq %%rsp, %%rbp\n");
+    if (frame != 0) {
+        fprintf(ostream_, "    subq $%zu, %%rsp\n", frame);
+    }
+
+    // NOTE - parameters take the first slots, everything else starts from zero
+    size_t params_amount = params_amount_[(size_t) decl->left->left->value];
+    size_t i = 0;
+    for (node_t* params = decl->left->right, *param = nullptr; (param = next_item(&params)) != nullptr; i++) {
+        fprintf(ostream_, "    movsd %%xmm%zu, %ld(%%rbp)\n", i, slot_offset(param));
+    }
+    if (params_amount < slots_amount_) {
+        fprintf(ostream_, "    pxor %%xmm0, %%xmm0\n");
+    }
+    for (size_t slot = params_amount; slot < slots_amount_; slot++) {
+        fprintf(ostream_, "    movsd %%xmm0, %ld(%%rbp)\n", -8 * (long) (slot + 1));
+    }
+
+    if (!print_list(decl->right)) {
+        return false;
+    }
+
+    fprintf(ostream_, ".Lreturn_%s:\n", func_name_);
+    fprintf(ostream_, "    leave\n");
+    fprintf(ostream_, "    ret\n");
+    fprintf(ostream_, "    .size lang_%s, .-lang_%s\n", func_name_, func_name_);
+    return true;
+}
+
+bool x86_backend_t::print_list(node_t* list) {
+    while (list != nullptr && list->type == OP && (int) list->value == SEMICOLON) {
+        if (!print_stmt(list->left)) {
+            return false;
+        }
+        list = list->right;
+    }
+    return true;
+}
+
+bool x86_backend_t::print_stmt(node_t* stmt) {
+    if (stmt == nullptr) {
+        return true;
+    }
+
+    if (stmt->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a statement\n", stmt);
+        return false;
+    }
+
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            return print_stmt(stmt->left);
+        case EQ: {
+            long offset = slot_offset(stmt->left);
+            if (offset == 0 || !print_expr(stmt->right)) {
+                return false;
+            }
+            fprintf(ostream_, "    movsd %%xmm0, %ld(%%rbp)\n", offset);
+            return true;
+        }
+        case CALL:
+            return print_call(stmt);
+        case RETURN:
+            fprintf(ostream_, "    jmp .Lreturn_%s\n", func_name_);
+            return true;
+        case IF:
+            return print_if(stmt, nullptr);
+        case SEMICOLON:
+            return print_if(stmt->left, stmt->right);
+        case IN: {
+            long offset = slot_offset(stmt->left);
+            if (offset == 0) {
+                return false;
+            }
+            fprintf(ostream_, "    leaq %ld(%%rbp), %%rdi\n", offset);
+            fprintf(ostream_, "    call .Lrt_scan\n");
+            return true;
+        }
+        case OUT:
+            if (!print_expr(stmt->left)) {
+                return false;
+            }
+            fprintf(ostream_, "    call .Lrt_print\n");
+            return true;
+        default:
+            LOG(ERROR, "Unsupported statement %s at %p\n", op_to_name((int) stmt->value), stmt);
+            return false;
+    }
+}
+
+bool x86_backend_t::print_if(node_t* if_node, node_t* else_node) {
+    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF ||
+        if_node->left == nullptr || if_node->left->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected if\n", if_node);
+        return false;
+    }
+    if (else_node != nullptr && (else_node->type != OP || (int) else_node->value != ELSE)) {
+        LOG(ERROR, "Syntax err at %p: expected else\n", else_node);
+        return false;
+    }
+
+    // NOTE - jump over the body when the comparison is false, ucomisd sets
+    //        the flags like an unsigned integer compare. A NaN operand sets ZF, PF
+    //        and CF at once: then != is true and the rest are false, as in the interpreter
+    const char* jump = nullptr;
+    switch ((int) if_node->left->value) {
+        case IE:   jump = "jne"; break;
+        case INE:  jump = "je";  break;
+        case IA:   jump = "jbe"; break;
+        case IAEQ: jump = "jb";  break;
+        case IB:   jump = "jae"; break;
+        case IBEQ: jump = "ja";  break;
+        default:
+            LOG(ERROR, "Unknown comparison %s\n", op_to_name((int) if_node->left->value));
+            return false;
+    }
+
+    if (!print_expr(if_node->left->left)) {
+        return false;
+    }
+    push_xmm0();
+    if (!print_expr(if_node->left->right)) {
+        return false;
+    }
+    fprintf(ostream_, "    movapd %%xmm0, %%xmm1\n");
+    pop_xmm(0);
+
+    size_t num = prog_tree_.jmp_cnt_++;
+    fprintf(ostream_, "    ucomisd %%xmm1, %%xmm0\n");
+    if ((int) if_node->left->value == INE) {
+        fprintf(ostream_, "    jp .Lthen_%zu\n", num);
+        fprintf(ostream_, "    %s .Lelse_%zu\n", jump, num);
+        fprintf(ostream_, ".Lthen_%zu:\n", num);
+    }
+    else {
+        fprintf(ostream_, "    jp .Lelse_%zu\n", num);
+        fprintf(ostream_, "    %s .Lelse_%zu\n", jump, num);
+    }
+
+    if (!print_list(if_node->right)) {
+        return false;
+    }
+
+    if (else_node == nullptr) {
+        fprintf(ostream_, ".Lelse_%zu:\n", num);
+        return true;
+    }
+
+    fprintf(ostream_, "    jmp .Lfinish_%zu\n", num);
+    fprintf(ostream_, ".Lelse_%zu:\n", num);
+    if (!print_list(else_node->left)) {
+        return false;
+    }
+    fprintf(ostream_, ".Lfinish_%zu:\n", num);
+    return true;
+}
+
+bool x86_backend_t::print_call(node_t* call) {
+    node_t* callee = call->right;
+    if (callee == nullptr || callee->value < 0 || (size_t) callee->value >= names_amount_ ||
+        decls_[(size_t) callee->value] == nullptr) {
+        LOG(ERROR, "Call of an undeclared function at %p\n", call);
+        return false;
+    }
+
+    size_t args_amount = 0;
+    for (node_t* args = call->left, *arg = nullptr; (arg = next_item(&args)) != nullptr; args_amount++) {
+        if (!print_expr(arg)) {
+            return false;
+        }
+        push_xmm0();
+    }
+
+    if (args_amount != params_amount_[(size_t) callee->value]) {
+        LOG(ERROR, "Function %s takes %zu arguments, %zu given\n",
+                   name(callee), params_amount_[(size_t) callee->value], args_amount);
+        return false;
+    }
+
+    for (size_t i = args_amount; i > 0; i--) {
+        pop_xmm((int) i - 1);
+    }
+    fprintf(ostream_, "    call lang_%s\n", name(callee));
+    return true;
+}
+
+// NOTE - postorder walk, the top of the value stack is kept in xmm0
+bool x86_backend_t::print_expr(node_t* node) {
+    if (node == nullptr) {
+        LOG(ERROR, "Missing operand\n");
+        return false;
+    }
+
+    tree_walk_t walk = {};
+    walk.init(node);
+
+    bool is_ok = true;
+    size_t depth = 0;
+    walk_step_t step = {};
+    while (is_ok && walk.next(&step)) {
+        node_t* cur = step.node;
+        if (step.event == WALK_ENTER) {
+            continue;
+        }
+
+        switch (cur->type) {
+            case NUM:
+            case VAR: {
+                if (depth++ != 0) {
+                    push_xmm0();
+                }
+
+                if (cur->type == NUM) {
+                    is_ok = load_const(cur->value, 0);
+                    break;
+                }
+
+                long offset = slot_offset(cur);
+                is_ok = offset != 0;
+                fprintf(ostream_, "    movsd %ld(%%rbp), %%xmm0\n", offset);
+                break;
+            }
+            case OP:
+                if (cur->left == nullptr) {
+                    LOG(ERROR, "Missing operand of %s\n", op_to_name((int) cur->value));
+                    is_ok = false;
+                    break;
+                }
+                is_ok = print_op(cur);
+                if (cur->right != nullptr) {
+                    depth--;
+                }
+                break;
+            case FUNC:
+            default:
+                LOG(ERROR, "Unexpected node %d in an expression\n", cur->type);
+                is_ok = false;
+                break;
+        }
+    }
+    if (walk.is_alloc_err()) {
+        is_ok = false;
+    }
+    walk.dtor();
+    return is_ok;
+}
+
+bool x86_backend_t::print_op(node_t* node) {
+    if (node->right == nullptr) {
+        switch ((int) node->value) {
+            case SUB:
+                fprintf(ostream_, "    xorpd .Lsign_mask(%%rip), %%xmm0\n");
+                return true;
+            case ADD:
+                return true;
+            default:
+                return print_math((int) node->value);
+        }
+    }
+
+    fprintf(ostream_, "    movapd %%xmm0, %%xmm1\n");
+    pop_xmm(0);
+
+    switch ((int) node->value) {
+        case ADD:
+            fprintf(ostream_, "    addsd %%xmm1, %%xmm0\n");
+            return true;
+        case SUB:
+            fprintf(ostream_, "    subsd %%xmm1, %%xmm0\n");
+            return true;
+        case MUL:
+            fprintf(ostream_, "    mulsd %%xmm1, %%xmm0\n");
+            return true;
+        case DIV:
+            fprintf(ostream_, "    divsd %%xmm1, %%xmm0\n");
+            return true;
+        case POW:
+            fprintf(ostream_, "    call pow@PLT\n");
+            return true;
+        case LOG:
+            // NOTE - log_xmm0(xmm1) = ln(xmm1) / ln(xmm0)
+            push_xmm0();
+            fprintf(ostream_, "    movapd %%xmm1, %%xmm0\n");
+            fprintf(ostream_, "    call log@PLT\n");
+            push_xmm0();
+            fprintf(ostream_, "    movsd 16(%%rsp), %%xmm0\n");
+            fprintf(ostream_, "    call log@PLT\n");
+            fprintf(ostream_, "    movapd %%xmm0, %%xmm1\n");
+            pop_xmm(0);
+            fprintf(ostream_, "    addq $16, %%rsp\n");
+            fprintf(ostream_, "    divsd %%xmm1, %%xmm0\n");
+            return true;
+        default:
+            LOG(ERROR, "Unsupported binary operation %s\n", op_to_name((int) node->value));
+            return false;
+    }
+}
+
+bool x86_backend_t::print_math(int op) {
+    const char* func = nullptr;
+    switch (op) {
+        case SIN:    func = "sin";   break;
+        case COS:    func = "cos";   break;
+        case TG:     func = "tan";   break;
+        case CTG:    func = "tan";   break;
+        case SH:     func = "sinh";  break;
+        case CH:     func = "cosh";  break;
+        case TH:     func = "tanh";  break;
+        case CTH:    func = "tanh";  break;
+        case ARCSIN: func = "asin";  break;
+        case ARCCOS: func = "acos";  break;
+        case ARCTG:  func = "atan";  break;
+        case ARCCTG: func = "atan";  break;
+        case ARCSH:  func = "asinh"; break;
+        case ARCCH:  func = "acosh"; break;
+        case ARCTH:  func = "atanh"; break;
+        case ARCCTH: func = "atanh"; break;
+        case LN:     func = "log";   break;
+        case EXP:    func = "exp";   break;
+        default:
+            LOG(ERROR, "Undefined operation %s\n", op_to_name(op));
+            return false;
+    }
+    fprintf(ostream_, "    call %s@PLT\n", func);
+
+    // NOTE - results of the middleend's calculate_op for the same operation
+    if (op == CTG || op == CTH) {
+        fprintf(ostream_, "    movapd %%xmm0, %%xmm1\n");
+        if (!load_const(1, 0)) {
+            return false;
+        }
+        fprintf(ostream_, "    divsd %%xmm1, %%xmm0\n");
+    }
+    else if (op == ARCCTG) {
+        fprintf(ostream_, "    movapd %%xmm0, %%xmm1\n");
+        if (!load_const(M_PI / 2, 0)) {
+            return false;
+        }
+        fprintf(ostream_, "    subsd %%xmm1, %%xmm0\n");
+    }
+    return true;
+}
+
+void x86_backend_t::push_xmm0() {
+    fprintf(ostream_, "    subq $16, %%rsp\n");
+    fprintf(ostream_, "    movsd %%xmm0, (%%rsp)\n");
+}
+
+void x86_backend_t::pop_xmm(int reg) {
+    fprintf(ostream_, "    movsd (%%rsp), %%xmm%d\n", reg);
+    fprintf(ostream_, "    addq $16, %%rsp\n");
+}
+
+bool x86_backend_t::load_const(double value, int reg) {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if (consts_size_ == consts_capacity_) {
+        size_t capacity = (consts_capacity_ == 0) ? X86_CONSTS_MIN_CAPACITY : consts_capacity_ * 2;
+        uint64_t* consts = (uint64_t*) realloc(consts_, sizeof(uint64_t) * capacity);
+        if (consts == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        consts_ = consts;
+        consts_capacity_ = capacity;
+    }
+    consts_[consts_size_] = bits;
+
+    fprintf(ostream_, "    movsd .LC%zu(%%rip), %%xmm%d\n", consts_size_++, reg);
+    return true;
+}
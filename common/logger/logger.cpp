@@ -6,15 +6,27 @@
 #include "define_colors.h"
 
 static const char* LogMessageTypePrint(enum LogLevel level, bool color);
-static void TimePrint(FILE *out);
+static const char* TimeString();
 static void AestheticizeString(const char *src, char *dst, size_t max_len);
 
-const size_t MAXLINE = 100;
+const size_t MAXLINE         = 100;
+const size_t LOG_RECORD_SIZE = 1024;
+const size_t LOG_TIME_SIZE   = 32;
+const size_t LOG_BUFFER_SIZE = 1 << 16;
 
 //----------------------------------------------------------------------------------------------
 
+// NOTE - a thread with its own file logs there, the others share the process logger
+static logger_t* GetThreadLogger() {
+    static thread_local logger_t logger = {};
+    return &logger;
+}
+
 static logger_t* GetLogger() {
     static logger_t logger = {};
+    if (GetThreadLogger()->file_out != nullptr) {
+        return GetThreadLogger();
+    }
     return &logger;
 }
 
@@ -23,7 +35,9 @@ void LoggerSetFile(FILE* out) {
 
     GetLogger()->file_out = out;
 
-    if (setvbuf(GetLogger()->file_out, nullptr, _IONBF, 0)) {
+    // NOTE - records are buffered, an ERROR flushes them and exit() flushes the
+    //        rest, so only an abort may lose the records after the last error
+    if (setvbuf(GetLogger()->file_out, nullptr, _IOFBF, LOG_BUFFER_SIZE)) {
         fprintf(stderr, "WARNING\n");
     }
 }
@@ -32,32 +46,64 @@ void LoggerSetLevel(enum LogLevel level) {
     GetLogger()->min_level = level;
 }
 
+void LoggerSetThreadFile(FILE* out, enum LogLevel level) {
+    GetThreadLogger()->file_out  = out;
+    GetThreadLogger()->min_level = level;
+}
+
+bool LoggerIsEnabled(enum LogLevel level) {
+    return GetLogger()->file_out != nullptr && GetLogger()->min_level <= level;
+}
+
 //----------------------------------------------------------------------------------------------
 
 void Log(enum LogLevel status, const char* file, size_t line, const char* func, const char *fmt, ...) {
     assert(fmt != nullptr);
 
-    if (GetLogger()->min_level > status) {
+    logger_t* logger = GetLogger();
+    if (logger->min_level > status) {
         return;
     }
 
     char dst[MAXLINE] = "";
     AestheticizeString(fmt, dst, MAXLINE);
 
+    // NOTE - the record is formatted first and written at once under the file lock,
+    //        so records of different threads do not interleave. A message that does
+    //        not fit is printed right after the header instead
+    bool color = logger->file_out == stderr || logger->file_out == stdout;
+    char record[LOG_RECORD_SIZE] = "";
+    int header_len = snprintf(record, LOG_RECORD_SIZE, "%s:%zu (%s)\n%s%s", file, line, func,
+                              LogMessageTypePrint(status, color), TimeString());
+    size_t len = header_len < 0 ? 0 : (size_t) header_len;
+    if (len >= LOG_RECORD_SIZE) {
+        len = LOG_RECORD_SIZE - 1;
+    }
+
     va_list args;
     va_start (args, fmt);
 
-    bool color = GetLogger()->file_out == stderr || GetLogger()->file_out == stdout;
-    fprintf(GetLogger()->file_out, "%s:%zu (%s)\n", file, line, func);
-    fprintf(GetLogger()->file_out, "%s", LogMessageTypePrint (status, color));
-    TimePrint(GetLogger()->file_out);
-
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
-    vfprintf (GetLogger()->file_out, dst, args);
+    int message_len = vsnprintf(record + len, LOG_RECORD_SIZE - len, dst, args);
+    va_end (args);
+
+    flockfile(logger->file_out);
+    if (message_len >= 0 && len + (size_t) message_len < LOG_RECORD_SIZE) {
+        fwrite(record, sizeof(char), len + (size_t) message_len, logger->file_out);
+    }
+    else {
+        fwrite(record, sizeof(char), len, logger->file_out);
+        va_start (args, fmt);
+        vfprintf (logger->file_out, dst, args);
+        va_end (args);
+    }
 #pragma clang diagnostic pop
 
-    va_end (args);
+    if (status == ERROR) {
+        fflush(logger->file_out);
+    }
+    funlockfile(logger->file_out);
 }
 
 //----------------------------------------------------------------------------------------------
@@ -89,15 +135,24 @@ static const char* LogMessageTypePrint(const enum LogLevel level, const bool col
 
 #undef ADD_COLOR_
 
-static void TimePrint(FILE *out) {
-    assert(out != nullptr);
+// NOTE - the time only changes once a second, it is formatted again only then
+static const char* TimeString() {
+    static thread_local time_t last_time = 0;
+    static thread_local char time_str[LOG_TIME_SIZE] = "";
 
     time_t mytime = time(NULL);
-    struct tm *time = localtime(&mytime);
+    if (mytime == last_time) {
+        return time_str;
+    }
+    last_time = mytime;
 
-    fprintf(out, "%02d.%02d.%d %02d:%02d:%02d ",
-            time->tm_mday, time->tm_mon + 1, time->tm_year + 1900,
-            time->tm_hour, time->tm_min,     time->tm_sec);
+    struct tm time = {};
+    localtime_r(&mytime, &time);
+
+    if (strftime(time_str, LOG_TIME_SIZE, "%d.%m.%Y %H:%M:%S ", &time) == 0) {
+        time_str[0] = '\0';
+    }
+    return time_str;
 }
 
 static void AestheticizeString(const char *src, char *dst, const size_t max_len) {
@@ -23,9 +23,23 @@ void LoggerSetFile(FILE* out);
 
 void LoggerSetLevel(enum LogLevel level);
 
-#define LOG(status, ...)                                        \
-    do {                                                        \
-        Log(status, __FILE__, __LINE__, __func__, __VA_ARGS__); \
+// NOTE - logs of the calling thread go to out until it is reset with nullptr
+void LoggerSetThreadFile(FILE* out, enum LogLevel level);
+
+bool LoggerIsEnabled(enum LogLevel level);
+
+// NOTE - records below LOG_MIN_LEVEL are compiled out, build with -DLOG_MIN_LEVEL=2
+//        to keep only warnings and errors. A record filtered at runtime does not
+//        evaluate its arguments either
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+#define LOG(status, ...)                                                       \
+    do {                                                                       \
+        if ((int) (status) >= LOG_MIN_LEVEL && LoggerIsEnabled(status)) {      \
+            Log(status, __FILE__, __LINE__, __func__, __VA_ARGS__);            \
+        }                                                                      \
     } while(0)
 
 #endif /* LOGGER_H */
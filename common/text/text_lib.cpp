@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include "logger.h"
@@ -76,10 +78,54 @@ text_error_t text_ctor(text_t* text, FILE* istream) {
     return TEXT_NO_ERRORS;
 }
 
+// NOTE - read-only view of the file, the zero page tail past EOF serves as '\0' terminator,
+//        falls back to text_ctor() for streams that cannot be mapped
+text_error_t text_mmap_ctor(text_t* text, FILE* istream) {
+    assert(istream != nullptr);
+    assert(text != nullptr);
+
+    ssize_t file_size = find_file_size(istream);
+
+    if (file_size == -1) {
+        return TEXT_FILE_READ_ERROR;
+    }
+
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t mapped_size = ((size_t) file_size / page_size + 1) * page_size;
+
+    void* view = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (view == MAP_FAILED) {
+        LOG(WARNING, "Failed to reserve a text view, reading the file instead\n" STRERROR(errno));
+        return text_ctor(text, istream);
+    }
+
+    if (file_size != 0 &&
+        mmap(view, (size_t) file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fileno(istream), 0) == MAP_FAILED) {
+        LOG(WARNING, "Failed to map the file, reading it instead\n" STRERROR(errno));
+        munmap(view, mapped_size);
+        return text_ctor(text, istream);
+    }
+
+    text->symbols = (unsigned char*) view;
+    text->symbols_amount = (size_t) file_size + 1;
+    text->mapped_size = mapped_size;
+
+    LOG(INFO, "Text structure was successfully mapped\n");
+    return TEXT_NO_ERRORS;
+}
+
 void text_dtor(text_t* text) {
     assert(text != nullptr);
 
-    free(text->symbols);
+    if (text->mapped_size != 0) {
+        if (munmap(text->symbols, text->mapped_size) == -1) {
+            LOG(ERROR, "Failed to unmap the text\n" STRERROR(errno));
+        }
+        text->mapped_size = 0;
+    }
+    else {
+        free(text->symbols);
+    }
     text->symbols = nullptr;
 
     text->symbols_amount = 0;
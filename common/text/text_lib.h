@@ -6,6 +6,7 @@
 typedef struct {
     size_t symbols_amount;
     unsigned char* symbols;
+    size_t mapped_size;
 } text_t;
 
 typedef enum {
@@ -18,6 +19,7 @@ typedef enum {
 } text_error_t;
 
 text_error_t text_ctor(text_t* text, FILE* istream);
+text_error_t text_mmap_ctor(text_t* text, FILE* istream);
 void text_dtor(text_t* text);
 
 ssize_t find_file_size(FILE* istream);
@@ -1,8 +1,6 @@
 #!/bin/bash
 
 make
-./build/front
-./build/middle
-./build/backy
+./build/langc ./data/input/data.txt -o in.asm
 ./spu/run.sh
-rm -f in.asm in.bin m_out.txt out.txt
+rm -f in.asm in.bin
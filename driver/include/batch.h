@@ -0,0 +1,22 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+const size_t BATCH_MIN_CAPACITY = 64;
+const size_t BATCH_MAX_PATH_LEN = 4096;
+const char   BATCH_SOURCE_EXT[] = ".txt";
+
+typedef struct {
+    const char* out_dir;  // outputs go next to the sources if nullptr
+    size_t jobs;          // files compiled at once
+    bool spu_bin;
+} batch_opts_t;
+
+// NOTE - sources is either a directory, every .txt file in it is compiled, or a
+//        manifest with a path to a .txt file per line, empty lines and lines
+//        starting with '#' are skipped. Every file gets its own tree and its own
+//        output named after it, a failed file does not stop the others
+bool compile_batch(const char* sources, const batch_opts_t* opts);
+
+#endif /* BATCH_H */
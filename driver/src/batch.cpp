@@ -0,0 +1,389 @@
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "prog_tree.h"
+#include "middleend.h"
+#include "backend.h"
+#include "logger.h"
+
+typedef struct {
+    char** paths;
+    char** outputs;  // output of every source, filled by plan_outputs()
+    size_t size;
+    size_t capacity;
+} batch_sources_t;
+
+typedef struct {
+    const batch_sources_t* sources;
+    const batch_opts_t* opts;
+    bool* is_ok;  // result of every file
+
+    pthread_mutex_t lock;  // guards next
+    size_t next;
+} batch_jobs_t;
+
+static bool collect_sources(const char* sources, batch_sources_t* list);
+static bool read_dir(const char* dir_name, batch_sources_t* list);
+static bool read_manifest(const char* manifest, batch_sources_t* list);
+static bool add_source(batch_sources_t* list, const char* dir_name, const char* name);
+static bool is_source(const char* name);
+static bool plan_outputs(batch_sources_t* list, const batch_opts_t* opts);
+static void sources_dtor(batch_sources_t* list);
+static int compare_paths(const void* a, const void* b);
+static void* compile_files(void* arg);
+static bool compile_file(const char* source, const char* output, const batch_opts_t* opts);
+static bool output_path(const char* source, const batch_opts_t* opts, char* path);
+
+bool compile_batch(const char* sources, const batch_opts_t* opts) {
+    assert(sources != nullptr);
+    assert(opts != nullptr);
+
+    if (opts->out_dir != nullptr && mkdir(opts->out_dir, 0755) != 0 && errno != EEXIST) {
+        LOG(ERROR, "Failed to create %s\n" STRERROR(errno), opts->out_dir);
+        return false;
+    }
+
+    batch_sources_t list = {};
+    if (!collect_sources(sources, &list) || !plan_outputs(&list, opts)) {
+        sources_dtor(&list);
+        return false;
+    }
+
+    batch_jobs_t jobs = {};
+    jobs.sources = &list;
+    jobs.opts    = opts;
+    jobs.is_ok   = (bool*) calloc(list.size + 1, sizeof(bool));
+
+    size_t threads_amount = opts->jobs < list.size ? opts->jobs : list.size;
+    pthread_t* threads = (pthread_t*) calloc(threads_amount + 1, sizeof(pthread_t));
+    if (jobs.is_ok == nullptr || threads == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        free(threads);
+        free(jobs.is_ok);
+        sources_dtor(&list);
+        return false;
+    }
+    pthread_mutex_init(&jobs.lock, nullptr);
+
+    size_t started = 0;
+    while (started + 1 < threads_amount) {
+        if (pthread_create(&threads[started], nullptr, compile_files, &jobs) != 0) {
+            LOG(WARNING, "Failed to start a compiler thread, %zu are running\n", started + 1);
+            break;
+        }
+        started++;
+    }
+
+    compile_files(&jobs);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+
+    size_t failed = 0;
+    for (size_t i = 0; i < list.size; i++) {
+        if (!jobs.is_ok[i]) {
+            fprintf(stderr, "Failed to compile %s\n", list.paths[i]);
+            failed++;
+        }
+    }
+    LOG(INFO, "Batch: %zu files compiled, %zu failed\n", list.size - failed, failed);
+
+    free(threads);
+    free(jobs.is_ok);
+    pthread_mutex_destroy(&jobs.lock);
+    sources_dtor(&list);
+    return failed == 0;
+}
+
+static bool collect_sources(const char* sources, batch_sources_t* list) {
+    assert(sources != nullptr);
+    assert(list != nullptr);
+
+    struct stat info = {};
+    if (stat(sources, &info) != 0) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), sources);
+        return false;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        return read_dir(sources, list);
+    }
+    return read_manifest(sources, list);
+}
+
+// NOTE - readdir gives no order, the files are sorted so that logs and failures
+//        are reported the same way on every run
+static bool read_dir(const char* dir_name, batch_sources_t* list) {
+    assert(dir_name != nullptr);
+    assert(list != nullptr);
+
+    DIR* dir = opendir(dir_name);
+    if (dir == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), dir_name);
+        return false;
+    }
+
+    // NOTE - only sources are taken, outputs of a previous run may be in the same directory
+    for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        if (entry->d_name[0] == '.' || !is_source(entry->d_name)) {
+            continue;
+        }
+        if (!add_source(list, dir_name, entry->d_name)) {
+            closedir(dir);
+            return false;
+        }
+
+        struct stat info = {};
+        if (stat(list->paths[list->size - 1], &info) != 0 || !S_ISREG(info.st_mode)) {
+            free(list->paths[--list->size]);
+        }
+    }
+    closedir(dir);
+
+    qsort(list->paths, list->size, sizeof(char*), compare_paths);
+    return true;
+}
+
+static bool read_manifest(const char* manifest, batch_sources_t* list) {
+    assert(manifest != nullptr);
+    assert(list != nullptr);
+
+    FILE* file = fopen(manifest, "r");
+    if (file == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), manifest);
+        return false;
+    }
+
+    char line[BATCH_MAX_PATH_LEN] = "";
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (!is_source(line)) {
+            LOG(ERROR, "%s is not a %s source\n", line, BATCH_SOURCE_EXT);
+            fprintf(stderr, "%s is not a %s source\n", line, BATCH_SOURCE_EXT);
+            fclose(file);
+            return false;
+        }
+        if (!add_source(list, nullptr, line)) {
+            fclose(file);
+            return false;
+        }
+    }
+
+    if (fclose(file) == EOF) {
+        LOG(ERROR, "Failed to close %s\n" STRERROR(errno), manifest);
+        return false;
+    }
+    return true;
+}
+
+static bool add_source(batch_sources_t* list, const char* dir_name, const char* name) {
+    assert(list != nullptr);
+    assert(name != nullptr);
+
+    if (list->size == list->capacity) {
+        size_t capacity = list->capacity == 0 ? BATCH_MIN_CAPACITY : list->capacity * 2;
+        char** paths = (char**) realloc(list->paths, capacity * sizeof(char*));
+        if (paths == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        list->paths = paths;
+
+        char** outputs = (char**) realloc(list->outputs, capacity * sizeof(char*));
+        if (outputs == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        list->outputs = outputs;
+        list->capacity = capacity;
+    }
+
+    size_t len = strlen(name) + 1;
+    if (dir_name != nullptr) {
+        len += strlen(dir_name) + 1;
+    }
+
+    char* path = (char*) calloc(len, sizeof(char));
+    if (path == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    if (dir_name != nullptr) {
+        snprintf(path, len, "%s/%s", dir_name, name);
+    }
+    else {
+        snprintf(path, len, "%s", name);
+    }
+    list->outputs[list->size] = nullptr;
+    list->paths[list->size++] = path;
+    return true;
+}
+
+static bool is_source(const char* name) {
+    assert(name != nullptr);
+
+    size_t len = strlen(name);
+    size_t ext_len = strlen(BATCH_SOURCE_EXT);
+    return len > ext_len && strcmp(name + len - ext_len, BATCH_SOURCE_EXT) == 0;
+}
+
+// NOTE - sources with the same name in different directories would write the same
+//        output, such a batch is refused before anything is compiled
+static bool plan_outputs(batch_sources_t* list, const batch_opts_t* opts) {
+    assert(list != nullptr);
+    assert(opts != nullptr);
+
+    char output[BATCH_MAX_PATH_LEN] = "";
+    for (size_t i = 0; i < list->size; i++) {
+        if (!output_path(list->paths[i], opts, output)) {
+            return false;
+        }
+        list->outputs[i] = strdup(output);
+        if (list->outputs[i] == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+    }
+
+    char** sorted = (char**) calloc(list->size + 1, sizeof(char*));
+    if (sorted == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+    memcpy(sorted, list->outputs, list->size * sizeof(char*));
+    qsort(sorted, list->size, sizeof(char*), compare_paths);
+
+    bool is_ok = true;
+    for (size_t i = 1; i < list->size; i++) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            LOG(ERROR, "Several sources are compiled to %s\n", sorted[i]);
+            fprintf(stderr, "Several sources are compiled to %s\n", sorted[i]);
+            is_ok = false;
+        }
+    }
+
+    free(sorted);
+    return is_ok;
+}
+
+static void sources_dtor(batch_sources_t* list) {
+    assert(list != nullptr);
+
+    for (size_t i = 0; i < list->size; i++) {
+        free(list->paths[i]);
+        free(list->outputs[i]);
+    }
+    free(list->paths);
+    free(list->outputs);
+    *list = {};
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+static void* compile_files(void* arg) {
+    assert(arg != nullptr);
+
+    batch_jobs_t* jobs = (batch_jobs_t*) arg;
+
+    while (true) {
+        pthread_mutex_lock(&jobs->lock);
+        size_t i = jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (i >= jobs->sources->size) {
+            break;
+        }
+
+        jobs->is_ok[i] = compile_file(jobs->sources->paths[i], jobs->sources->outputs[i], jobs->opts);
+    }
+    return nullptr;
+}
+
+// NOTE - the same pipeline as a single langc run without dumps or extra outputs
+static bool compile_file(const char* source, const char* output, const batch_opts_t* opts) {
+    assert(source != nullptr);
+    assert(output != nullptr);
+    assert(opts != nullptr);
+
+    FILE* istream = fopen(source, "r");
+    if (istream == nullptr) {
+        LOG(ERROR, "Failed to open an input data file %s\n" STRERROR(errno), source);
+        return false;
+    }
+
+    prog_tree_t tree = {};
+    bool is_ok = tree.init(istream) == NO_ERR && tree.root_ != nullptr;
+    if (fclose(istream) == EOF) {
+        LOG(ERROR, "Failed to close %s\n" STRERROR(errno), source);
+        is_ok = false;
+    }
+    if (!is_ok) {
+        LOG(ERROR, "Failed to build a tree from %s\n", source);
+        tree.tree_dtor();
+        return false;
+    }
+
+    middleend_t middle = {};
+    middle.init(&tree);
+    middle.optimize_tree();
+    middle.release(&tree);
+
+    FILE* ostream = fopen(output, opts->spu_bin ? "wb" : "w");
+    if (ostream == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), output);
+        tree.tree_dtor();
+        return false;
+    }
+
+    backend_t back = {};
+    back.init(&tree);
+    is_ok = (opts->spu_bin ? back.translate_to_bin(ostream) : back.translate_to_asm(ostream)) == NO_ERR;
+    back.dtor();
+
+    if (fclose(ostream) == EOF) {
+        LOG(ERROR, "Failed to close %s\n" STRERROR(errno), output);
+        is_ok = false;
+    }
+    if (!is_ok) {
+        remove(output);
+    }
+    return is_ok;
+}
+
+// NOTE - dir/name.txt becomes out_dir/name.asm, or dir/name.asm without out_dir
+static bool output_path(const char* source, const batch_opts_t* opts, char* path) {
+    assert(source != nullptr);
+    assert(opts != nullptr);
+    assert(path != nullptr);
+
+    const char* name = strrchr(source, '/');
+    name = name == nullptr ? source : name + 1;
+
+    const char* ext = strrchr(name, '.');
+    int stem_len = (int) (ext == nullptr || ext == name ? strlen(name) : (size_t) (ext - name));
+    int dir_len = (int) (name - source);
+    const char* suffix = opts->spu_bin ? "bin" : "asm";
+
+    int len = 0;
+    if (opts->out_dir != nullptr) {
+        len = snprintf(path, BATCH_MAX_PATH_LEN, "%s/%.*s.%s", opts->out_dir, stem_len, name, suffix);
+    }
+    else {
+        len = snprintf(path, BATCH_MAX_PATH_LEN, "%.*s%.*s.%s", dir_len, source, stem_len, name, suffix);
+    }
+
+    if (len < 0 || (size_t) len >= BATCH_MAX_PATH_LEN) {
+        LOG(ERROR, "Output path for %s is too long\n", source);
+        return false;
+    }
+    return true;
+}
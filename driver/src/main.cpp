@@ -0,0 +1,395 @@
+#include <cstdlib>
+#include <errno.h>
+#include <string.h>
+#include "prog_tree.h"
+#include "middleend.h"
+#include "interpreter.h"
+#include "backend.h"
+#include "batch.h"
+#include "ir.h"
+#include "bytecode.h"
+#include "x86_backend.h"
+#include "jit.h"
+#include "logger.h"
+
+typedef struct {
+    const char* input;
+    const char* asm_output;
+    const char* front_output;
+    const char* middle_output;
+    const char* ir_output;
+    const char* dump;
+    dump_render_mode_t dump_render;
+    const char* batch;
+    const char* out_dir;
+    size_t jobs;
+    bool binary;
+    bool spu_bin;
+    bool run;
+    bool vm;
+    bool x86;
+    bool jit;
+} langc_args_t;
+
+static bool parse_args(int argc, char** argv, langc_args_t* args);
+static void print_usage(const char* prog_name);
+static bool close_file(FILE* file, const char* name);
+static bool print_ir(prog_tree_t* tree, const char* ir_output);
+static bool translate(prog_tree_t* tree, const char* asm_output, size_t jobs);
+static bool translate_bin(prog_tree_t* tree, const char* bin_output, size_t jobs);
+static bool interpret(prog_tree_t* tree);
+static bool execute(prog_tree_t* tree);
+static bool translate_x86(prog_tree_t* tree, const char* asm_output);
+static bool run_jit(prog_tree_t* tree);
+
+int main(int argc, char** argv) {
+    langc_args_t args = {};
+    args.input = "./data/input/data.txt";
+    args.jobs  = 1;
+
+    if (!parse_args(argc, argv, &args)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (args.asm_output == nullptr) {
+        args.asm_output = args.spu_bin ? "./in.bin" : "./in.asm";
+    }
+
+    FILE* logger = fopen("./logs/langc_logger.txt", "w");
+    if (logger == nullptr) {
+        fprintf(stderr, "Failed to open a logger ostream\n");
+        return 1;
+    }
+
+    LoggerSetFile(logger);
+    LoggerSetLevel(INFO);
+
+    // NOTE - in batch mode -j is the amount of files compiled at once, each one is
+    //        compiled by a single thread
+    if (args.batch != nullptr) {
+        batch_opts_t opts = {};
+        opts.out_dir = args.out_dir;
+        opts.jobs    = args.jobs;
+        opts.spu_bin = args.spu_bin;
+        bool is_ok = compile_batch(args.batch, &opts);
+
+        if (fclose(logger) == EOF) {
+            fprintf(stderr, "Failed to close logger file\n" STRERROR(errno));
+            return 1;
+        }
+        return is_ok ? 0 : 1;
+    }
+
+    FILE* istream = fopen(args.input, "r");
+    if (istream == nullptr) {
+        LOG(ERROR, "Failed to open an input data file %s\n" STRERROR(errno), args.input);
+        return 1;
+    }
+
+    FILE* dump = nullptr;
+    if (args.dump != nullptr) {
+        dump = fopen(args.dump, "wb");
+        if (dump == nullptr) {
+            LOG(ERROR, "Failed to open a dump ostream %s\n" STRERROR(errno), args.dump);
+            return 1;
+        }
+    }
+
+    // NOTE - dumps of all the stages go through one render, async images are
+    //        waited for before the html is closed
+    dump_render_t render = {};
+    if (!render.init(dump != nullptr ? args.dump_render : DUMP_RENDER_SYNC, DUMP_RENDER_JOBS)) {
+        return 1;
+    }
+
+    prog_tree_t tree = {};
+    tree.set_dump_ostream(dump);
+    tree.set_dump_render(&render);
+
+    if (tree.init(istream) != NO_ERR || tree.root_ == nullptr) {
+        LOG(ERROR, "Failed to build a tree from %s\n", args.input);
+        tree.tree_dtor();
+        return 1;
+    }
+
+    if (args.front_output != nullptr) {
+        FILE* front_file = fopen(args.front_output, "w");
+        if (front_file == nullptr) {
+            LOG(ERROR, "Failed to open %s\n" STRERROR(errno), args.front_output);
+            return 1;
+        }
+        bool is_written = false;
+        if (args.binary) {
+            is_written = tree.deserialization_bin(front_file);
+        }
+        else {
+            is_written = tree.deserialization(front_file);
+        }
+        if (!close_file(front_file, args.front_output) || !is_written) {
+            remove(args.front_output);
+            return 1;
+        }
+    }
+
+    middleend_t middle = {};
+    middle.init(&tree);
+    middle.optimize_tree();
+
+    if (args.middle_output != nullptr) {
+        FILE* middle_file = fopen(args.middle_output, "w");
+        if (middle_file == nullptr) {
+            LOG(ERROR, "Failed to open %s\n" STRERROR(errno), args.middle_output);
+            return 1;
+        }
+        bool is_written = false;
+        if (args.binary) {
+            is_written = middle.deserialization_bin(middle_file);
+        }
+        else {
+            is_written = middle.deserialization(middle_file);
+        }
+        if (!close_file(middle_file, args.middle_output) || !is_written) {
+            remove(args.middle_output);
+            return 1;
+        }
+    }
+
+    if (dump != nullptr) {
+        middle.dump();
+    }
+    middle.release(&tree);
+
+    if (args.ir_output != nullptr && !print_ir(&tree, args.ir_output)) {
+        return 1;
+    }
+
+    bool is_ok = false;
+    if (args.run) {
+        is_ok = interpret(&tree);
+    }
+    else if (args.vm) {
+        is_ok = execute(&tree);
+    }
+    else if (args.x86) {
+        is_ok = translate_x86(&tree, args.asm_output);
+    }
+    else if (args.jit) {
+        is_ok = run_jit(&tree);
+    }
+    else if (args.spu_bin) {
+        is_ok = translate_bin(&tree, args.asm_output, args.jobs);
+    }
+    else {
+        is_ok = translate(&tree, args.asm_output, args.jobs);
+    }
+
+    if (!close_file(istream, args.input)) return 1;
+    render.dtor();
+    if (dump != nullptr && !close_file(dump, args.dump)) return 1;
+
+    if (fclose(logger) == EOF) {
+        fprintf(stderr, "Failed to close logger file\n" STRERROR(errno));
+        return 1;
+    }
+    return is_ok ? 0 : 1;
+}
+
+static bool parse_args(int argc, char** argv, langc_args_t* args) {
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "-o") == 0 && has_value) {
+            args->asm_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--front-out") == 0 && has_value) {
+            args->front_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--middle-out") == 0 && has_value) {
+            args->middle_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--ir-out") == 0 && has_value) {
+            args->ir_output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump") == 0 && has_value) {
+            args->dump = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && has_value) {
+            char* end = nullptr;
+            args->jobs = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || args->jobs == 0) {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--dump-render") == 0 && has_value) {
+            i++;
+            if (strcmp(argv[i], "sync") == 0) {
+                args->dump_render = DUMP_RENDER_SYNC;
+            }
+            else if (strcmp(argv[i], "async") == 0) {
+                args->dump_render = DUMP_RENDER_ASYNC;
+            }
+            else if (strcmp(argv[i], "none") == 0) {
+                args->dump_render = DUMP_RENDER_NONE;
+            }
+            else {
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && has_value) {
+            args->batch = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out-dir") == 0 && has_value) {
+            args->out_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--run") == 0) {
+            args->run = true;
+        }
+        else if (strcmp(argv[i], "--vm") == 0) {
+            args->vm = true;
+        }
+        else if (strcmp(argv[i], "--x86") == 0) {
+            args->x86 = true;
+        }
+        else if (strcmp(argv[i], "--jit") == 0) {
+            args->jit = true;
+        }
+        else if (strcmp(argv[i], "--binary") == 0) {
+            args->binary = true;
+        }
+        else if (strcmp(argv[i], "--spu-bin") == 0) {
+            args->spu_bin = true;
+        }
+        else if (argv[i][0] != '-') {
+            args->input = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s [input] [-o out.asm] [--front-out out.txt] "
+                    "[--middle-out m_out.txt] [--ir-out ir.txt] [-j jobs] [--binary] [--spu-bin] [--run] [--vm] [--x86] [--jit] [--dump dump.html]\n"
+                    "       [--dump-render sync|async|none]\n"
+                    "       %s --batch <manifest|dir> [--out-dir dir] [-j jobs] [--spu-bin]\n", prog_name, prog_name);
+}
+
+static bool close_file(FILE* file, const char* name) {
+    if (fclose(file) == EOF) {
+        LOG(ERROR, "Failed to close %s\n" STRERROR(errno), name);
+        return false;
+    }
+    return true;
+}
+
+static bool print_ir(prog_tree_t* tree, const char* ir_output) {
+    FILE* ir_file = fopen(ir_output, "w");
+    if (ir_file == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), ir_output);
+        return false;
+    }
+
+    ir_t ir = {};
+    bool is_ok = ir.build(tree) == NO_ERR;
+    if (is_ok) {
+        ir.print(ir_file);
+    }
+    ir.dtor();
+
+    return close_file(ir_file, ir_output) && is_ok;
+}
+
+static bool translate(prog_tree_t* tree, const char* asm_output, size_t jobs) {
+    FILE* asm_file = fopen(asm_output, "w");
+    if (asm_file == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), asm_output);
+        tree->tree_dtor();
+        return false;
+    }
+
+    backend_t back = {};
+    back.init(tree);
+    back.set_jobs(jobs);
+    bool is_ok = back.translate_to_asm(asm_file) == NO_ERR;
+    back.dtor();
+
+    // NOTE - an empty file would pass for a program
+    is_ok = close_file(asm_file, asm_output) && is_ok;
+    if (!is_ok) {
+        remove(asm_output);
+    }
+    return is_ok;
+}
+
+static bool translate_bin(prog_tree_t* tree, const char* bin_output, size_t jobs) {
+    FILE* bin_file = fopen(bin_output, "wb");
+    if (bin_file == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), bin_output);
+        tree->tree_dtor();
+        return false;
+    }
+
+    backend_t back = {};
+    back.init(tree);
+    back.set_jobs(jobs);
+    bool is_ok = back.translate_to_bin(bin_file) == NO_ERR;
+    back.dtor();
+
+    is_ok = close_file(bin_file, bin_output) && is_ok;
+    if (!is_ok) {
+        remove(bin_output);
+    }
+    return is_ok;
+}
+
+static bool translate_x86(prog_tree_t* tree, const char* asm_output) {
+    FILE* asm_file = fopen(asm_output, "w");
+    if (asm_file == nullptr) {
+        LOG(ERROR, "Failed to open %s\n" STRERROR(errno), asm_output);
+        tree->tree_dtor();
+        return false;
+    }
+
+    x86_backend_t back = {};
+    back.init(tree);
+    bool is_ok = back.translate_to_x86(asm_file) == NO_ERR;
+    back.dtor();
+
+    is_ok = close_file(asm_file, asm_output) && is_ok;
+    if (!is_ok) {
+        remove(asm_output);
+    }
+    return is_ok;
+}
+
+static bool interpret(prog_tree_t* tree) {
+    interpreter_t interpreter = {};
+    bool is_ok = interpreter.init(tree, stdin, stdout) == NO_ERR && interpreter.run() == NO_ERR;
+    interpreter.dtor();
+
+    tree->tree_dtor();
+    return is_ok;
+}
+
+static bool execute(prog_tree_t* tree) {
+    bytecode_t bytecode = {};
+    vm_t vm = {};
+    bool is_ok = bytecode.compile(tree) == NO_ERR &&
+                 vm.init(&bytecode, stdin, stdout) == NO_ERR && vm.run() == NO_ERR;
+    vm.dtor();
+    bytecode.dtor();
+
+    tree->tree_dtor();
+    return is_ok;
+}
+
+static bool run_jit(prog_tree_t* tree) {
+    jit_t jit = {};
+    bool is_ok = jit.init(tree, stdin, stdout) == NO_ERR && jit.compile() == NO_ERR && jit.run() == NO_ERR;
+    jit.dtor();
+
+    tree->tree_dtor();
+    return is_ok;
+}
@@ -0,0 +1,51 @@
+#ifndef DUMP_RENDER_H
+#define DUMP_RENDER_H
+
+#include <stdlib.h>
+#include <pthread.h>
+
+const size_t DUMP_RENDER_JOBS         = 4;
+const size_t DUMP_RENDER_MIN_CAPACITY = 16;
+const size_t DUMP_RENDER_PATH_LEN     = 40;
+
+typedef enum {
+    DUMP_RENDER_SYNC  = 0,  // dot runs on every dump, the dump waits for it
+    DUMP_RENDER_ASYNC = 1,  // dot runs on worker threads, finish() waits for them
+    DUMP_RENDER_NONE  = 2,  // only .dot files are written
+} dump_render_mode_t;
+
+typedef struct {
+    char dot[DUMP_RENDER_PATH_LEN];
+    char png[DUMP_RENDER_PATH_LEN];
+} dump_image_t;
+
+bool render_dot(const char* dot, const char* png);
+
+// NOTE - decides when the .dot files written by prog_tree_t::dump become images.
+//        The tree only keeps a pointer, so the render outlives the tree moving
+//        between the stages and collects the dumps of all of them
+class dump_render_t {
+public:
+    bool init(dump_render_mode_t mode, size_t jobs);
+    bool add(const char* dot, const char* png);
+    void finish();
+    void dtor();
+private:
+    static void* work(void* arg);
+
+    dump_render_mode_t mode_{DUMP_RENDER_SYNC};
+
+    dump_image_t* images_{nullptr};
+    size_t images_size_{0};
+    size_t images_capacity_{0};
+    size_t next_{0};
+    size_t failed_{0};
+    bool is_finished_{false};
+
+    pthread_mutex_t lock_{};  // guards the queue and the counters above
+    pthread_cond_t ready_{};
+    pthread_t* threads_{nullptr};
+    size_t threads_amount_{0};
+};
+
+#endif /* DUMP_RENDER_H */
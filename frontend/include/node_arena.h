@@ -0,0 +1,31 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <stdlib.h>
+
+struct node_t;
+
+const size_t NODE_ARENA_CHUNK_CAPACITY = 1024;
+
+struct node_chunk_t {
+    node_chunk_t* next;
+    size_t used;
+    node_t* nodes;
+};
+
+class node_arena_t {
+public:
+    node_t* alloc_node();
+    void free_node(node_t* node);
+    void dtor();
+
+    size_t allocated_amount();
+private:
+    node_chunk_t* new_chunk();
+
+    node_chunk_t* chunks_{nullptr};
+    node_t* free_list_{nullptr};
+    size_t allocated_amount_{0};
+};
+
+#endif /* NODE_ARENA_H */
@@ -3,7 +3,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "text_lib.h"
+#include "dump_render.h"
+#include "node_arena.h"
 
 #define MAX_OP_LEN 20
 #define MAX_NAME_LEN 21
@@ -75,6 +78,38 @@ typedef struct {
     bool initialized;
 } name_t;
 
+const uint64_t FNV_OFFSET_BASIS = UINT64_C(14695981039346656037);
+const uint64_t FNV_PRIME        = UINT64_C(1099511628211);
+
+typedef enum {
+    INTERN_EMPTY   = 0,
+    INTERN_NAME    = 1,
+} intern_kind_t;
+
+typedef struct {
+    char name[MAX_NAME_LEN];
+    intern_kind_t kind;
+    size_t hash;
+    size_t id;
+} intern_slot_t;
+
+class intern_table_t {
+public:
+    static size_t hash(const char* name);
+
+    intern_slot_t* find(const char* name, size_t hash);
+    intern_slot_t* insert(const char* name, size_t hash, intern_kind_t kind, size_t id);
+    size_t size();
+    void dtor();
+private:
+    intern_slot_t* probe(const char* name, size_t hash);
+    bool grow();
+
+    intern_slot_t* slots_{nullptr};
+    size_t capacity_{0};
+    size_t size_{0};
+};
+
 struct node_t {
     node_t* parent;
     node_t* left;
@@ -84,6 +119,37 @@ struct node_t {
     double value;
 };
 
+typedef struct {
+    union {
+        double number;
+        uint32_t id;
+    };
+    uint32_t offset;
+    uint8_t type;
+} token_t;
+
+// NOTE - binary stage file: ast_header_t, names_amount names of MAX_NAME_LEN bytes,
+//        then nodes_amount ast_record_t in preorder (native byte order)
+const char     AST_MAGIC[4]  = {'L', 'A', 'S', 'T'};
+const uint32_t AST_VERSION   = 1;
+const uint8_t  AST_HAS_LEFT  = 1;
+const uint8_t  AST_HAS_RIGHT = 2;
+const size_t   AST_NO_SIZE   = SIZE_MAX;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t names_amount;
+    uint32_t nodes_amount;
+} ast_header_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t links;
+    uint8_t reserved[6];
+    double value;
+} ast_record_t;
+
 typedef enum {
     NO_ERR             = 0,
     SYNTAX_ERR         = 1,
@@ -108,7 +174,7 @@ typedef struct {
     op_t code;
 } func_name_table_t;
 
-const func_name_table_t func_name_table[] = {
+constexpr func_name_table_t func_name_table[] = {
     { "+",      ADD},
     { "-",      SUB},
     { "/",      DIV},
@@ -159,26 +225,159 @@ const func_name_table_t func_name_table[] = {
 
 const size_t func_name_table_len = sizeof(func_name_table) / sizeof(func_name_table[0]);
 
+// NOTE - spellings used instead of '<' and '>' where they would break html labels
+constexpr func_name_table_t op_alias_table[] = {
+    { "IA",     IA},
+    { "IAEQ",   IAEQ},
+    { "IB",     IB},
+    { "IBEQ",   IBEQ}};
+
+const size_t op_alias_table_len = sizeof(op_alias_table) / sizeof(op_alias_table[0]);
+
+//=========================================================================================
+// NOTE - keyword tables are built at compile time: a perfect hash from name to op_t
+//        (the seed is searched until no two names share a slot) and a reverse table
+//        from op_t to the table entry
+
+const size_t  KEYWORD_HASH_SIZE = 256;
+const uint8_t KEYWORD_NO_ENTRY  = 0xFF;
+
+typedef struct {
+    uint8_t  slots[KEYWORD_HASH_SIZE];
+    uint32_t seed;
+} keyword_hash_t;
+
+typedef struct {
+    uint8_t index[EOT + 1];
+} op_index_t;
+
+constexpr uint32_t keyword_hash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (size_t i = 0; i < MAX_NAME_LEN && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 15;
+    return hash % KEYWORD_HASH_SIZE;
+}
+
+constexpr bool keyword_equal(const char* lhs, const char* rhs) {
+    size_t i = 0;
+    while (i < MAX_NAME_LEN && lhs[i] != '\0' && lhs[i] == rhs[i]) {
+        i++;
+    }
+    return i == MAX_NAME_LEN || lhs[i] == rhs[i];
+}
+
+template <size_t N>
+constexpr keyword_hash_t make_keyword_hash(const func_name_table_t (&table)[N]) {
+    static_assert(N < KEYWORD_NO_ENTRY, "Keyword table does not fit uint8_t slots");
+
+    keyword_hash_t result = {};
+    for (uint32_t seed = 1; seed != 0; seed++) {
+        for (size_t i = 0; i < KEYWORD_HASH_SIZE; i++) {
+            result.slots[i] = KEYWORD_NO_ENTRY;
+        }
+
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; i++) {
+            uint32_t slot = keyword_hash(table[i].name, seed);
+            collision = (result.slots[slot] != KEYWORD_NO_ENTRY);
+            result.slots[slot] = (uint8_t) i;
+        }
+
+        if (!collision) {
+            result.seed = seed;
+            return result;
+        }
+    }
+    return result;
+}
+
+template <size_t N>
+constexpr op_index_t make_op_index(const func_name_table_t (&table)[N]) {
+    op_index_t result = {};
+    for (size_t i = 0; i <= EOT; i++) {
+        result.index[i] = KEYWORD_NO_ENTRY;
+    }
+    for (size_t i = 0; i < N; i++) {
+        result.index[table[i].code] = (uint8_t) i;
+    }
+    return result;
+}
+
+constexpr keyword_hash_t keyword_hash_table = make_keyword_hash(func_name_table);
+constexpr keyword_hash_t op_alias_hash_table = make_keyword_hash(op_alias_table);
+constexpr op_index_t op_name_index  = make_op_index(func_name_table);
+constexpr op_index_t op_alias_index = make_op_index(op_alias_table);
+
+static_assert(keyword_hash_table.seed != 0, "No perfect hash seed for func_name_table");
+static_assert(op_alias_hash_table.seed != 0, "No perfect hash seed for op_alias_table");
+
+template <size_t N>
+constexpr op_t find_keyword(const func_name_table_t (&table)[N], const keyword_hash_t& hash, const char* name) {
+    uint8_t entry = hash.slots[keyword_hash(name, hash.seed)];
+    if (entry == KEYWORD_NO_ENTRY || !keyword_equal(table[entry].name, name)) {
+        return POISON;
+    }
+    return table[entry].code;
+}
+
+// NOTE - source spelling of a keyword or an operator
+constexpr op_t keyword_to_op(const char* name) {
+    return find_keyword(func_name_table, keyword_hash_table, name);
+}
+
+// NOTE - accepts both the source spelling and the op_alias_table one
+constexpr op_t op_text_to_op(const char* name) {
+    op_t op = keyword_to_op(name);
+    return (op != POISON) ? op : find_keyword(op_alias_table, op_alias_hash_table, name);
+}
+
+constexpr const char* op_to_name(int op) {
+    if (op < 0 || op > EOT || op_name_index.index[op] == KEYWORD_NO_ENTRY) {
+        return nullptr;
+    }
+    return func_name_table[op_name_index.index[op]].name;
+}
+
+// NOTE - spelling for dumps and stage files
+constexpr const char* op_to_text(int op) {
+    if (op >= 0 && op <= EOT && op_alias_index.index[op] != KEYWORD_NO_ENTRY) {
+        return op_alias_table[op_alias_index.index[op]].name;
+    }
+    return op_to_name(op);
+}
+
+static_assert(keyword_to_op("!=") == INE, "");
+static_assert(keyword_to_op("ctg") == CTG, "");
+static_assert(keyword_to_op("ct") == POISON, "");
+static_assert(op_text_to_op("IAEQ") == IAEQ, "");
+static_assert(keyword_equal(op_to_text(IB), "IB"), "");
+
 typedef struct {
     size_t var_nametable_index;
     char name[MAX_NAME_LEN];
     node_t* tree;
-    name_t var_nametable_[10];
-    size_t var_nametable_size_;
 } new_func_name_t;
 
 class prog_tree_t {
 public:
     node_t* root_{nullptr};
-    name_t var_nametable_[100];
+    name_t* var_nametable_{nullptr};
     size_t jmp_cnt_{0};
 
     err_t init(FILE* data_file);
     void tree_dtor();
     void tokens_dtor();
-    void delete_subtree_r(node_t* node);
+    size_t var_nametable_size();
+    void delete_subtree(node_t* node);
+    void free_node(node_t* node);
+    node_t* new_node(type_t type, double val);
+    double add_temp_name(const char* prefix);
 
     void set_dump_ostream(FILE* ostream);
+    void set_dump_render(dump_render_t* render);
     void print_preorder_();
     void print_inorder_();
     void print_preorder(node_t* node);
@@ -193,7 +392,8 @@ public:
 
     void print_tree_to_tex(FILE* ostream, node_t* root);
     void print_exp_to_tex(FILE* ostream, node_t* node);
-    void deserialization(FILE* ostream);
+    bool deserialization(FILE* ostream);
+    bool deserialization_bin(FILE* ostream);
     void serialization(FILE* istream);
 private:
     int get_operator_precedence(int op);
@@ -220,48 +420,67 @@ private:
     node_t* get_new_var();
     node_t* get_ret();
     node_t* get_in_out();
+    node_t* get_op_list();
+    node_t* get_call_arg();
+    bool is_op_token(size_t ip, op_t op);
 
     ssize_t add_func_to_nametable(node_t* func);
 
     node_t* token_init(text_t* text);
+    token_t* new_token();
+    node_t* token_node(size_t ip);
     node_t* link_tokens();
     void tokenize_text(text_t* text);
-    err_t parse_identificator(text_t* text, size_t* ip, node_t* node);
+    err_t parse_identificator(text_t* text, size_t* ip, token_t* token);
     op_t is_operator(char* name);
     bool is_unary(double value);
-    void parse_number(text_t* text, size_t* ip, node_t* node);
-    void initialize_op_node(node_t* node, double val);
+    void parse_number(text_t* text, size_t* ip, token_t* token);
+    void initialize_op_token(token_t* token, op_t op);
     void print_tokens_array();
 
     double find_name_in_nametable(char* name);
     double add_name_to_nametable(char* name);
     double index_in_nametable(char* name);
+    void nametable_dtor();
     void print_var_nametable();
-    bool parse_operator(text_t* text, size_t* ip, node_t* node);
+    bool parse_operator(text_t* text, size_t* ip, token_t* token);
     const char* op_name(int val);
     bool is_compare(int val);
 
     void print_node_data(FILE* ostream, node_t* node);
-    void print_node_r(FILE* ostream, node_t* node, size_t tab_cnt);
+    bool print_node(FILE* ostream, node_t* node, size_t tab_cnt);
 
-    node_t* new_node(type_t type, double val);
+    bool shift_single_children(node_t* node);
     double parse_variable(char* buffer);
     double parse_func(char* buffer);
     double parse_operator(char* buffer);
     double parse_number(char* buffer);
-    node_t* parse_node_r(text_t* text, size_t* ip);
+    node_t* parse_node(text_t* text, size_t* ip);
+    node_t* parse_node_data(text_t* text, size_t* ip);
+    size_t count_nodes(node_t* node);
+    size_t write_records(node_t* node, ast_record_t* records);
+    node_t* parse_bin(text_t* text);
     void skip_spaces(text_t* text, size_t* ip);
 private:
     size_t var_nametable_size_{0};
+    size_t var_nametable_capacity_{0};
+    intern_table_t names_{};
 
-    new_func_name_t func_nametable_[10];
+    new_func_name_t* func_nametable_{nullptr};
     size_t func_nametable_size_{0};
-
-    name_t* current_var_nametable_{var_nametable_};
+    size_t func_nametable_capacity_{0};
 
     size_t ip_{0};
-    node_t* tokens_{nullptr};
+    bool is_syntax_err_{false};  // parsing stops at the first error
+    node_arena_t arena_{};
+
+    FILE* dump_ostream_{nullptr};
+    dump_render_t* dump_render_{nullptr};  // dot runs right away if nullptr
+    bool is_tex_started_{false};
+
+    token_t* tokens_{nullptr};
     size_t tokens_array_size_{0};
+    size_t tokens_capacity_{0};
 };
 
 #endif /* EXPRESSION_TREE_H */
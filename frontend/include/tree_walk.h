@@ -0,0 +1,63 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+
+#include "prog_tree.h"
+
+const size_t WALK_STACK_MIN_CAPACITY = 64;
+
+typedef enum {
+    WALK_ENTER = 0,
+    WALK_LEAVE = 1,
+} walk_event_t;
+
+typedef enum {
+    FRAME_ENTER = 0,
+    FRAME_LEFT  = 1,
+    FRAME_RIGHT = 2,
+    FRAME_LEAVE = 3,
+} frame_state_t;
+
+typedef struct {
+    node_t* node;
+    rel_t rel;
+    frame_state_t state;
+} walk_frame_t;
+
+typedef struct {
+    node_t* node;
+    rel_t rel;
+    walk_event_t event;
+    size_t depth;
+} walk_step_t;
+
+// NOTE - heap stack of frames, so walkers do not depend on the tree depth
+class walk_stack_t {
+public:
+    walk_frame_t* push(node_t* node, rel_t rel);
+    walk_frame_t* top();
+    void pop();
+    size_t size();
+    void dtor();
+private:
+    walk_frame_t* frames_{nullptr};
+    size_t size_{0};
+    size_t capacity_{0};
+};
+
+// NOTE - yields every node twice: WALK_ENTER before its children and WALK_LEAVE after them.
+//        A node is popped before its WALK_LEAVE is returned, so it may be freed or replaced
+//        then; children are read only when the walk descends into them. next() returns
+//        false both at the end and when the stack cannot grow, is_alloc_err() tells them apart
+class tree_walk_t {
+public:
+    void init(node_t* root);
+    bool next(walk_step_t* step);
+    void skip_children();
+    bool is_alloc_err();
+    void dtor();
+private:
+    walk_stack_t stack_{};
+    bool is_alloc_err_{false};
+};
+
+#endif /* TREE_WALK_H */
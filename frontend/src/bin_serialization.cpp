@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <string.h>
+#include "prog_tree.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+typedef struct {
+    node_t* node;
+    uint8_t links;
+} ast_parent_t;
+
+size_t prog_tree_t::count_nodes(node_t* node) {
+    tree_walk_t walk = {};
+    walk.init(node);
+
+    size_t amount = 0;
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event == WALK_ENTER) {
+            amount++;
+        }
+    }
+    if (walk.is_alloc_err()) {
+        amount = AST_NO_SIZE;
+    }
+    walk.dtor();
+    return amount;
+}
+
+size_t prog_tree_t::write_records(node_t* node, ast_record_t* records) {
+    tree_walk_t walk = {};
+    walk.init(node);
+
+    size_t size = 0;
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event != WALK_ENTER) {
+            continue;
+        }
+
+        ast_record_t* record = &records[size++];
+        record->type  = (uint8_t) step.node->type;
+        record->links = (uint8_t) ((step.node->left  != nullptr ? AST_HAS_LEFT  : 0) |
+                                   (step.node->right != nullptr ? AST_HAS_RIGHT : 0));
+        record->value = step.node->value;
+    }
+    if (walk.is_alloc_err()) {
+        size = AST_NO_SIZE;
+    }
+    walk.dtor();
+    return size;
+}
+
+bool prog_tree_t::deserialization_bin(FILE* ostream) {
+    assert(ostream != nullptr);
+
+    size_t nodes_amount = count_nodes(root_);
+    if (nodes_amount == AST_NO_SIZE) {
+        return false;
+    }
+
+    ast_header_t header = {};
+    memcpy(header.magic, AST_MAGIC, sizeof(AST_MAGIC));
+    header.version      = AST_VERSION;
+    header.names_amount = (uint32_t) var_nametable_size_;
+    header.nodes_amount = (uint32_t) nodes_amount;
+
+    ast_record_t* records = (ast_record_t*) calloc(header.nodes_amount + 1, sizeof(ast_record_t));
+    if (records == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    size_t size = write_records(root_, records);
+    if (size == AST_NO_SIZE) {
+        free(records);
+        return false;
+    }
+
+    bool is_ok = fwrite(&header, sizeof(header), 1, ostream) == 1;
+    for (size_t i = 0; i < var_nametable_size_ && is_ok; i++) {
+        char name[MAX_NAME_LEN] = "";
+        strncpy(name, var_nametable_[i].name, MAX_NAME_LEN - 1);
+        is_ok = fwrite(name, sizeof(name), 1, ostream) == 1;
+    }
+    is_ok = is_ok && fwrite(records, sizeof(ast_record_t), size, ostream) == size;
+    if (!is_ok) {
+        LOG(ERROR, "Binary tree write error\n");
+    }
+
+    free(records);
+    return is_ok;
+}
+
+node_t* prog_tree_t::parse_bin(text_t* text) {
+    assert(text != nullptr);
+
+    size_t file_size = text->symbols_amount - 1;
+    const unsigned char* data = text->symbols;
+
+    ast_header_t header = {};
+    if (file_size < sizeof(header)) {
+        LOG(ERROR, "Binary tree file is too short\n");
+        return nullptr;
+    }
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+
+    if (memcmp(header.magic, AST_MAGIC, sizeof(AST_MAGIC)) != 0) {
+        LOG(ERROR, "Binary tree file has no magic\n");
+        return nullptr;
+    }
+    if (header.version != AST_VERSION) {
+        LOG(ERROR, "Unsupported binary tree version %u\n", header.version);
+        return nullptr;
+    }
+    if (file_size != sizeof(header) + (size_t) header.names_amount * MAX_NAME_LEN
+                                    + (size_t) header.nodes_amount * sizeof(ast_record_t)) {
+        LOG(ERROR, "Binary tree file size %zu does not match its header\n", file_size);
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < header.names_amount; i++) {
+        char name[MAX_NAME_LEN] = "";
+        memcpy(name, data, MAX_NAME_LEN - 1);
+        data += MAX_NAME_LEN;
+
+        // NOTE - indices in records refer to the writer's nametable, so they must not move
+        double index = (find_name_in_nametable(name) >= 0) ? -1 : add_name_to_nametable(name);
+        if (index < 0 || (size_t) index != i) {
+            LOG(ERROR, "Name %s cannot keep its index %zu\n", name, i);
+            return nullptr;
+        }
+    }
+
+    ast_parent_t* parents = (ast_parent_t*) calloc(header.nodes_amount + 1, sizeof(ast_parent_t));
+    if (parents == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return nullptr;
+    }
+
+    node_t* root = nullptr;
+    size_t depth = 0;
+
+    for (size_t i = 0; i < header.nodes_amount; i++) {
+        ast_record_t record = {};
+        memcpy(&record, data, sizeof(record));
+        data += sizeof(record);
+
+        bool has_name = (record.type == VAR || record.type == FUNC);
+        if (record.type > FUNC || record.links > (AST_HAS_LEFT | AST_HAS_RIGHT) ||
+            (has_name && !(record.value >= 0 && record.value < header.names_amount)) ||
+            (i != 0 && depth == 0)) {
+            LOG(ERROR, "Broken binary tree record %zu\n", i);
+            root = nullptr;
+            break;
+        }
+
+        node_t* node = new_node((type_t) record.type, record.value);
+        if (node == nullptr) {
+            root = nullptr;
+            break;
+        }
+
+        if (depth == 0) {
+            root = node;
+        }
+        else {
+            ast_parent_t* parent = &parents[depth - 1];
+            if ((parent->links & AST_HAS_LEFT) && parent->node->left == nullptr) {
+                parent->node->left = node;
+            }
+            else {
+                parent->node->right = node;
+            }
+            node->parent = parent->node;
+
+            if (!(parent->links & AST_HAS_RIGHT) || parent->node->right != nullptr) {
+                depth--;
+            }
+        }
+
+        if (record.links != 0) {
+            parents[depth].node  = node;
+            parents[depth].links = record.links;
+            depth++;
+        }
+    }
+
+    if (root != nullptr && depth != 0) {
+        LOG(ERROR, "Binary tree ended with %zu unfinished nodes\n", depth);
+        root = nullptr;
+    }
+
+    free(parents);
+    return root;
+}
@@ -2,20 +2,23 @@
 #include <string.h>
 #include <assert.h>
 #include "prog_tree.h"
+#include "dump_render.h"
 #include "logger.h"
 
-const size_t MAX_FILENAME_LEN = 40;
-const size_t COMMAND_SIZE = 100;
+const size_t MAX_FILENAME_LEN = DUMP_RENDER_PATH_LEN;
 
 const char* FILENAME = "prog_tree";
 
-static FILE** get_dump_ostream() {
-    static FILE* file = nullptr;
-    return &file;
-}
+// NOTE - the only state shared by trees: image names have to be unique in
+//        data/images whatever tree, or thread, dumps
+static size_t images_amount = 0;
 
 void prog_tree_t::set_dump_ostream(FILE* ostream) {
-    *get_dump_ostream() = ostream;
+    dump_ostream_ = ostream;
+}
+
+void prog_tree_t::set_dump_render(dump_render_t* render) {
+    dump_render_ = render;
 }
 
 //=========================================================================================
@@ -31,6 +34,9 @@ void prog_tree_t::print_inorder_() {
 //=========================================================================================
 
 void prog_tree_t::dump_tree() {
+    if (dump_ostream_ == nullptr) {
+        return;
+    }
     dump(root_);
 }
 
@@ -291,8 +297,7 @@ void prog_tree_t::print_tree_to_tex(FILE* ostream, node_t* root) {
 }
 
 void prog_tree_t::print_to_tex(FILE* ostream, node_t* node) {
-    static bool first_dump = true;
-    if (first_dump == true) {
+    if (!is_tex_started_) {
         fprintf(ostream, "\\documentclass{article}\n"
                          "\\author{Alina Palonskaya}\n"
                          "\\date{November 2024}\n"
@@ -302,7 +307,7 @@ void prog_tree_t::print_to_tex(FILE* ostream, node_t* node) {
 
     print_exp_to_tex(ostream, node);
 
-    first_dump = false;
+    is_tex_started_ = true;
 }
 
 void prog_tree_t::print_exp_to_tex(FILE* ostream, node_t* node) {
@@ -319,14 +324,14 @@ void prog_tree_t::print_exp_to_tex(FILE* ostream, node_t* node) {
 void prog_tree_t::dump(node_t* root) {
     assert(root != nullptr);
 
-    FILE* ostream = *get_dump_ostream();
+    FILE* ostream = dump_ostream_;
     if (ostream == nullptr) {
         LOG(ERROR, "Dump ostream is nullptr, print to stdout\n");
         ostream = stdout;
     }
 
     fprintf(ostream, "<pre>");
-    static size_t image_cnt = 0;
+    size_t image_cnt = __atomic_fetch_add(&images_amount, 1, __ATOMIC_RELAXED);
 
     char tree_filename[MAX_FILENAME_LEN] = {};
     char image_filename[MAX_FILENAME_LEN] = {};
@@ -347,17 +352,17 @@ void prog_tree_t::dump(node_t* root) {
         return;
     }
 
-    char command[COMMAND_SIZE] = "";
-
-    snprintf(command, sizeof(command), "dot -Tpng %s -o %s", tree_filename, image_filename);
-
-    if (system(command) != 0) {
-        LOG(ERROR, "Failed to create an image\n");
+    if (dump_render_ == nullptr) {
+        if (!render_dot(tree_filename, image_filename)) {
+            return;
+        }
+    }
+    else if (!dump_render_->add(tree_filename, image_filename)) {
+        fprintf(ostream, "\n<a href = \"../%s\">%s</a>\n", tree_filename, tree_filename);
         return;
     }
 
     fprintf(ostream, "\n<img src = \"../%s\" width = 50%%>\n", image_filename);
-    image_cnt++;
 }
 
 void prog_tree_t::printf_tree_dot_file(FILE* tree_file, node_t* node) {
@@ -463,110 +468,24 @@ void prog_tree_t::print_links(FILE* tree_file, node_t* node) {
 void prog_tree_t::print_operator(FILE* ostream, double value) {
     assert(ostream != nullptr);
 
-    for (size_t i = 0; i < func_name_table_len; i++) {
-        if ((int) value == IA) {
-            fprintf(ostream, " IA ");
-            return;
-        }
-        else if ((int) value == IAEQ) {
-            fprintf(ostream, " IAEQ ");
-            return;
-        }
-        else if ((int) value == IB) {
-            fprintf(ostream, " IB ");
-            return;
-        }
-        else if ((int) value == IBEQ) {
-            fprintf(ostream, " IBEQ ");
-            return;
-        }
-        else if (func_name_table[i].code == (int) value) {
-            fprintf(ostream, " %s ", func_name_table[i].name);
-            return;
-        }
+    const char* name = op_to_text((int) value);
+    if (name == nullptr) {
+        LOG(ERROR, "Unknown sign %f was detected\n", value);
+        return;
     }
-    LOG(ERROR, "Unknown sign %f was detected\n", value);
+    fprintf(ostream, " %s ", name);
 }
 
 //======================================================================================
 
 int prog_tree_t::def_operator(char* op) {
-    if (strnstr(op, "+", MAX_OP_LEN) != nullptr) {
-        return ADD;
-    }
-    else if (strnstr(op, "-", MAX_OP_LEN) != nullptr) {
-        return SUB;
-    }
-    else if (strnstr(op, "/", MAX_OP_LEN) != nullptr) {
-        return DIV;
-    }
-    else if (strnstr(op, "*", MAX_OP_LEN) != nullptr) {
-        return MUL;
-    }
-    else if (strnstr(op, "^", MAX_OP_LEN) != nullptr) {
-        return POW;
-    }
-    else if (strnstr(op, "log", MAX_OP_LEN) != nullptr) {
-        return LOG;
-    }
-    else if (strnstr(op, "ln", MAX_OP_LEN) != nullptr) {
-        return LN;
-    }
-    else if (strnstr(op, "exp", MAX_OP_LEN) != nullptr) {
-        return EXP;
-    }
-    else if (strnstr(op, "arcsin", MAX_OP_LEN) != nullptr) {
-        return ARCSIN;
-    }
-    else if (strnstr(op, "arccos", MAX_OP_LEN) != nullptr) {
-        return ARCCOS;
-    }
-    else if (strnstr(op, "arctg", MAX_OP_LEN) != nullptr) {
-        return ARCTG;
-    }
-    else if (strnstr(op, "arcctg", MAX_OP_LEN) != nullptr) {
-        return ARCCTG;
-    }
-    else if (strnstr(op, "arcsh", MAX_OP_LEN) != nullptr) {
-        return ARCSH;
-    }
-    else if (strnstr(op, "arcch", MAX_OP_LEN) != nullptr) {
-        return ARCCH;
-    }
-    else if (strnstr(op, "arcth", MAX_OP_LEN) != nullptr) {
-        return ARCTH;
-    }
-    else if (strnstr(op, "arccth", MAX_OP_LEN) != nullptr) {
-        return ARCCTH;
-    }
-    else if (strnstr(op, "sin", MAX_OP_LEN) != nullptr) {
-        return SIN;
-    }
-    else if (strnstr(op, "cos", MAX_OP_LEN) != nullptr) {
-        return COS;
-    }
-    else if (strnstr(op, "ctg", MAX_OP_LEN) != nullptr) {
-        return CTG;
-    }
-    else if (strnstr(op, "tg", MAX_OP_LEN) != nullptr) {
-        return TG;
-    }
-    else if (strnstr(op, "sh", MAX_OP_LEN) != nullptr) {
-        return SH;
-    }
-    else if (strnstr(op, "ch", MAX_OP_LEN) != nullptr) {
-        return CH;
-    }
-    else if (strnstr(op, "cth", MAX_OP_LEN) != nullptr) {
-        return CTH;
-    }
-    else if (strnstr(op, "th", MAX_OP_LEN) != nullptr) {
-        return TH;
-    }
-    else {
+    assert(op != nullptr);
+
+    op_t code = op_text_to_op(op);
+    if (code == POISON) {
         LOG(ERROR, "Unknown operation %s was detected\n", op);
-        return -1;
     }
+    return code;
 }
 
 
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "dump_render.h"
+#include "logger.h"
+
+const size_t DUMP_RENDER_COMMAND_SIZE = 100;
+
+bool render_dot(const char* dot, const char* png) {
+    assert(dot != nullptr);
+    assert(png != nullptr);
+
+    char command[DUMP_RENDER_COMMAND_SIZE] = "";
+    snprintf(command, sizeof(command), "dot -Tpng %s -o %s", dot, png);
+
+    if (system(command) != 0) {
+        LOG(ERROR, "Failed to create an image %s\n", png);
+        return false;
+    }
+    return true;
+}
+
+bool dump_render_t::init(dump_render_mode_t mode, size_t jobs) {
+    mode_ = mode;
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_cond_init(&ready_, nullptr);
+
+    if (mode_ != DUMP_RENDER_ASYNC) {
+        return true;
+    }
+
+    threads_ = (pthread_t*) calloc(jobs + 1, sizeof(pthread_t));
+    if (threads_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        dtor();
+        return false;
+    }
+
+    // NOTE - without workers images are rendered by finish()
+    for (; threads_amount_ < jobs; threads_amount_++) {
+        if (pthread_create(&threads_[threads_amount_], nullptr, work, this) != 0) {
+            LOG(WARNING, "Failed to start a render thread, %zu are running\n", threads_amount_);
+            break;
+        }
+    }
+    return true;
+}
+
+// NOTE - returns whether the image is or will be there, a dump without
+//        its image links the .dot file instead
+bool dump_render_t::add(const char* dot, const char* png) {
+    assert(dot != nullptr);
+    assert(png != nullptr);
+
+    switch ((int) mode_) {
+        case DUMP_RENDER_SYNC:
+            return render_dot(dot, png);
+        case DUMP_RENDER_NONE:
+            return false;
+        default:
+            break;
+    }
+
+    pthread_mutex_lock(&lock_);
+    if (images_size_ == images_capacity_) {
+        size_t capacity = images_capacity_ == 0 ? DUMP_RENDER_MIN_CAPACITY : images_capacity_ * 2;
+        dump_image_t* images = (dump_image_t*) realloc(images_, capacity * sizeof(dump_image_t));
+        if (images == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            pthread_mutex_unlock(&lock_);
+            return false;
+        }
+        images_ = images;
+        images_capacity_ = capacity;
+    }
+
+    dump_image_t* image = &images_[images_size_++];
+    snprintf(image->dot, sizeof(image->dot), "%s", dot);
+    snprintf(image->png, sizeof(image->png), "%s", png);
+
+    pthread_cond_signal(&ready_);
+    pthread_mutex_unlock(&lock_);
+    return true;
+}
+
+// NOTE - waits for every queued image, the calling thread renders too
+void dump_render_t::finish() {
+    if (mode_ != DUMP_RENDER_ASYNC) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock_);
+    is_finished_ = true;
+    pthread_cond_broadcast(&ready_);
+    pthread_mutex_unlock(&lock_);
+
+    work(this);
+    for (size_t i = 0; i < threads_amount_; i++) {
+        pthread_join(threads_[i], nullptr);
+    }
+    threads_amount_ = 0;
+
+    if (failed_ != 0) {
+        LOG(ERROR, "Failed to create %zu of %zu images\n", failed_, images_size_);
+    }
+}
+
+void dump_render_t::dtor() {
+    finish();
+
+    free(threads_);
+    threads_ = nullptr;
+    free(images_);
+    images_ = nullptr;
+    images_size_ = 0;
+    images_capacity_ = 0;
+    next_ = 0;
+    failed_ = 0;
+
+    pthread_cond_destroy(&ready_);
+    pthread_mutex_destroy(&lock_);
+    mode_ = DUMP_RENDER_SYNC;
+}
+
+void* dump_render_t::work(void* arg) {
+    assert(arg != nullptr);
+
+    dump_render_t* render = (dump_render_t*) arg;
+
+    pthread_mutex_lock(&render->lock_);
+    while (true) {
+        if (render->next_ == render->images_size_) {
+            if (render->is_finished_) {
+                break;
+            }
+            pthread_cond_wait(&render->ready_, &render->lock_);
+            continue;
+        }
+
+        dump_image_t image = render->images_[render->next_++];
+        pthread_mutex_unlock(&render->lock_);
+
+        bool is_ok = render_dot(image.dot, image.png);
+
+        pthread_mutex_lock(&render->lock_);
+        if (!is_ok) {
+            render->failed_++;
+        }
+    }
+    pthread_mutex_unlock(&render->lock_);
+    return nullptr;
+}
@@ -0,0 +1,97 @@
+#include <assert.h>
+#include <string.h>
+#include "prog_tree.h"
+#include "logger.h"
+
+const size_t INTERN_MIN_CAPACITY = 64;
+
+// NOTE - FNV-1a
+size_t intern_table_t::hash(const char* name) {
+    assert(name != nullptr);
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < MAX_NAME_LEN && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= FNV_PRIME;
+    }
+    return (size_t) hash;
+}
+
+intern_slot_t* intern_table_t::find(const char* name, size_t hash) {
+    assert(name != nullptr);
+
+    if (capacity_ == 0) {
+        return nullptr;
+    }
+
+    intern_slot_t* slot = probe(name, hash);
+    return (slot->kind == INTERN_EMPTY) ? nullptr : slot;
+}
+
+intern_slot_t* intern_table_t::insert(const char* name, size_t hash, intern_kind_t kind, size_t id) {
+    assert(name != nullptr);
+
+    if ((size_ + 1) * 2 > capacity_ && !grow()) {
+        return nullptr;
+    }
+
+    intern_slot_t* slot = probe(name, hash);
+    if (slot->kind == INTERN_EMPTY) {
+        size_++;
+    }
+
+    strncpy(slot->name, name, MAX_NAME_LEN - 1);
+    slot->kind = kind;
+    slot->hash = hash;
+    slot->id = id;
+    return slot;
+}
+
+size_t intern_table_t::size() {
+    return size_;
+}
+
+void intern_table_t::dtor() {
+    free(slots_);
+    slots_ = nullptr;
+    capacity_ = 0;
+    size_ = 0;
+}
+
+// NOTE - linear probing, capacity is a power of two and the table is at most half full
+intern_slot_t* intern_table_t::probe(const char* name, size_t hash) {
+    size_t mask = capacity_ - 1;
+    size_t i = hash & mask;
+
+    while (slots_[i].kind != INTERN_EMPTY) {
+        if (slots_[i].hash == hash && strncmp(slots_[i].name, name, MAX_NAME_LEN) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &slots_[i];
+}
+
+bool intern_table_t::grow() {
+    size_t old_capacity = capacity_;
+    intern_slot_t* old_slots = slots_;
+
+    size_t capacity = (capacity_ == 0) ? INTERN_MIN_CAPACITY : capacity_ * 2;
+    intern_slot_t* slots = (intern_slot_t*) calloc(capacity, sizeof(intern_slot_t));
+    if (slots == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return false;
+    }
+
+    slots_ = slots;
+    capacity_ = capacity;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].kind != INTERN_EMPTY) {
+            *probe(old_slots[i].name, old_slots[i].hash) = old_slots[i];
+        }
+    }
+
+    free(old_slots);
+    return true;
+}
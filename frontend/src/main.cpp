@@ -33,7 +33,7 @@ int main() {
         return 1;
     }
 
-    FILE* dump_file = fopen("./out.txt", "w");
+    FILE* dump_file = fopen("./out.ast", "wb");
     if (istream == nullptr) {
         LOG(ERROR, "Failed to open an input data file\n");
         return 1;
@@ -42,12 +42,16 @@ int main() {
     prog_tree_t tree = {};
 
     tree.set_dump_ostream(file);
-    tree.init(istream);
+    if (tree.init(istream) != NO_ERR) {
+        LOG(ERROR, "Failed to build a tree\n");
+        tree.tree_dtor();
+        return 1;
+    }
     //tree.serialization(dump_file);
     tree.dump(tree.root_);
-    tree.deserialization(dump_file);
+    tree.deserialization_bin(dump_file);
 
-    //tree.tree_dtor();
+    tree.tree_dtor();
     tree.tokens_dtor();
 
     if (fclose(file) == EOF) {
@@ -0,0 +1,66 @@
+#include <assert.h>
+#include "node_arena.h"
+#include "prog_tree.h"
+#include "logger.h"
+
+node_t* node_arena_t::alloc_node() {
+    node_t* node = free_list_;
+    if (node != nullptr) {
+        free_list_ = node->left;
+        allocated_amount_++;
+        return node;
+    }
+
+    if (chunks_ == nullptr || chunks_->used == NODE_ARENA_CHUNK_CAPACITY) {
+        if (new_chunk() == nullptr) {
+            return nullptr;
+        }
+    }
+
+    allocated_amount_++;
+    return &chunks_->nodes[chunks_->used++];
+}
+
+// NOTE - free nodes are linked through the left pointer
+void node_arena_t::free_node(node_t* node) {
+    if (node == nullptr) {
+        return;
+    }
+
+    node->parent = nullptr;
+    node->right = nullptr;
+    node->left = free_list_;
+    free_list_ = node;
+    allocated_amount_--;
+}
+
+void node_arena_t::dtor() {
+    node_chunk_t* chunk = chunks_;
+    while (chunk != nullptr) {
+        node_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    chunks_ = nullptr;
+    free_list_ = nullptr;
+    allocated_amount_ = 0;
+}
+
+size_t node_arena_t::allocated_amount() {
+    return allocated_amount_;
+}
+
+node_chunk_t* node_arena_t::new_chunk() {
+    node_chunk_t* chunk = (node_chunk_t*) calloc(sizeof(node_chunk_t) + sizeof(node_t) * NODE_ARENA_CHUNK_CAPACITY, 1);
+    if (chunk == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return nullptr;
+    }
+
+    chunk->nodes = (node_t*) (chunk + 1);
+    chunk->used = 0;
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    return chunk;
+}
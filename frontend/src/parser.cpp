@@ -7,30 +7,36 @@
 
 #define _syntax_error() syntax_error(ip_, __func__, __LINE__)
 
+// NOTE - the error does not end the process, other trees may be parsed by it. No
+//        token matches after the error, so the parser unwinds and init fails
 void prog_tree_t::syntax_error(size_t p, const char* func, size_t line) {
-    LOG(ERROR, "Syntax error p = %zu, type = %d(val = %f) func: %s (%zu)\n""%s\n",
-               p, tokens_[p].type, tokens_[p].value, func, line, op_name((int)tokens_[p].value));
-    exit(0);
+    if (is_syntax_err_) {
+        return;
+    }
+    is_syntax_err_ = true;
+
+    LOG(ERROR, "Syntax error p = %zu, type = %d(id = %u) func: %s (%zu)\n""%s\n",
+               p, tokens_[p].type, tokens_[p].id, func, line, op_name((int) tokens_[p].id));
 }
 
 const char* prog_tree_t::op_name(int val) {
-    for (size_t i = 0; i < func_name_table_len; i++) {
-        if (func_name_table[i].code == val) {
-            return func_name_table[i].name;
-        }
-    }
-    return nullptr;
+    return op_to_name(val);
+}
+
+bool prog_tree_t::is_op_token(size_t ip, op_t op) {
+    return !is_syntax_err_ && tokens_[ip].type == OP && (int) tokens_[ip].id == op;
 }
 
 node_t* prog_tree_t::get_new_var() {
     size_t old_ip = ip_;
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != DEF_VAR) {
+    if (!is_op_token(ip_, DEF_VAR)) {
         return nullptr;
     }
-    node_t* var = &tokens_[ip_];
     ip_++;
 
-    var_nametable_[(int) tokens_[ip_].value].initialized = true; // NOTE -  check if there is a var
+    if (tokens_[ip_].type == VAR) {
+        var_nametable_[tokens_[ip_].id].initialized = true;
+    }
 
     node_t* asgn = get_asgn();
     if (asgn == nullptr) {
@@ -38,6 +44,7 @@ node_t* prog_tree_t::get_new_var() {
         return nullptr;
     }
 
+    node_t* var = token_node(old_ip);
     var->right = asgn;
     asgn->parent = var;
     return var;
@@ -51,11 +58,11 @@ node_t* prog_tree_t::get_gram() {
     node_t* semicolon_parent = nullptr;
 
     while (new_func != nullptr) {
-        if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
+        if (!is_op_token(ip_, SEMICOLON)) {
             _syntax_error();
             return root;
         }
-        semicolon = &tokens_[ip_];
+        semicolon = token_node(ip_);
         ip_++;
 
         semicolon->left = new_func;
@@ -73,7 +80,7 @@ node_t* prog_tree_t::get_gram() {
         new_func = get_new_func_();
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != EOT) {
+    if (!is_op_token(ip_, EOT)) {
         _syntax_error();
         return root;
     }
@@ -81,10 +88,18 @@ node_t* prog_tree_t::get_gram() {
     return root;
 }
 
+const size_t FUNC_NAMETABLE_MIN_CAPACITY = 16;
+
 ssize_t prog_tree_t::add_func_to_nametable(node_t* func) {
-    if (func_nametable_size_ == 10) {  // NOTE - define 10;
-        LOG(ERROR, "Array of new funcs is full, cannot add more\n");
-        return -1;
+    if (func_nametable_size_ == func_nametable_capacity_) {
+        size_t capacity = (func_nametable_capacity_ == 0) ? FUNC_NAMETABLE_MIN_CAPACITY : func_nametable_capacity_ * 2;
+        new_func_name_t* nametable = (new_func_name_t*) realloc(func_nametable_, sizeof(new_func_name_t) * capacity);
+        if (nametable == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return -1;
+        }
+        func_nametable_ = nametable;
+        func_nametable_capacity_ = capacity;
     }
 
     strcpy(func_nametable_[func_nametable_size_].name, var_nametable_[(int) func->value].name);
@@ -96,20 +111,19 @@ ssize_t prog_tree_t::add_func_to_nametable(node_t* func) {
 node_t* prog_tree_t::get_new_func_() {
     size_t old_ip = ip_;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != DECL) {
+    if (!is_op_token(ip_, DECL)) {
         return nullptr;
     }
-    node_t* decl = &tokens_[ip_];
+    node_t* decl = token_node(ip_);
     ip_++;
 
     node_t* func = get_id();
-    func->type = FUNC;
-
     if (func == nullptr) {
         ip_ = old_ip;
         _syntax_error();
         return nullptr;
     }
+    func->type = FUNC;
 
     ssize_t new_func_id = add_func_to_nametable(func);
     if (new_func_id == -1) {
@@ -119,228 +133,224 @@ node_t* prog_tree_t::get_new_func_() {
 
     size_t func_id = (size_t) new_func_id;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_OPEN) {
+    if (!is_op_token(ip_, BRACKET_OPEN)) {
         ip_ = old_ip;
         return nullptr;
     }
-    node_t* first_bracket = &tokens_[ip_];
+    node_t* first_bracket = new_node(OP, SPEC);
     ip_++;
 
-    first_bracket->type = OP;
-    first_bracket->value = SPEC;
-
     decl->left = first_bracket;
     first_bracket->parent = decl;
     first_bracket->left = func;
     func->parent = first_bracket;
 
-    //TODO -  first_bracket->right = ... variable
     if (tokens_[ip_].type == VAR) {
-        var_nametable_[(int) tokens_[ip_].value].initialized = true; //FIXME - vision space
-        if (tokens_[ip_ + 1].type == OP && (int) tokens_[ip_ + 1].value == BRACKET_CLOSE) {
-            ip_++;
-            first_bracket->right = &tokens_[ip_];
-            tokens_[ip_].parent = first_bracket;
-            tokens_[ip_].value = SEMICOLON;
+        var_nametable_[tokens_[ip_].id].initialized = true; //FIXME - vision space
+        if (is_op_token(ip_ + 1, BRACKET_CLOSE)) {
+            node_t* semicolon = new_node(OP, SEMICOLON);
+            first_bracket->right = semicolon;
+            semicolon->parent = first_bracket;
 
-            tokens_[ip_].left = &tokens_[ip_ - 1];
-            tokens_[ip_ - 1].parent = &tokens_[ip_];
-            ip_++;
+            semicolon->left = token_node(ip_);
+            semicolon->left->parent = semicolon;
+            ip_ += 2;
         }
         else {
-            node_t* var_node = &tokens_[ip_++];
-            node_t* semicolon = &tokens_[ip_];
-            node_t* new_semicolon = semicolon;
+            node_t* var_node = token_node(ip_++);
+            node_t* new_semicolon = nullptr;
             node_t* past_semicolon = nullptr;
 
-            first_bracket->right = semicolon;
-            semicolon->parent = first_bracket;
-
-            while (tokens_[ip_].type == OP && (int) tokens_[ip_].value == SEMICOLON) {
-                new_semicolon = &tokens_[ip_];
+            while (is_op_token(ip_, SEMICOLON)) {
+                new_semicolon = token_node(ip_);
 
                 if (past_semicolon != nullptr) {
                     past_semicolon->right = new_semicolon;
                     new_semicolon->parent = past_semicolon;
                 }
+                else {
+                    first_bracket->right = new_semicolon;
+                    new_semicolon->parent = first_bracket;
+                }
 
                 new_semicolon->left = var_node;
                 var_node->parent = new_semicolon;
                 var_nametable_[(int) var_node->value].initialized = true;
                 ip_++;
 
-                var_node = &tokens_[ip_];
+                var_node = token_node(ip_);
                 ip_++;
                 past_semicolon = new_semicolon;
             }
 
+            if (new_semicolon == nullptr) {
+                _syntax_error();
+                return nullptr;
+            }
+
             new_semicolon->right = var_node; // FIXME - check if var
+            var_node->parent = new_semicolon;
             var_nametable_[(int) var_node->value].initialized = true;
 
-            if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_CLOSE) {
+            if (!is_op_token(ip_, BRACKET_CLOSE)) {
                 ip_ = old_ip;
-            return nullptr;
+                return nullptr;
             }
             ip_++;
         }
     }
     else {
-        if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_CLOSE) {
+        if (!is_op_token(ip_, BRACKET_CLOSE)) {
             ip_ = old_ip;
             return nullptr;
         }
         ip_++;
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CODE_BLOCK_OPEN) {
+    if (!is_op_token(ip_, CODE_BLOCK_OPEN)) {
         ip_ = old_ip;
         return nullptr;
     }
     ip_++;
 
-    node_t* root = nullptr;
-    node_t* parent_node = nullptr;
+    node_t* root = get_op_list();
+    if (root == nullptr) {
+        return nullptr;
+    }
+
+    func_nametable_[func_id].tree = root;
 
+    decl->right = root;
+    root->parent = decl;
+    return decl;
+}
+
+// NOTE - parses {OP ';'}+ '}' after the opening bracket, returns the root of the semicolon chain
+node_t* prog_tree_t::get_op_list() {
     node_t* val = get_op();
     if (val == nullptr) {
         _syntax_error();
         return nullptr;
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
+    if (!is_op_token(ip_, SEMICOLON)) {
         _syntax_error();
         return nullptr;
     }
 
-    root = &tokens_[ip_];
-    decl->right = root;
-    root->parent = decl;
-
+    node_t* root = token_node(ip_);
     ip_++;
 
     root->left = val;
     val->parent = root;
-    parent_node = root;
+    node_t* parent_node = root;
 
     while (1) {
         val = get_op();
         if (val == nullptr) break;
 
-        if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
+        if (!is_op_token(ip_, SEMICOLON)) {
             return nullptr;
         }
 
-        parent_node->right = &tokens_[ip_];
-        tokens_[ip_].parent = parent_node;
+        node_t* semicolon = token_node(ip_);
+        parent_node->right = semicolon;
+        semicolon->parent = parent_node;
 
-        tokens_[ip_].left = val;
-        val->parent = &tokens_[ip_];
+        semicolon->left = val;
+        val->parent = semicolon;
 
-        parent_node = &tokens_[ip_];
+        parent_node = semicolon;
         ip_++;
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CODE_BLOCK_CLOSE) {
+    if (!is_op_token(ip_, CODE_BLOCK_CLOSE)) {
         return nullptr;
     }
     ip_++;
-
-    func_nametable_[func_id].tree = root;
-
-    decl->right = root;
-    root->parent = decl;
-    return decl;
+    return root;
 }
 
 node_t* prog_tree_t::get_new_func() {
     size_t old_ip = ip_;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CALL) {
+    if (!is_op_token(ip_, CALL)) {
         return nullptr;
     }
-    node_t* call = &tokens_[ip_];
+    size_t call_ip = ip_;
     ip_++;
 
-    node_t bracket = {};
-    node_t* first_bracket = &bracket;
-    node_t* func = nullptr;
-    node_t* semicolon = nullptr;
     for (size_t i = 0; i < func_nametable_size_; i++) {
-        if ((size_t) tokens_[ip_].value == func_nametable_[i].var_nametable_index) {
-            func = &tokens_[ip_];
+        if (tokens_[ip_].type == VAR && tokens_[ip_].id == func_nametable_[i].var_nametable_index) {
+            size_t func_ip = ip_;
             ip_++;
-            if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_OPEN) {
+            if (!is_op_token(ip_, BRACKET_OPEN)) {
                 ip_ = old_ip;
                 return nullptr;
             }
             ip_++;
 
-            node_t* var_node = nullptr;
-            if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_CLOSE) {
-                var_node = get_expr();
+            node_t* args = new_node(OP, SEMICOLON);
+            if (!is_op_token(ip_, BRACKET_CLOSE)) {
+                node_t* var_node = get_call_arg();
                 if (var_node == nullptr) {
-                    var_node = get_id();
-                    if (var_node == nullptr) {
-                        return nullptr;
-                    }
+                    return nullptr;
                 }
 
-                semicolon = &tokens_[ip_];
-                node_t* new_semicolon = semicolon;
-                node_t* past_semicolon = nullptr;
-
-                first_bracket->right = semicolon;
-                semicolon->parent = first_bracket;
-
-                while (tokens_[ip_].type == OP && (int) tokens_[ip_].value == SEMICOLON) {
-                    new_semicolon = &tokens_[ip_];
-
-                    if (past_semicolon != nullptr) {
-                        past_semicolon->right = new_semicolon;
-                        new_semicolon->parent = past_semicolon;
-                    }
+                args->left = var_node;
+                var_node->parent = args;
 
-                    new_semicolon->left = var_node;
-                    var_node->parent = new_semicolon;
+                node_t* past_semicolon = args;
+                while (is_op_token(ip_, SEMICOLON)) {
                     ip_++;
 
-                    var_node = get_expr();
+                    var_node = get_call_arg();
                     if (var_node == nullptr) {
-                        var_node = get_id();
-                        if (var_node == nullptr) {
-                            return nullptr;
-                        }
+                        return nullptr;
+                    }
+
+                    if (is_op_token(ip_, SEMICOLON)) {
+                        node_t* new_semicolon = new_node(OP, SEMICOLON);
+                        new_semicolon->left = var_node;
+                        var_node->parent = new_semicolon;
+                        var_node = new_semicolon;
                     }
-                    past_semicolon = new_semicolon;
-                }
 
-                new_semicolon->right = var_node;
+                    past_semicolon->right = var_node;
+                    var_node->parent = past_semicolon;
+                    past_semicolon = var_node;
+                }
             }
 
-            if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_CLOSE) {
+            if (!is_op_token(ip_, BRACKET_CLOSE)) {
+                delete_subtree(args);
                 ip_ = old_ip;
                 return nullptr;
             }
-
-            tokens_[ip_].value = SEMICOLON;
-            tokens_[ip_].right = semicolon->right;
-            tokens_[ip_].left = semicolon->left;
-
-            if (semicolon->left != nullptr) semicolon->left->parent = &tokens_[ip_];
-            if (semicolon->right != nullptr) semicolon->right->parent = &tokens_[ip_];
-
-            call->left = &tokens_[ip_];
-            tokens_[ip_].parent = call;
             ip_++;
 
-            call->right = func;
-            func->parent = call;
-            return call; //NOTE - maybe copy myrr meow
+            node_t* call = token_node(call_ip);
+            call->left = args;
+            args->parent = call;
+
+            call->right = token_node(func_ip);
+            call->right->parent = call;
+            return call;
         }
     }
+
+    ip_ = old_ip;
     return nullptr;
 }
 
+node_t* prog_tree_t::get_call_arg() {
+    node_t* arg = get_expr();
+    if (arg == nullptr) {
+        arg = get_id();
+    }
+    return arg;
+}
+
 node_t* prog_tree_t::get_asgn() {
     size_t old_ip = ip_;
 
@@ -357,27 +367,29 @@ node_t* prog_tree_t::get_asgn() {
         return nullptr;
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != EQ) {
+    if (!is_op_token(ip_, EQ)) {
+        delete_subtree(val);
         ip_ = old_ip;
         return nullptr;
     }
-    node_t* root = &tokens_[ip_];
-
+    size_t eq_ip = ip_;
     ip_++;
 
     node_t* val1 = get_expr();
     if (val1 == nullptr) {
+        delete_subtree(val);
         ip_ = old_ip;
         return nullptr;
     }
 
+    node_t* root = token_node(eq_ip);
     root->right = val1;
     val1->parent = root;
 
     root->left = val;
     val->parent = root;
 
-    return root; //NOTE - change parent of the root
+    return root;
 }
 
 bool prog_tree_t::is_compare(int val) {
@@ -388,14 +400,13 @@ bool prog_tree_t::is_compare(int val) {
 node_t* prog_tree_t::get_if() {
     size_t old_ip = ip_;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != IF) {
-        ip_ = old_ip;
+    if (!is_op_token(ip_, IF)) {
         return nullptr;
     }
-    node_t* root = &tokens_[ip_];
+    size_t if_ip = ip_;
     ip_++;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_OPEN) {
+    if (!is_op_token(ip_, BRACKET_OPEN)) {
         ip_ = old_ip;
         return nullptr;
     }
@@ -407,100 +418,58 @@ node_t* prog_tree_t::get_if() {
         return nullptr;
     }
 
-    if (tokens_[ip_].type != OP || !is_compare((int) tokens_[ip_].value)) {
+    if (tokens_[ip_].type != OP || !is_compare((int) tokens_[ip_].id)) {
+        delete_subtree(val);
         ip_ = old_ip;
         return nullptr;
     }
-    node_t* comp = &tokens_[ip_];
+    size_t comp_ip = ip_;
     ip_++;
 
     node_t* _val = get_expr();
     if (_val == nullptr) {
+        delete_subtree(val);
         ip_ = old_ip;
         return nullptr;
     }
 
+    node_t* comp = token_node(comp_ip);
     comp->right = _val;
+    _val->parent = comp;
     comp->left  = val;
+    val->parent = comp;
 
+    node_t* root = token_node(if_ip);
     root->left = comp;
     comp->parent = root;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != BRACKET_CLOSE) {
+    if (!is_op_token(ip_, BRACKET_CLOSE)) {
+        delete_subtree(root);
         ip_ = old_ip;
         return nullptr;
     }
     ip_++;
 
-    node_t* linker = &tokens_[ip_];
-    if (linker->type != OP || (int) linker->value != CODE_BLOCK_OPEN) {
+    if (!is_op_token(ip_, CODE_BLOCK_OPEN)) {
+        delete_subtree(root);
         ip_ = old_ip;
         return nullptr;
     }
     ip_++;
 
-    node_t* op_val = get_op();
-    if (op_val == nullptr) {
-        _syntax_error();
+    node_t* op_expr_root = get_op_list();
+    if (op_expr_root == nullptr) {
+        delete_subtree(root);
         return nullptr;
     }
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
-        _syntax_error();
-        return nullptr;
-    }
-
-    node_t* op_expr_root = &tokens_[ip_];
-    ip_++;
-
-    op_expr_root->left = op_val;
-    op_val->parent = op_expr_root;
-    node_t* parent_node = op_expr_root;
-
-    while (1) {
-        op_val = get_op();
-        if (op_val == nullptr) break;
-
-        if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
-            return nullptr;
-        }
-
-        parent_node->right = &tokens_[ip_];
-        tokens_[ip_].parent = parent_node;
-
-        tokens_[ip_].left = op_val;
-        op_val->parent = &tokens_[ip_];
-
-        parent_node = &tokens_[ip_];
-        ip_++;
-    }
-
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CODE_BLOCK_CLOSE) {
-        return nullptr;
-    }
-    ip_++;
-
     root->right = op_expr_root;
     op_expr_root->parent = root;
 
-//     node_t* val1 = get_asgn();
-//     if (val1 == nullptr) {
-//         ip_ = old_ip;
-//         return nullptr;
-//     }
-//
-//     root->right = val1;
-//     val1->parent = root;
-//
-//     root->left = comp;
-//     comp->parent = root;
-
-    node_t* else_node = nullptr;
-    else_node = get_else();
-    if (else_node == nullptr) {
-        ;
-    }
-    else {
+    node_t* else_node = get_else();
+    if (else_node != nullptr) {
+        node_t* linker = new_node(OP, SEMICOLON);
+
         linker->right = else_node;
         else_node->parent = linker;
 
@@ -508,74 +477,41 @@ node_t* prog_tree_t::get_if() {
         root->parent = linker;
 
         root = linker;
-        linker->value = SEMICOLON;
     }
     return root;
 }
 
 node_t* prog_tree_t::get_else() {
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != ELSE) {
-        return nullptr;
-    }
-    node_t* root = &tokens_[ip_];
-    ip_++;
+    size_t old_ip = ip_;
 
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CODE_BLOCK_OPEN) {
+    if (!is_op_token(ip_, ELSE)) {
         return nullptr;
     }
+    size_t else_ip = ip_;
     ip_++;
 
-    node_t* op_val = get_op();
-    if (op_val == nullptr) {
-        _syntax_error();
-        return nullptr;
-    }
-
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
-        _syntax_error();
+    if (!is_op_token(ip_, CODE_BLOCK_OPEN)) {
+        ip_ = old_ip;
         return nullptr;
     }
-
-    node_t* op_expr_root = &tokens_[ip_];
     ip_++;
 
-    op_expr_root->left = op_val;
-    op_val->parent = op_expr_root;
-    node_t* parent_node = op_expr_root;
-
-    while (1) {
-        op_val = get_op();
-        if (op_val == nullptr) break;
-
-        if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != SEMICOLON) {
-            return nullptr;
-        }
-
-        parent_node->right = &tokens_[ip_];
-        tokens_[ip_].parent = parent_node;
-
-        tokens_[ip_].left = op_val;
-        op_val->parent = &tokens_[ip_];
-
-        parent_node = &tokens_[ip_];
-        ip_++;
-    }
-
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != CODE_BLOCK_CLOSE) {
+    node_t* op_expr_root = get_op_list();
+    if (op_expr_root == nullptr) {
         return nullptr;
     }
-    ip_++;
 
+    node_t* root = token_node(else_ip);
     root->right = op_expr_root;
     op_expr_root->parent = root;
     return root;
 }
 
 node_t* prog_tree_t::get_ret() {
-    if (tokens_[ip_].type != OP || (int) tokens_[ip_].value != RETURN) {
+    if (!is_op_token(ip_, RETURN)) {
         return nullptr;
     }
-    return &tokens_[ip_++];
+    return token_node(ip_++);
 }
 
 node_t* prog_tree_t::get_op() {
@@ -608,11 +544,10 @@ node_t* prog_tree_t::get_op() {
 }
 
 node_t* prog_tree_t::get_in_out() {
-    if (!(tokens_[ip_].type == OP && ((int) tokens_[ip_].value == IN || (int) tokens_[ip_].value == OUT))) {
+    if (!is_op_token(ip_, IN) && !is_op_token(ip_, OUT)) {
         return nullptr;
     }
-    node_t* cmd_node = &tokens_[ip_];
-
+    size_t cmd_ip = ip_;
     ip_++;
 
     if (tokens_[ip_].type != VAR) {
@@ -620,48 +555,55 @@ node_t* prog_tree_t::get_in_out() {
         return nullptr;
     }
 
-    cmd_node->left = &tokens_[ip_];
-    tokens_[ip_].parent = cmd_node;
+    node_t* cmd_node = token_node(cmd_ip);
+    cmd_node->left = token_node(ip_);
+    cmd_node->left->parent = cmd_node;
     ip_++;
     return cmd_node;
 }
 
 node_t* prog_tree_t::get_expr() {
     node_t* val = get_term();
-    while (tokens_[ip_].type == OP &&
-          ((int) tokens_[ip_].value == ADD ||
-           (int) tokens_[ip_].value == SUB)) {
+    while (is_op_token(ip_, ADD) || is_op_token(ip_, SUB)) {
         size_t op_ip = ip_;
         ip_++;
         node_t* val2 = get_term();
+        if (val2 == nullptr) {
+            _syntax_error();
+            return nullptr;
+        }
 
-        tokens_[op_ip].left = val;
-        val->parent = &tokens_[op_ip];
+        node_t* op = token_node(op_ip);
+        op->left = val;
+        val->parent = op;
 
-        tokens_[op_ip].right = val2;
-        val2->parent = &tokens_[op_ip];
+        op->right = val2;
+        val2->parent = op;
 
-        val = &tokens_[op_ip];
+        val = op;
     }
     return val;
 }
 
 node_t* prog_tree_t::get_term() {
     node_t* val = get_basic_expr();
-    while (tokens_[ip_].type == OP &&
-          ((int) tokens_[ip_].value == MUL ||
-           (int) tokens_[ip_].value == DIV)) {
+    while (is_op_token(ip_, MUL) || is_op_token(ip_, DIV)) {
         size_t op_ip = ip_;
         ip_++;
         node_t* val2 = get_basic_expr();
+        if (val2 == nullptr) {
+            _syntax_error();
+            return nullptr;
+        }
 
-        tokens_[op_ip].left = val;
-        val->parent = &tokens_[op_ip];
+        node_t* op = token_node(op_ip);
+        op->left = val;
+        val->parent = op;
 
-        tokens_[op_ip].right = val2;
-        val2->parent = &tokens_[op_ip];
+        op->right = val2;
+        val2->parent = op;
 
-        val = &tokens_[op_ip];
+        val = op;
     }
     return val;
 }
@@ -669,25 +611,25 @@ node_t* prog_tree_t::get_term() {
 node_t* prog_tree_t::get_basic_expr() {
     node_t* val1 = nullptr;
 
-    if (tokens_[ip_].type == OP && (int) tokens_[ip_].value == SUB) {
+    if (is_op_token(ip_, SUB) || is_op_token(ip_, ADD)) {
         size_t old_p = ip_;
         ip_++;
-        tokens_[old_p].right = get_basic_expr();
-        tokens_[old_p].left = nullptr;
-        val1 = &tokens_[old_p];
-    }
-    else if (tokens_[ip_].type == OP && (int) tokens_[ip_].value == ADD) {
-        size_t old_p = ip_;
-        ip_++;
-        tokens_[old_p].right = get_basic_expr();
-        tokens_[old_p].left = nullptr;
-        val1 = &tokens_[old_p];
+        node_t* val = get_basic_expr();
+        if (val == nullptr) {
+            _syntax_error();
+            return nullptr;
+        }
+
+        val1 = token_node(old_p);
+        val1->right = val;
+        val->parent = val1;
     }
-    else if (tokens_[ip_].type == OP && (int) tokens_[ip_].value == BRACKET_OPEN) {
+    else if (is_op_token(ip_, BRACKET_OPEN)) {
         ip_++;
         node_t* val = get_expr();
 
-        if (!(tokens_[ip_].type == OP && (int) tokens_[ip_].value == BRACKET_CLOSE)) {
+        if (!is_op_token(ip_, BRACKET_CLOSE)) {
+            delete_subtree(val);
             return nullptr;
         }
 
@@ -709,51 +651,61 @@ node_t* prog_tree_t::get_basic_expr() {
         return nullptr;
     }
 
-    if (tokens_[ip_].type == OP && (int) tokens_[ip_].value == POW) {
-        size_t old_p = ip_;
+    if (is_op_token(ip_, POW)) {
+        node_t* pow = token_node(ip_);
         ip_++;
 
-        tokens_[old_p].left = val1;
-        tokens_[old_p].right = get_basic_expr();
+        pow->left = val1;
+        val1->parent = pow;
 
-        val1 = &tokens_[old_p];
+        pow->right = get_basic_expr();
+        if (pow->right == nullptr) {
+            _syntax_error();
+            return nullptr;
+        }
+        pow->right->parent = pow;
+
+        val1 = pow;
     }
     return val1;
 }
 
 node_t* prog_tree_t::get_num() {
-    return (tokens_[ip_].type == NUM) ? &tokens_[ip_++] : nullptr;
+    return (tokens_[ip_].type == NUM) ? token_node(ip_++) : nullptr;
 }
 
 node_t* prog_tree_t::get_id() {
-    return (tokens_[ip_].type == VAR) ? &tokens_[ip_++] : nullptr;
+    return (tokens_[ip_].type == VAR) ? token_node(ip_++) : nullptr;
 }
 
 node_t* prog_tree_t::get_func() {
-    size_t old_p = ip_;
-
     if (tokens_[ip_].type == OP &&
-       ((int) tokens_[ip_].value == SIN    ||
-        (int) tokens_[ip_].value == COS    ||
-        (int) tokens_[ip_].value == TG     ||
-        (int) tokens_[ip_].value == CTG    ||
-        (int) tokens_[ip_].value == SH     ||
-        (int) tokens_[ip_].value == CH     ||
-        (int) tokens_[ip_].value == TH     ||
-        (int) tokens_[ip_].value == CTH    ||
-        (int) tokens_[ip_].value == ARCSIN ||
-        (int) tokens_[ip_].value == ARCCOS ||
-        (int) tokens_[ip_].value == ARCTG  ||
-        (int) tokens_[ip_].value == ARCCTG ||
-        (int) tokens_[ip_].value == ARCSH  ||
-        (int) tokens_[ip_].value == ARCCH  ||
-        (int) tokens_[ip_].value == ARCTH  ||
-        (int) tokens_[ip_].value == ARCCTH ||
-        (int) tokens_[ip_].value == EXP    ||
-        (int) tokens_[ip_].value == LN)) {
+       ((int) tokens_[ip_].id == SIN    ||
+        (int) tokens_[ip_].id == COS    ||
+        (int) tokens_[ip_].id == TG     ||
+        (int) tokens_[ip_].id == CTG    ||
+        (int) tokens_[ip_].id == SH     ||
+        (int) tokens_[ip_].id == CH     ||
+        (int) tokens_[ip_].id == TH     ||
+        (int) tokens_[ip_].id == CTH    ||
+        (int) tokens_[ip_].id == ARCSIN ||
+        (int) tokens_[ip_].id == ARCCOS ||
+        (int) tokens_[ip_].id == ARCTG  ||
+        (int) tokens_[ip_].id == ARCCTG ||
+        (int) tokens_[ip_].id == ARCSH  ||
+        (int) tokens_[ip_].id == ARCCH  ||
+        (int) tokens_[ip_].id == ARCTH  ||
+        (int) tokens_[ip_].id == ARCCTH ||
+        (int) tokens_[ip_].id == EXP    ||
+        (int) tokens_[ip_].id == LN)) {
+        node_t* func = token_node(ip_);
         ip_++;
-        tokens_[old_p].left = get_basic_expr();
+
+        func->left = get_basic_expr();
+        if (func->left != nullptr) {
+            func->left->parent = func;
+        }
+        return func;
     }
-    return (old_p == ip_) ? nullptr : &tokens_[old_p];
+    return nullptr;
 }
-
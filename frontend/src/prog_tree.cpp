@@ -1,50 +1,76 @@
 #include <assert.h>
 #include "prog_tree.h"
+#include "tree_walk.h"
 #include "logger.h"
 
 err_t prog_tree_t::init(FILE* data_file) {
     assert(data_file != nullptr);
 
     text_t text = {};
-    if (text_ctor(&text, data_file) != TEXT_NO_ERRORS) {
+    if (text_mmap_ctor(&text, data_file) != TEXT_NO_ERRORS) {
         LOG(ERROR, "Failed to read text\n");
         return SYNTAX_ERR;
     }
 
-    for (size_t i = 0; i < 100; i++) {
-        var_nametable_[i].initialized = false;
-    }
-
+    is_syntax_err_ = false;
     root_ = token_init(&text);
+    text_dtor(&text);
+    if (is_syntax_err_) {
+        return SYNTAX_ERR;
+    }
+    if (!shift_single_children(root_)) {
+        return MEM_ALLOC_ERR;
+    }
 
     dump_tree();
-    text_dtor(&text);
     return NO_ERR;
 }
 
 void prog_tree_t::tokens_dtor() {
     free(tokens_);
     tokens_ = nullptr;
+    tokens_array_size_ = 0;
+    tokens_capacity_ = 0;
 }
 
 void prog_tree_t::tree_dtor() {
-    delete_subtree_r(root_);
+    arena_.dtor();
     root_ = nullptr;
+
+    nametable_dtor();
 }
 
-void prog_tree_t::delete_subtree_r(node_t* node) {
-    if (node == nullptr) {
-        return;
-    }
+// NOTE - if the walk stops early the rest of the nodes stays in the arena until tree_dtor()
+void prog_tree_t::delete_subtree(node_t* node) {
+    tree_walk_t walk = {};
+    walk.init(node);
 
-    if (node->left != nullptr) {
-        delete_subtree_r(node->left);
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event == WALK_LEAVE) {
+            free_node(step.node);
+        }
     }
+    walk.dtor();
+}
 
-    if (node->right != nullptr) {
-        delete_subtree_r(node->right);
-    }
+void prog_tree_t::free_node(node_t* node) {
+    arena_.free_node(node);
+}
+
+// NOTE - text hand-off keeps no side for a single child, later stages expect it on the left
+bool prog_tree_t::shift_single_children(node_t* node) {
+    tree_walk_t walk = {};
+    walk.init(node);
 
-    free(node);
-    node = nullptr;
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event == WALK_ENTER && step.node->left == nullptr && step.node->right != nullptr) {
+            step.node->left = step.node->right;
+            step.node->right = nullptr;
+        }
+    }
+    bool is_ok = !walk.is_alloc_err();
+    walk.dtor();
+    return is_ok;
 }
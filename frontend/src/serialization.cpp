@@ -2,43 +2,46 @@
 #include <string.h>
 #include <ctype.h>
 #include "prog_tree.h"
+#include "tree_walk.h"
 #include "logger.h"
 
-void prog_tree_t::print_node_r(FILE* ostream, node_t* node, size_t tab_cnt) {
-    if (node == nullptr) {
-        return;
-    }
-
-    for (size_t i = 0; i < tab_cnt; i++) {
-        fprintf(ostream, "\t");
-    }
-
-    fprintf(ostream, "{");
-
-    print_node_data(ostream, node);
-
-    if (node->left != nullptr) {
-        fprintf(ostream, "\n");
-        print_node_r(ostream, node->left, tab_cnt + 1);
-    }
-
-    if (node->right != nullptr) {
-        fprintf(ostream, "\n");
-        print_node_r(ostream, node->right, tab_cnt + 1);
-    }
+bool prog_tree_t::print_node(FILE* ostream, node_t* node, size_t tab_cnt) {
+    tree_walk_t walk = {};
+    walk.init(node);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        size_t depth = tab_cnt + step.depth;
+
+        if (step.event == WALK_ENTER) {
+            if (step.rel != ROOT) {
+                fprintf(ostream, "\n");
+            }
+            for (size_t i = 0; i < depth; i++) {
+                fprintf(ostream, "\t");
+            }
+
+            fprintf(ostream, "{");
+            print_node_data(ostream, step.node);
+            continue;
+        }
 
-    if (node->right != nullptr || node->left != nullptr) {
-        for (size_t i = 0; i < tab_cnt; i++) {
-            fprintf(ostream, "\t");
+        if (step.node->right != nullptr || step.node->left != nullptr) {
+            for (size_t i = 0; i < depth; i++) {
+                fprintf(ostream, "\t");
+            }
         }
-    }
 
-    fprintf(ostream, "}\n");
+        fprintf(ostream, "}\n");
+    }
+    bool is_ok = !walk.is_alloc_err();
+    walk.dtor();
+    return is_ok;
 }
 
-void prog_tree_t::deserialization(FILE* ostream) {
+bool prog_tree_t::deserialization(FILE* ostream) {
     // NOTE -  print header
-    print_node_r(ostream, root_, 0);
+    return print_node(ostream, root_, 0);
 }
 
 
@@ -70,13 +73,18 @@ void prog_tree_t::serialization(FILE* istream) {
     assert(istream != nullptr);
 
     text_t text = {};
-    if (text_ctor(&text, istream) != TEXT_NO_ERRORS) {
+    if (text_mmap_ctor(&text, istream) != TEXT_NO_ERRORS) {
         LOG(ERROR, "Failed to read text\n");
         return;
     }
 
-    size_t ip = 0;
-    root_ = parse_node_r(&text, &ip);
+    if (text.symbols_amount > sizeof(AST_MAGIC) && memcmp(text.symbols, AST_MAGIC, sizeof(AST_MAGIC)) == 0) {
+        root_ = parse_bin(&text);
+    }
+    else {
+        size_t ip = 0;
+        root_ = parse_node(&text, &ip);
+    }
     text_dtor(&text);
 }
 
@@ -89,7 +97,7 @@ void prog_tree_t::skip_spaces(text_t* text, size_t* ip) {
     }
 }
 
-node_t* prog_tree_t::parse_node_r(text_t* text, size_t* ip) {
+node_t* prog_tree_t::parse_node_data(text_t* text, size_t* ip) {
     assert(text != nullptr);
     assert(ip != nullptr);
 
@@ -130,44 +138,70 @@ node_t* prog_tree_t::parse_node_r(text_t* text, size_t* ip) {
     else if (strstr(token, "NUM") != nullptr) {
         node = new_node(NUM, parse_number(token));
     }
+    return node;
+}
 
-    if (node == nullptr) {
-        return nullptr;
-    }
+// NOTE - each frame waits for its children: FRAME_LEFT, then FRAME_RIGHT, then the closing '}'
+node_t* prog_tree_t::parse_node(text_t* text, size_t* ip) {
+    assert(text != nullptr);
+    assert(ip != nullptr);
 
-    skip_spaces(text, ip);
+    walk_stack_t stack = {};
+    node_t* root = nullptr;
 
-    if (text->symbols[*ip] == '{') {
-        node->left = parse_node_r(text, ip);
-        if (node->left != nullptr) {
-            node->left->parent = node;
-        }
-    }
-    else {
-        node->left = nullptr;
-    }
+    do {
+        node_t* node = parse_node_data(text, ip);
 
-    skip_spaces(text, ip);
+        walk_frame_t* parent = stack.top();
+        if (parent == nullptr) {
+            root = node;
+        }
+        else {
+            if (parent->state == FRAME_LEFT) {
+                parent->node->left = node;
+            }
+            else {
+                parent->node->right = node;
+            }
+            if (node != nullptr) {
+                node->parent = parent->node;
+            }
+            parent->state = (frame_state_t) (parent->state + 1);
+        }
 
-    if (text->symbols[*ip] == '{') {
-        node->right = parse_node_r(text, ip);
-        if (node->right != nullptr) {
-            node->right->parent = node;
+        if (node != nullptr) {
+            walk_frame_t* frame = stack.push(node, ROOT);
+            if (frame == nullptr) {
+                root = nullptr;
+                break;
+            }
+            frame->state = FRAME_LEFT;
         }
-    }
-    else {
-        node->right = nullptr;
-    }
 
-    skip_spaces(text, ip);
+        while (stack.size() != 0) {
+            walk_frame_t* frame = stack.top();
+            skip_spaces(text, ip);
+
+            if (frame->state != FRAME_LEAVE && text->symbols[*ip] == '{') {
+                break;
+            }
+            if (frame->state != FRAME_LEAVE) {
+                frame->state = (frame_state_t) (frame->state + 1);
+                continue;
+            }
+
+            if (text->symbols[*ip] != '}') {
+                LOG(ERROR, "Syntax err %c, ip = %zu\n", text->symbols[*ip], *ip);
+            }
+            else {
+                (*ip)++;
+            }
+            stack.pop();
+        }
+    } while (stack.size() != 0);
 
-    if (text->symbols[*ip] != '}') {
-        LOG(ERROR, "Syntax err %s, ip = %zu\n", text->symbols[*ip], *ip);
-    }
-    else {
-        (*ip)++;
-    }
-    return node;
+    stack.dtor();
+    return root;
 }
 
 double prog_tree_t::parse_number(char* buffer) {
@@ -179,30 +213,24 @@ double prog_tree_t::parse_number(char* buffer) {
 }
 
 double prog_tree_t::parse_operator(char* buffer) {
-    for (size_t i = 0; i < func_name_table_len; i++) {
-        if (strstr(buffer, func_name_table[i].name) != nullptr) {
-            return func_name_table[i].code;
-        }
-        if (strstr(buffer, "IAEQ") != nullptr) {  //NOTE - fixme babe
-            return IAEQ;
-        }
-        if (strstr(buffer, "IA") != nullptr) {  //NOTE - fixme babe
-            return IA;
-        }
-        if (strstr(buffer, "IBEQ") != nullptr) {  //NOTE - fixme babe
-            return IBEQ;
-        }
-        if (strstr(buffer, "IB") != nullptr) {  //NOTE - fixme babe
-            return IB;
-        }
-        if (strstr(buffer, "INE") != nullptr) {  //NOTE - fixme babe
-            return INE;
-        }
-        if (strstr(buffer, "IE") != nullptr) {  //NOTE - fixme babe
-            return IE;
-        }
+    char name[MAX_NAME_LEN] = "";
+
+    char* begin = strchr(buffer, '"');
+    if (begin == nullptr) {
+        LOG(ERROR, "Operator without quotes %s\n", buffer);
+        return POISON;
+    }
+    begin++;
+
+    for (size_t i = 0; i < MAX_NAME_LEN - 1 && begin[i] != '"' && begin[i] != '\0'; i++) {
+        name[i] = begin[i];
+    }
+
+    op_t op = op_text_to_op(name);
+    if (op == POISON) {
+        LOG(ERROR, "Unknown operator %s\n", name);
     }
-    return NULL;
+    return op;
 }
 
 double prog_tree_t::parse_func(char* buffer) {
@@ -230,7 +258,7 @@ double prog_tree_t:: parse_variable(char* buffer) {
 }
 
 node_t* prog_tree_t::new_node(type_t type, double val) {
-    node_t* new_node = (node_t*) calloc(sizeof(node_t), 1);
+    node_t* new_node = arena_.alloc_node();
     if (new_node == nullptr) {
         LOG(ERROR, "Mem alloc err\n");
         return nullptr;
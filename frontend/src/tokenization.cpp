@@ -8,25 +8,66 @@
 #include "logger.h"
 #include "prog_tree.h"
 
+const size_t TOKENS_MIN_CAPACITY = 64;
+
 node_t* prog_tree_t::token_init(text_t* text) {
     assert(text != nullptr);
 
-    tokens_ = (node_t*) calloc(sizeof(node_t), text->symbols_amount);
+    tokens_ = (token_t*) calloc(sizeof(token_t), TOKENS_MIN_CAPACITY);
     if (tokens_ == nullptr) {
         LOG(ERROR, "Memory allocation error\n");
         return nullptr;
     }
-    tokens_array_size_ = text->symbols_amount;
+    tokens_capacity_ = TOKENS_MIN_CAPACITY;
+    tokens_array_size_ = 0;
 
     tokenize_text(text);
 
+    token_t* eot = new_token();
+    if (eot == nullptr) {
+        return nullptr;
+    }
+    initialize_op_token(eot, EOT);
+    eot->offset = (uint32_t) text->symbols_amount;
+
+    token_t* tokens = (token_t*) realloc(tokens_, sizeof(token_t) * tokens_array_size_);
+    if (tokens != nullptr) {
+        tokens_ = tokens;
+        tokens_capacity_ = tokens_array_size_;
+    }
+
    //print_tokens_array();
    // print_var_nametable();
 
     root_ = link_tokens();
+    tokens_dtor();
     return root_;
 }
 
+token_t* prog_tree_t::new_token() {
+    if (tokens_array_size_ == tokens_capacity_) {
+        token_t* tokens = (token_t*) realloc(tokens_, sizeof(token_t) * tokens_capacity_ * 2);
+        if (tokens == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return nullptr;
+        }
+        tokens_ = tokens;
+        tokens_capacity_ *= 2;
+    }
+
+    token_t* token = &tokens_[tokens_array_size_++];
+    *token = {};
+    return token;
+}
+
+node_t* prog_tree_t::token_node(size_t ip) {
+    const token_t* token = &tokens_[ip];
+    if (token->type == NUM) {
+        return new_node(NUM, token->number);
+    }
+    return new_node((type_t) token->type, token->id);
+}
+
 node_t* prog_tree_t::link_tokens() {
     return get_gram();
 }
@@ -38,7 +79,6 @@ void prog_tree_t::tokenize_text(text_t* text) {
     }
 
     size_t ip = 0;
-    size_t i = 0;
     while (ip < text->symbols_amount) {
         while (isspace(text->symbols[ip])) {
             ip++;
@@ -46,86 +86,91 @@ void prog_tree_t::tokenize_text(text_t* text) {
 
         if (text->symbols[ip] == '\0') break;
 
+        token_t* token = new_token();
+        if (token == nullptr) {
+            is_syntax_err_ = true;
+            return;
+        }
+        token->offset = (uint32_t) ip;
+
         if (isdigit(text->symbols[ip])) {
-            parse_number(text, &ip, &tokens_[i]);
+            parse_number(text, &ip, token);
         }
-        else if (parse_operator(text, &ip, &tokens_[i]) == true) {
+        else if (parse_operator(text, &ip, token) == true) {
             ;
         }
-        else if (parse_identificator(text, &ip, &tokens_[i]) != NO_ERR) {
-            printf("Syntax err %c(%d) %zu\n", text->symbols[ip], text->symbols[ip], text->symbols_amount);
+        else if (parse_identificator(text, &ip, token) != NO_ERR) {
+            LOG(ERROR, "Syntax error at %zu: '%c'\n", ip, text->symbols[ip]);
+            tokens_array_size_--;
+            is_syntax_err_ = true;
             return;
         }
-        i++;
     }
 }
 
 void prog_tree_t::print_tokens_array() {
     printf("\n\n\n\n\nDumping:");
     for (size_t i = 0; i < tokens_array_size_; i++) {
-        printf("---\nnode[%p][%zu]:\n\ttype = %d\n\tval = %f\nr = %p,l = %p\n-----\n", &tokens_[i], i, tokens_[i].type, tokens_[i].value, tokens_[i].right, tokens_[i].left);
+        printf("---\ntoken[%zu]:\n\ttype = %d\n\tid = %u\n\toffset = %u\n-----\n", i, tokens_[i].type, tokens_[i].id, tokens_[i].offset);
     }
 }
 
-bool prog_tree_t::parse_operator(text_t* text, size_t* ip, node_t* node) {
+bool prog_tree_t::parse_operator(text_t* text, size_t* ip, token_t* token) {
     assert(text != nullptr);
     assert(ip != nullptr);
-    assert(node != nullptr);
+    assert(token != nullptr);
 
-    node->type = OP;
-    node->parent = nullptr;
-    node->right = nullptr;
-    node->left = nullptr;
+    token->type = OP;
 
     switch (text->symbols[*ip]) {
         case '+': {
-            node->value = ADD;
+            token->id = ADD;
             break;
         }
         case '-': {
-            node->value = SUB;
+            token->id = SUB;
             break;
         }
         case '*': {
-            node->value = MUL;
+            token->id = MUL;
             break;
         }
         case '/': {
-            node->value = DIV;
+            token->id = DIV;
             break;
         }
         case '^': {
-            node->value = POW;
+            token->id = POW;
             break;
         }
         case '$': {
-            node->value = EOT;
+            token->id = EOT;
             break;
         }
         case ';': {
-            node->value = SEMICOLON;
+            token->id = SEMICOLON;
             break;
         }
         case '(': {
-            node->value = BRACKET_OPEN;
+            token->id = BRACKET_OPEN;
             break;
         }
         case ')': {
-            node->value = BRACKET_CLOSE;
+            token->id = BRACKET_CLOSE;
             break;
         }
         case '{': {
-            node->value = CODE_BLOCK_OPEN;
+            token->id = CODE_BLOCK_OPEN;
             break;
         }
         case '}': {
-            node->value = CODE_BLOCK_CLOSE;
+            token->id = CODE_BLOCK_CLOSE;
             break;
         }
         case '!': {
             if (text->symbols[*ip + 1] == '=') {
                 (*ip)++;
-                node->value = INE;
+                token->id = INE;
             }
             else {
                 return false;
@@ -135,30 +180,30 @@ bool prog_tree_t::parse_operator(text_t* text, size_t* ip, node_t* node) {
         case '=': {
             if (text->symbols[*ip + 1] == '=') {
                 (*ip)++;
-                node->value = IE;
+                token->id = IE;
             }
             else {
-                node->value = EQ;
+                token->id = EQ;
             }
             break;
         }
         case '>': {
             if (text->symbols[*ip + 1] == '=') {
                 (*ip)++;
-                node->value = IAEQ;
+                token->id = IAEQ;
             }
             else {
-                node->value = IA;
+                token->id = IA;
             }
             break;
         }
         case '<': {
             if (text->symbols[*ip + 1] == '=') {
                 (*ip)++;
-                node->value = IBEQ;
+                token->id = IBEQ;
             }
             else {
-                node->value = IB;
+                token->id = IB;
             }
             break;
         }
@@ -171,10 +216,10 @@ bool prog_tree_t::parse_operator(text_t* text, size_t* ip, node_t* node) {
     return true;
 }
 
-err_t prog_tree_t::parse_identificator(text_t* text, size_t* ip, node_t* node) {
+err_t prog_tree_t::parse_identificator(text_t* text, size_t* ip, token_t* token) {
     assert(text != nullptr);
     assert(ip != nullptr);
-    assert(node != nullptr);
+    assert(token != nullptr);
 
     size_t i = 0;
     char name[MAX_NAME_LEN] = "";
@@ -190,23 +235,23 @@ err_t prog_tree_t::parse_identificator(text_t* text, size_t* ip, node_t* node) {
         LOG(ERROR, "Too long name error\n");
         return SYNTAX_ERR;
     }
+    // NOTE - a symbol that starts no token, ip would not move past it
+    if (i == 0) {
+        return SYNTAX_ERR;
+    }
 
     op_t func = is_operator(name);
     if (func != POISON) {
-        node->type = OP;
-        node->value = func;
-
-        node->parent = nullptr;
-        node->right = nullptr;
-        node->left = nullptr;
+        token->type = OP;
+        token->id = (uint32_t) func;
     }
     else {
-        node->type = VAR;
-        node->value = index_in_nametable(name);
-
-        node->parent = nullptr;
-        node->right = nullptr;
-        node->left = nullptr;
+        double index = index_in_nametable(name);
+        if (index < 0) {
+            return MEM_ALLOC_ERR;
+        }
+        token->type = VAR;
+        token->id = (uint32_t) index;
     }
     return NO_ERR;
 }
@@ -222,22 +267,78 @@ double prog_tree_t::index_in_nametable(char* name) {
     return add_name_to_nametable(name);
 }
 
+const size_t NAMETABLE_MIN_CAPACITY = 64;
+
 double prog_tree_t::add_name_to_nametable(char* name) {
     assert(name != nullptr);
 
-    strncpy(var_nametable_[var_nametable_size_++].name, name, MAX_NAME_LEN);
-    return var_nametable_size_ - 1;
+    if (var_nametable_size_ == var_nametable_capacity_) {
+        size_t capacity = (var_nametable_capacity_ == 0) ? NAMETABLE_MIN_CAPACITY : var_nametable_capacity_ * 2;
+        name_t* nametable = (name_t*) realloc(var_nametable_, sizeof(name_t) * capacity);
+        if (nametable == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return -1;
+        }
+        var_nametable_ = nametable;
+        var_nametable_capacity_ = capacity;
+    }
+
+    name_t* new_name = &var_nametable_[var_nametable_size_];
+    strncpy(new_name->name, name, MAX_NAME_LEN - 1);
+    new_name->name[MAX_NAME_LEN - 1] = '\0';
+    new_name->initialized = false;
+
+    if (names_.insert(name, intern_table_t::hash(name), INTERN_NAME, var_nametable_size_) == nullptr) {
+        return -1;
+    }
+    return (double) var_nametable_size_++;
+}
+
+// NOTE - variables made up by the optimizer get the first prefixN nobody uses yet
+double prog_tree_t::add_temp_name(const char* prefix) {
+    assert(prefix != nullptr);
+
+    char name[MAX_NAME_LEN] = "";
+    for (size_t i = var_nametable_size_; ; i++) {
+        snprintf(name, MAX_NAME_LEN, "%s%zu", prefix, i);
+        if (find_name_in_nametable(name) < 0) {
+            break;
+        }
+    }
+
+    double index = add_name_to_nametable(name);
+    if (index >= 0) {
+        var_nametable_[(size_t) index].initialized = true;
+    }
+    return index;
 }
 
 double prog_tree_t::find_name_in_nametable(char* name) {
     assert(name != nullptr);
 
-    for (size_t i = 0; i < var_nametable_size_; i++) {
-        if (strncmp(var_nametable_[i].name, name, MAX_NAME_LEN) == 0) {
-            return i;
-        }
+    intern_slot_t* slot = names_.find(name, intern_table_t::hash(name));
+    if (slot == nullptr || slot->kind != INTERN_NAME) {
+        return -1;
     }
-    return -1;
+    return (double) slot->id;
+}
+
+void prog_tree_t::nametable_dtor() {
+    free(var_nametable_);
+    var_nametable_ = nullptr;
+    var_nametable_size_ = 0;
+    var_nametable_capacity_ = 0;
+
+    free(func_nametable_);
+    func_nametable_ = nullptr;
+    func_nametable_size_ = 0;
+    func_nametable_capacity_ = 0;
+
+    names_.dtor();
+}
+
+size_t prog_tree_t::var_nametable_size() {
+    return var_nametable_size_;
 }
 
 void prog_tree_t::print_var_nametable() {
@@ -249,33 +350,22 @@ void prog_tree_t::print_var_nametable() {
 op_t prog_tree_t::is_operator(char* op) {
     assert(op != nullptr);
 
-    for (size_t i = 0; i < func_name_table_len; i++) {
-        if (strncmp(func_name_table[i].name, op, sizeof(func_name_table[i].name)) == 0) {
-            return func_name_table[i].code;
-        }
-    }
-    return POISON;
+    return keyword_to_op(op);
 }
 
-void prog_tree_t::initialize_op_node(node_t* node, double val) {
-    assert(node != nullptr);
-
-    node->parent = nullptr;
-    node->right = nullptr;
-    node->left = nullptr;
+void prog_tree_t::initialize_op_token(token_t* token, op_t op) {
+    assert(token != nullptr);
 
-    node->type = OP;
-    node->value = val;
+    token->type = OP;
+    token->id = (uint32_t) op;
 }
 
-void prog_tree_t::parse_number(text_t* text, size_t* ip, node_t* node) {
+void prog_tree_t::parse_number(text_t* text, size_t* ip, token_t* token) {
     assert(text != nullptr);
     assert(ip != nullptr);
+    assert(token != nullptr);
 
-    node->parent = nullptr;
-    node->right = nullptr;
-    node->left = nullptr;
-    node->type = NUM;
+    token->type = NUM;
 
     int num = 0;
     while (text->symbols[*ip] >= '0' && text->symbols[*ip] <= '9') {
@@ -288,7 +378,7 @@ void prog_tree_t::parse_number(text_t* text, size_t* ip, node_t* node) {
     }
 
     if (text->symbols[*ip] != '.') {
-        node->value = (double) num;
+        token->number = (double) num;
         return;
     }
     (*ip)++;
@@ -306,6 +396,6 @@ void prog_tree_t::parse_number(text_t* text, size_t* ip, node_t* node) {
     }
 
     printf("");
-    node->value = (dec == 0) ? (double) num : (double) num / pow(10, dec);
+    token->number = (dec == 0) ? (double) num : (double) num / pow(10, dec);
     return;
 }
@@ -0,0 +1,112 @@
+#include <assert.h>
+#include "tree_walk.h"
+#include "logger.h"
+
+walk_frame_t* walk_stack_t::push(node_t* node, rel_t rel) {
+    if (size_ == capacity_) {
+        size_t capacity = (capacity_ == 0) ? WALK_STACK_MIN_CAPACITY : capacity_ * 2;
+        walk_frame_t* frames = (walk_frame_t*) realloc(frames_, sizeof(walk_frame_t) * capacity);
+        if (frames == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return nullptr;
+        }
+        frames_ = frames;
+        capacity_ = capacity;
+    }
+
+    walk_frame_t* frame = &frames_[size_++];
+    frame->node  = node;
+    frame->rel   = rel;
+    frame->state = FRAME_ENTER;
+    return frame;
+}
+
+walk_frame_t* walk_stack_t::top() {
+    return (size_ == 0) ? nullptr : &frames_[size_ - 1];
+}
+
+void walk_stack_t::pop() {
+    assert(size_ != 0);
+
+    size_--;
+}
+
+size_t walk_stack_t::size() {
+    return size_;
+}
+
+void walk_stack_t::dtor() {
+    free(frames_);
+    frames_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+}
+
+//=========================================================================================
+
+void tree_walk_t::init(node_t* root) {
+    if (root != nullptr && stack_.push(root, ROOT) == nullptr) {
+        is_alloc_err_ = true;
+    }
+}
+
+bool tree_walk_t::next(walk_step_t* step) {
+    assert(step != nullptr);
+
+    while (!is_alloc_err_ && stack_.size() != 0) {
+        walk_frame_t* frame = stack_.top();
+        node_t* node = frame->node;
+
+        switch (frame->state) {
+            case FRAME_ENTER:
+                frame->state = FRAME_LEFT;
+                step->node  = node;
+                step->rel   = frame->rel;
+                step->event = WALK_ENTER;
+                step->depth = stack_.size() - 1;
+                return true;
+            case FRAME_LEFT:
+                frame->state = FRAME_RIGHT;
+                if (node->left != nullptr && stack_.push(node->left, LEFT) == nullptr) {
+                    is_alloc_err_ = true;
+                    return false;
+                }
+                break;
+            case FRAME_RIGHT:
+                frame->state = FRAME_LEAVE;
+                if (node->right != nullptr && stack_.push(node->right, RIGHT) == nullptr) {
+                    is_alloc_err_ = true;
+                    return false;
+                }
+                break;
+            case FRAME_LEAVE:
+                step->node  = node;
+                step->rel   = frame->rel;
+                step->event = WALK_LEAVE;
+                step->depth = stack_.size() - 1;
+                stack_.pop();
+                return true;
+            default:
+                assert(0 && "Unknown walk frame state");
+                return false;
+        }
+    }
+    return false;
+}
+
+// NOTE - valid right after WALK_ENTER: the node gets its WALK_LEAVE without visiting children
+void tree_walk_t::skip_children() {
+    walk_frame_t* frame = stack_.top();
+    if (frame != nullptr && frame->state == FRAME_LEFT) {
+        frame->state = FRAME_LEAVE;
+    }
+}
+
+bool tree_walk_t::is_alloc_err() {
+    return is_alloc_err_;
+}
+
+void tree_walk_t::dtor() {
+    stack_.dtor();
+    is_alloc_err_ = false;
+}
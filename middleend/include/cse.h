@@ -0,0 +1,88 @@
+#ifndef CSE_H
+#define CSE_H
+
+#include <stdint.h>
+#include "prog_tree.h"
+
+const size_t   CSE_NO_ID         = SIZE_MAX;
+const size_t   CSE_MIN_CAPACITY  = 64;
+const char     CSE_TEMP_PREFIX[] = "_cse";
+const uint64_t CSE_PTR_HASH_MUL  = UINT64_C(11400714819323198485);  // 2^64 / golden ratio
+
+typedef struct {
+    size_t stamp;   // block the slot was filled in, slots of older blocks are free
+    type_t type;
+    double value;
+    size_t left;
+    size_t right;
+    size_t id;
+} cse_expr_slot_t;
+
+typedef struct {
+    size_t stamp;
+    node_t* node;
+    size_t id;
+} cse_node_slot_t;
+
+typedef struct {
+    bool is_pure;
+    size_t evaluations;  // occurrences still evaluated once repeated parents are reused
+    double temp;         // variable holding the value, -1 before the first evaluation
+} cse_value_t;
+
+// NOTE - hash-consing of the expressions of a basic block: equal subtrees get the same
+//        id, keyed on the op and the ids of the children. Every write to a variable
+//        gives it a new id, so an expression reading it stops matching the old ones.
+//        A pure expression evaluated twice or more is stored in a new variable defined
+//        right before its first evaluation and the other occurrences read that variable.
+//        Calls do not invalidate anything: arguments are passed by value and there are
+//        no globals
+class cse_t {
+public:
+    size_t run(prog_tree_t* tree);
+    void dtor();
+private:
+    void run_list(node_t* list);
+    void begin_block();
+    void finish_block(node_t* first, node_t* last);
+    size_t collect_roots(node_t* stmt);
+    void number_stmt(node_t* stmt);
+    void number_expr(node_t* expr);
+    void count_evaluations(node_t* expr);
+    void reuse_values(node_t* expr, node_t* list_node);
+    void extract(node_t* node, size_t id, node_t* list_node);
+    bool is_block_end(node_t* stmt);
+    void run_bodies(node_t* stmt);
+
+    size_t expr_id(type_t type, double value, size_t left, size_t right);
+    void set_node_id(node_t* node, size_t id);
+    size_t node_id(node_t* node);
+    size_t new_id(bool is_pure);
+    bool grow_exprs();
+    bool grow_nodes();
+
+    prog_tree_t* tree_{nullptr};
+    size_t eliminated_{0};
+    size_t stamp_{0};
+    bool is_alloc_err_{false};  // numbering failed, nothing more is rewritten
+
+    cse_expr_slot_t* exprs_{nullptr};
+    size_t exprs_size_{0};
+    size_t exprs_capacity_{0};
+
+    cse_node_slot_t* nodes_{nullptr};
+    size_t nodes_size_{0};
+    size_t nodes_capacity_{0};
+
+    cse_value_t* values_{nullptr};
+    size_t values_size_{0};
+    size_t values_capacity_{0};
+
+    size_t* versions_{nullptr};  // writes to every variable so far
+    size_t versions_size_{0};
+
+    node_t** roots_{nullptr};    // expressions read by the statement being handled
+    size_t roots_capacity_{0};
+};
+
+#endif /* CSE_H */
@@ -0,0 +1,33 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "prog_tree.h"
+
+// NOTE - removes statements that never run or whose result is never used: whatever
+//        follows a return (or an if-else returning on both sides), the branch of an if
+//        not taken when the condition compares two numbers, and assignments to variables
+//        no other statement of the function reads. A scanned variable counts as read,
+//        scan still has to consume the input
+class dce_t {
+public:
+    size_t run(prog_tree_t* tree);
+    void dtor();
+private:
+    bool prune_list(node_t** list);
+    bool fold_branch(node_t** link);
+    void remove_stores(node_t* body);
+    void count_reads(node_t* list);
+    void count_expr_reads(node_t* expr, node_t* target);
+    void drop_stores(node_t** list);
+    void unlink(node_t** link);
+    size_t count_stmts(node_t* list);
+
+    prog_tree_t* tree_{nullptr};
+    size_t removed_{0};
+
+    size_t* reads_{nullptr};
+    size_t reads_size_{0};
+    bool is_alloc_err_{false};
+};
+
+#endif /* DCE_H */
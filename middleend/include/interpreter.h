@@ -0,0 +1,48 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "prog_tree.h"
+
+const size_t INTERPRETER_MAX_DEPTH = 4096;
+const size_t FRAMES_MIN_CAPACITY   = 1024;
+
+typedef enum {
+    EXEC_NEXT   = 0,
+    EXEC_RETURN = 1,
+    EXEC_ERROR  = 2,
+} exec_t;
+
+// NOTE - runs the program straight from the tree without changing it; every call gets
+//        a frame of var_nametable_size() slots addressed by the nametable index,
+//        like [hx+N] in the asm backend
+class interpreter_t {
+public:
+    err_t init(prog_tree_t* tree, FILE* istream, FILE* ostream);
+    err_t run();
+    void dtor();
+private:
+    exec_t call(node_t* decl, node_t* args);
+    exec_t exec_list(node_t* list);
+    exec_t exec_stmt(node_t* stmt);
+    exec_t exec_if(node_t* if_node, node_t* else_node);
+    bool eval(node_t* node, double* value);
+    bool eval_cond(node_t* cmp, bool* result);
+    bool push_frame();
+    double* slot(node_t* var);
+    node_t* next_item(node_t** list);
+
+    prog_tree_t* tree_{nullptr};
+    FILE* istream_{nullptr};
+    FILE* ostream_{nullptr};
+
+    node_t** decls_{nullptr};
+    size_t names_amount_{0};
+
+    double* frames_{nullptr};
+    size_t frames_size_{0};
+    size_t frames_capacity_{0};
+    size_t frame_base_{0};
+    size_t depth_{0};
+};
+
+#endif /* INTERPRETER_H */
@@ -3,25 +3,32 @@
 
 #include "prog_tree.h"
 
+double calculate_op(double op_type, double val_l, double val_r);
+
 class middleend_t {
 public:
     void init(FILE* istream);
+    void init(prog_tree_t* tree);
+    void release(prog_tree_t* tree);
     void dtor();
 
     void set_dump_ostream(FILE* ostream);
     void dump();
 
-    node_t* optimize(node_t* node);
-    bool calculations_optimization_r(node_t* node);
-    node_t* basic_operations_optimization_r(node_t* node, rel_t rel, bool* flag);
-    node_t* null_val__optimization(node_t* node, rel_t rel, rel_t parent_rel, bool* flag);
-    node_t* one_val_optimization(node_t* node, rel_t rel, rel_t parent_rel, bool* flag);
+    size_t optimize_tree();
+    node_t* optimize(node_t* node, size_t* rewrites);
+    node_t* fold_node(node_t* node, size_t* rewrites);
+    node_t* fold_unary(node_t* node, size_t* rewrites);
+    node_t* null_val__optimization(node_t* node, rel_t rel, size_t* rewrites);
+    node_t* one_val_optimization(node_t* node, rel_t rel, size_t* rewrites);
 
-    void deserialization(FILE* ostream);
-    double calculate_expression(node_t* node);
-    void calculate_expression_r(node_t* node);
+    bool deserialization(FILE* ostream);
+    bool deserialization_bin(FILE* ostream);
     double calculate_value(double op_type, node_t* node_l,  node_t* node_r);
 private:
+    bool is_arithmetic(double op);
+    node_t* replace_by_child(node_t* node, rel_t keep);
+
     prog_tree_t prog_tree_;
 };
 
@@ -0,0 +1,568 @@
+#include <assert.h>
+#include <string.h>
+#include "cse.h"
+#include "prog_tree.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+static size_t hash_expr(type_t type, double value, size_t left, size_t right);
+static size_t hash_node(const node_t* node);
+static bool is_pure_op(double op);
+static bool is_list(const node_t* node, int op);
+
+size_t cse_t::run(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    tree_ = tree;
+    eliminated_ = 0;
+    is_alloc_err_ = false;
+
+    versions_size_ = tree->var_nametable_size();
+    versions_ = (size_t*) calloc(versions_size_ + 1, sizeof(size_t));
+    if (versions_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return 0;
+    }
+
+    for (node_t* decls = tree->root_; !is_alloc_err_ && is_list(decls, SEMICOLON); decls = decls->right) {
+        node_t* decl = decls->left;
+        if (decl != nullptr && decl->type == OP && (int) decl->value == DECL) {
+            run_list(decl->right);
+        }
+    }
+    return eliminated_;
+}
+
+void cse_t::dtor() {
+    free(exprs_);
+    exprs_ = nullptr;
+    exprs_size_ = 0;
+    exprs_capacity_ = 0;
+
+    free(nodes_);
+    nodes_ = nullptr;
+    nodes_size_ = 0;
+    nodes_capacity_ = 0;
+
+    free(values_);
+    values_ = nullptr;
+    values_size_ = 0;
+    values_capacity_ = 0;
+
+    free(versions_);
+    versions_ = nullptr;
+    versions_size_ = 0;
+
+    free(roots_);
+    roots_ = nullptr;
+    roots_capacity_ = 0;
+}
+
+// NOTE - a basic block is a run of statements up to an if or a return; the condition
+//        of an if is still read in the block, its bodies are blocks of their own.
+//        A block that failed to be numbered is left as it is and the pass stops
+void cse_t::run_list(node_t* list) {
+    begin_block();
+
+    node_t* first = list;
+    node_t* last  = nullptr;
+    node_t* node  = list;
+    while (is_list(node, SEMICOLON)) {
+        node_t* next = node->right;
+        node_t* stmt = node->left;
+        last = node;
+
+        if (stmt != nullptr) {
+            number_stmt(stmt);
+            if (is_alloc_err_) {
+                return;
+            }
+            if (is_block_end(stmt)) {
+                finish_block(first, node);
+                if (is_alloc_err_) {
+                    return;
+                }
+                run_bodies(stmt);
+                if (is_alloc_err_) {
+                    return;
+                }
+
+                begin_block();
+                first = next;
+                last  = nullptr;
+            }
+        }
+        node = next;
+    }
+
+    if (last != nullptr) {
+        finish_block(first, last);
+    }
+}
+
+void cse_t::begin_block() {
+    stamp_++;
+    exprs_size_  = 0;
+    nodes_size_  = 0;
+    values_size_ = 0;
+}
+
+// NOTE - both walks go over the statements in the same order, so the first occurrence
+//        seen by reuse_values() is the one count_evaluations() descended into. Definitions
+//        go before the statement, the statements after it are taken from the original links.
+//        Counts missed by a failed walk would reuse values evaluated once, nothing is rewritten then
+void cse_t::finish_block(node_t* first, node_t* last) {
+    for (node_t* node = first; !is_alloc_err_ && node != nullptr; node = node->right) {
+        size_t roots = collect_roots(node->left);
+        for (size_t i = 0; i < roots && !is_alloc_err_; i++) {
+            count_evaluations(roots_[i]);
+        }
+        if (node == last) break;
+    }
+
+    for (node_t* node = first; !is_alloc_err_ && node != nullptr;) {
+        node_t* next = node->right;
+        size_t roots = collect_roots(node->left);
+        for (size_t i = 0; i < roots && !is_alloc_err_; i++) {
+            reuse_values(roots_[i], node);
+        }
+        if (node == last) break;
+        node = next;
+    }
+}
+
+size_t cse_t::collect_roots(node_t* stmt) {
+    if (stmt == nullptr || stmt->type != OP) {
+        return 0;
+    }
+
+    size_t amount = 0;
+    for (node_t* args = stmt->left; (int) stmt->value == CALL && args != nullptr; amount++) {
+        args = is_list(args, SEMICOLON) ? args->right : nullptr;
+    }
+    if (amount + 2 > roots_capacity_) {
+        size_t capacity = (amount + 2 > CSE_MIN_CAPACITY) ? amount + 2 : CSE_MIN_CAPACITY;
+        node_t** roots = (node_t**) realloc(roots_, sizeof(node_t*) * capacity);
+        if (roots == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            is_alloc_err_ = true;
+            return 0;
+        }
+        roots_ = roots;
+        roots_capacity_ = capacity;
+    }
+
+    node_t* cmp = nullptr;
+    amount = 0;
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            if (stmt->left != nullptr) roots_[amount++] = stmt->left->right;
+            break;
+        case EQ:
+            roots_[amount++] = stmt->right;
+            break;
+        case OUT:
+            roots_[amount++] = stmt->left;
+            break;
+        case CALL: {
+            node_t* args = stmt->left;
+            while (args != nullptr) {
+                if (is_list(args, SEMICOLON)) {
+                    roots_[amount++] = args->left;
+                    args = args->right;
+                }
+                else {
+                    roots_[amount++] = args;
+                    args = nullptr;
+                }
+            }
+            break;
+        }
+        case IF:
+            cmp = stmt->left;
+            break;
+        case SEMICOLON:
+            cmp = (stmt->left != nullptr) ? stmt->left->left : nullptr;
+            break;
+        default:
+            break;
+    }
+
+    if (cmp != nullptr) {
+        roots_[amount++] = cmp->left;
+        roots_[amount++] = cmp->right;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < amount; i++) {
+        if (roots_[i] != nullptr) {
+            roots_[size++] = roots_[i];
+        }
+    }
+    return size;
+}
+
+// NOTE - reads are numbered before the write, var = var + 1 reads the old value
+void cse_t::number_stmt(node_t* stmt) {
+    size_t roots = collect_roots(stmt);
+    for (size_t i = 0; i < roots; i++) {
+        number_expr(roots_[i]);
+    }
+
+    node_t* var = nullptr;
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            var = (stmt->left != nullptr) ? stmt->left->left : nullptr;
+            break;
+        case EQ:
+        case IN:
+            var = stmt->left;
+            break;
+        default:
+            break;
+    }
+
+    if (var != nullptr && var->type == VAR && var->value >= 0 && (size_t) var->value < versions_size_) {
+        versions_[(size_t) var->value]++;
+    }
+}
+
+void cse_t::number_expr(node_t* expr) {
+    tree_walk_t walk = {};
+    walk.init(expr);
+
+    walk_step_t step = {};
+    while (!is_alloc_err_ && walk.next(&step)) {
+        if (step.event != WALK_LEAVE) {
+            continue;
+        }
+
+        node_t* node = step.node;
+        size_t id = CSE_NO_ID;
+        if (node->type == NUM) {
+            id = expr_id(NUM, node->value, CSE_NO_ID, CSE_NO_ID);
+        }
+        else if (node->type == VAR) {
+            size_t var = (size_t) node->value;
+            id = expr_id(VAR, node->value, (var < versions_size_) ? versions_[var] : 0, CSE_NO_ID);
+        }
+        else if (node->type == OP && is_pure_op(node->value)) {
+            size_t left  = (node->left  != nullptr) ? node_id(node->left)  : CSE_NO_ID;
+            size_t right = (node->right != nullptr) ? node_id(node->right) : CSE_NO_ID;
+            int op = (int) node->value;
+            if ((op == ADD || op == MUL) && right != CSE_NO_ID && left > right) {
+                size_t tmp = left;
+                left  = right;
+                right = tmp;
+            }
+            id = expr_id(OP, node->value, left, right);
+        }
+        else {
+            id = new_id(false);
+        }
+        if (id == CSE_NO_ID) {
+            break;
+        }
+        set_node_id(node, id);
+    }
+    if (walk.is_alloc_err()) {
+        is_alloc_err_ = true;
+    }
+    walk.dtor();
+}
+
+// NOTE - a repeated expression is evaluated only at its first occurrence, what is
+//        inside the other occurrences is not evaluated at all
+void cse_t::count_evaluations(node_t* expr) {
+    tree_walk_t walk = {};
+    walk.init(expr);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event != WALK_ENTER) {
+            continue;
+        }
+
+        cse_value_t* value = &values_[node_id(step.node)];
+        if (value->is_pure && ++value->evaluations > 1) {
+            walk.skip_children();
+        }
+    }
+    if (walk.is_alloc_err()) {
+        is_alloc_err_ = true;
+    }
+    walk.dtor();
+}
+
+// NOTE - the first occurrence is extracted after its children, so the definitions
+//        of the values it reuses are placed before its own
+void cse_t::reuse_values(node_t* expr, node_t* list_node) {
+    tree_walk_t walk = {};
+    walk.init(expr);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        node_t* node = step.node;
+        size_t id = node_id(node);
+        cse_value_t* value = &values_[id];
+        if (!value->is_pure || value->evaluations < 2) {
+            continue;
+        }
+
+        if (step.event == WALK_ENTER && value->temp >= 0) {
+            tree_->delete_subtree(node->left);
+            tree_->delete_subtree(node->right);
+            node->left  = nullptr;
+            node->right = nullptr;
+            node->type  = VAR;
+            node->value = value->temp;
+            walk.skip_children();
+            eliminated_++;
+        }
+        else if (step.event == WALK_LEAVE && value->temp < 0) {
+            extract(node, id, list_node);
+        }
+    }
+    if (walk.is_alloc_err()) {
+        is_alloc_err_ = true;
+    }
+    walk.dtor();
+}
+
+// NOTE - var tmp = expr; goes before the statement, the node itself reads tmp
+void cse_t::extract(node_t* node, size_t id, node_t* list_node) {
+    double temp = tree_->add_temp_name(CSE_TEMP_PREFIX);
+    if (temp < 0) {
+        values_[id].evaluations = 0;
+        return;
+    }
+
+    node_t* expr = tree_->new_node(node->type, node->value);
+    node_t* var  = tree_->new_node(VAR, temp);
+    node_t* eq   = tree_->new_node(OP, EQ);
+    node_t* def  = tree_->new_node(OP, DEF_VAR);
+    node_t* link = tree_->new_node(OP, SEMICOLON);
+    if (expr == nullptr || var == nullptr || eq == nullptr || def == nullptr || link == nullptr) {
+        values_[id].evaluations = 0;
+        return;
+    }
+
+    expr->left  = node->left;
+    expr->right = node->right;
+    if (expr->left  != nullptr) expr->left->parent  = expr;
+    if (expr->right != nullptr) expr->right->parent = expr;
+
+    node->left  = nullptr;
+    node->right = nullptr;
+    node->type  = VAR;
+    node->value = temp;
+
+    eq->left   = var;
+    eq->right  = expr;
+    var->parent  = eq;
+    expr->parent = eq;
+    def->left  = eq;
+    eq->parent = def;
+
+    link->left   = def;
+    link->right  = list_node;
+    def->parent  = link;
+    link->parent = list_node->parent;
+    if (link->parent != nullptr) {
+        if (link->parent->left == list_node) {
+            link->parent->left = link;
+        }
+        else {
+            link->parent->right = link;
+        }
+    }
+    list_node->parent = link;
+
+    values_[id].temp = temp;
+}
+
+bool cse_t::is_block_end(node_t* stmt) {
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+        case EQ:
+        case IN:
+        case OUT:
+        case CALL:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void cse_t::run_bodies(node_t* stmt) {
+    if ((int) stmt->value == IF) {
+        run_list(stmt->right);
+    }
+    else if ((int) stmt->value == SEMICOLON) {
+        if (stmt->left != nullptr) run_list(stmt->left->right);
+        if (stmt->right != nullptr) run_list(stmt->right->left);
+    }
+}
+
+size_t cse_t::expr_id(type_t type, double value, size_t left, size_t right) {
+    if (2 * (exprs_size_ + 1) > exprs_capacity_ && !grow_exprs()) {
+        return CSE_NO_ID;
+    }
+
+    size_t mask = exprs_capacity_ - 1;
+    size_t i = hash_expr(type, value, left, right) & mask;
+    while (exprs_[i].stamp == stamp_) {
+        cse_expr_slot_t* slot = &exprs_[i];
+        if (slot->type == type && slot->left == left && slot->right == right &&
+            memcmp(&slot->value, &value, sizeof(double)) == 0) {
+            return slot->id;
+        }
+        i = (i + 1) & mask;
+    }
+
+    size_t id = new_id(type == OP);
+    if (id == CSE_NO_ID) {
+        return CSE_NO_ID;
+    }
+
+    cse_expr_slot_t* slot = &exprs_[i];
+    slot->stamp = stamp_;
+    slot->type  = type;
+    slot->value = value;
+    slot->left  = left;
+    slot->right = right;
+    slot->id    = id;
+    exprs_size_++;
+    return id;
+}
+
+void cse_t::set_node_id(node_t* node, size_t id) {
+    if (2 * (nodes_size_ + 1) > nodes_capacity_ && !grow_nodes()) {
+        return;
+    }
+
+    size_t mask = nodes_capacity_ - 1;
+    size_t i = hash_node(node) & mask;
+    while (nodes_[i].stamp == stamp_ && nodes_[i].node != node) {
+        i = (i + 1) & mask;
+    }
+    if (nodes_[i].stamp != stamp_) {
+        nodes_size_++;
+    }
+    nodes_[i].stamp = stamp_;
+    nodes_[i].node  = node;
+    nodes_[i].id    = id;
+}
+
+size_t cse_t::node_id(node_t* node) {
+    size_t mask = nodes_capacity_ - 1;
+    for (size_t i = hash_node(node) & mask; nodes_[i].stamp == stamp_; i = (i + 1) & mask) {
+        if (nodes_[i].node == node) {
+            return nodes_[i].id;
+        }
+    }
+
+    assert(0 && "Node was not numbered");
+    return CSE_NO_ID;
+}
+
+size_t cse_t::new_id(bool is_pure) {
+    if (values_size_ == values_capacity_) {
+        size_t capacity = (values_capacity_ == 0) ? CSE_MIN_CAPACITY : values_capacity_ * 2;
+        cse_value_t* values = (cse_value_t*) realloc(values_, sizeof(cse_value_t) * capacity);
+        if (values == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            is_alloc_err_ = true;
+            return CSE_NO_ID;
+        }
+        values_ = values;
+        values_capacity_ = capacity;
+    }
+
+    cse_value_t* value = &values_[values_size_];
+    value->is_pure     = is_pure;
+    value->evaluations = 0;
+    value->temp        = -1;
+    return values_size_++;
+}
+
+// NOTE - only the slots of the current block are moved, the rest are free anyway
+bool cse_t::grow_exprs() {
+    size_t capacity = (exprs_capacity_ == 0) ? CSE_MIN_CAPACITY : exprs_capacity_ * 2;
+    cse_expr_slot_t* exprs = (cse_expr_slot_t*) calloc(capacity, sizeof(cse_expr_slot_t));
+    if (exprs == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        is_alloc_err_ = true;
+        return false;
+    }
+
+    for (size_t i = 0; i < exprs_capacity_; i++) {
+        cse_expr_slot_t* slot = &exprs_[i];
+        if (slot->stamp != stamp_) {
+            continue;
+        }
+
+        size_t j = hash_expr(slot->type, slot->value, slot->left, slot->right) & (capacity - 1);
+        while (exprs[j].stamp == stamp_) {
+            j = (j + 1) & (capacity - 1);
+        }
+        exprs[j] = *slot;
+    }
+
+    free(exprs_);
+    exprs_ = exprs;
+    exprs_capacity_ = capacity;
+    return true;
+}
+
+bool cse_t::grow_nodes() {
+    size_t capacity = (nodes_capacity_ == 0) ? CSE_MIN_CAPACITY : nodes_capacity_ * 2;
+    cse_node_slot_t* nodes = (cse_node_slot_t*) calloc(capacity, sizeof(cse_node_slot_t));
+    if (nodes == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        is_alloc_err_ = true;
+        return false;
+    }
+
+    for (size_t i = 0; i < nodes_capacity_; i++) {
+        if (nodes_[i].stamp != stamp_) {
+            continue;
+        }
+
+        size_t j = hash_node(nodes_[i].node) & (capacity - 1);
+        while (nodes[j].stamp == stamp_) {
+            j = (j + 1) & (capacity - 1);
+        }
+        nodes[j] = nodes_[i];
+    }
+
+    free(nodes_);
+    nodes_ = nodes;
+    nodes_capacity_ = capacity;
+    return true;
+}
+
+static size_t hash_expr(type_t type, double value, size_t left, size_t right) {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint64_t parts[] = {(uint64_t) type, bits, (uint64_t) left, (uint64_t) right};
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        hash = (hash ^ parts[i]) * FNV_PRIME;
+    }
+    return (size_t) (hash ^ (hash >> 29));
+}
+
+static size_t hash_node(const node_t* node) {
+    uint64_t hash = (uint64_t) (uintptr_t) node * CSE_PTR_HASH_MUL;
+    return (size_t) (hash >> 20);
+}
+
+static bool is_pure_op(double op) {
+    return (int) op >= ADD && (int) op < EQ;
+}
+
+static bool is_list(const node_t* node, int op) {
+    return node != nullptr && node->type == OP && (int) node->value == op;
+}
@@ -0,0 +1,284 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "dce.h"
+#include "prog_tree.h"
+#include "tree_walk.h"
+#include "logger.h"
+
+const double DCE_EPSILON = 1e-12;
+
+static bool is_op(const node_t* node, int op);
+static bool compare(int op, double val_l, double val_r, bool* result);
+
+size_t dce_t::run(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    tree_ = tree;
+    removed_ = 0;
+    is_alloc_err_ = false;
+
+    reads_size_ = tree->var_nametable_size();
+    reads_ = (size_t*) calloc(reads_size_ + 1, sizeof(size_t));
+    if (reads_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return 0;
+    }
+
+    for (node_t* decls = tree->root_; !is_alloc_err_ && is_op(decls, SEMICOLON); decls = decls->right) {
+        node_t* decl = decls->left;
+        if (is_op(decl, DECL)) {
+            prune_list(&decl->right);
+            remove_stores(decl);
+        }
+    }
+    return removed_;
+}
+
+void dce_t::dtor() {
+    free(reads_);
+    reads_ = nullptr;
+    reads_size_ = 0;
+}
+
+// NOTE - returns true if the list returns on every path, then nothing after it runs
+bool dce_t::prune_list(node_t** list) {
+    node_t** link = list;
+    while (is_op(*link, SEMICOLON)) {
+        if (fold_branch(link)) {
+            continue;
+        }
+
+        node_t* node = *link;
+        node_t* stmt = node->left;
+        bool returns = false;
+        if (is_op(stmt, RETURN)) {
+            returns = true;
+        }
+        else if (is_op(stmt, IF)) {
+            prune_list(&stmt->right);
+        }
+        else if (is_op(stmt, SEMICOLON) && stmt->left != nullptr && stmt->right != nullptr) {
+            bool if_returns   = prune_list(&stmt->left->right);
+            bool else_returns = prune_list(&stmt->right->left);
+            returns = if_returns && else_returns;
+        }
+
+        if (returns) {
+            if (node->right != nullptr) {
+                removed_ += count_stmts(node->right);
+                tree_->delete_subtree(node->right);
+                node->right = nullptr;
+            }
+            return true;
+        }
+        link = &node->right;
+    }
+    return false;
+}
+
+// NOTE - an if comparing two numbers is replaced by the statements of the branch taken
+bool dce_t::fold_branch(node_t** link) {
+    node_t* node = *link;
+    node_t* stmt = node->left;
+
+    node_t* if_node   = nullptr;
+    node_t* else_node = nullptr;
+    if (is_op(stmt, IF)) {
+        if_node = stmt;
+    }
+    else if (is_op(stmt, SEMICOLON) && is_op(stmt->left, IF) && is_op(stmt->right, ELSE)) {
+        if_node   = stmt->left;
+        else_node = stmt->right;
+    }
+    else {
+        return false;
+    }
+
+    node_t* cmp = if_node->left;
+    bool result = false;
+    if (cmp == nullptr || cmp->left == nullptr || cmp->right == nullptr ||
+        cmp->left->type != NUM || cmp->right->type != NUM ||
+        !compare((int) cmp->value, cmp->left->value, cmp->right->value, &result)) {
+        return false;
+    }
+
+    node_t* taken = nullptr;
+    node_t* other = nullptr;
+    if (result) {
+        taken = if_node->right;
+        if_node->right = nullptr;
+        other = (else_node != nullptr) ? else_node->left : nullptr;
+    }
+    else if (else_node != nullptr) {
+        taken = else_node->left;
+        else_node->left = nullptr;
+        other = if_node->right;
+    }
+    else {
+        other = if_node->right;
+    }
+    removed_ += 1 + count_stmts(other);
+
+    node_t* owner = node->parent;
+    node_t* rest  = node->right;
+    if (is_op(taken, SEMICOLON)) {
+        node_t* last = taken;
+        while (is_op(last->right, SEMICOLON)) {
+            last = last->right;
+        }
+        last->right = rest;
+        if (rest != nullptr) rest->parent = last;
+
+        *link = taken;
+        taken->parent = owner;
+    }
+    else {
+        *link = rest;
+        if (rest != nullptr) rest->parent = owner;
+    }
+
+    node->right = nullptr;
+    tree_->delete_subtree(node);
+    return true;
+}
+
+// NOTE - dropping a store may leave the variables it read unread, so it goes on
+//        until nothing changes. Reads missed by a failed walk would drop live stores
+void dce_t::remove_stores(node_t* decl) {
+    size_t removed = 0;
+    do {
+        removed = removed_;
+        memset(reads_, 0, sizeof(size_t) * reads_size_);
+        count_reads(decl->right);
+        if (is_alloc_err_) {
+            return;
+        }
+        drop_stores(&decl->right);
+    } while (removed != removed_);
+}
+
+void dce_t::count_reads(node_t* list) {
+    for (; is_op(list, SEMICOLON); list = list->right) {
+        node_t* stmt = list->left;
+        if (stmt == nullptr || stmt->type != OP) {
+            continue;
+        }
+
+        switch ((int) stmt->value) {
+            case DEF_VAR:
+                if (stmt->left != nullptr) count_expr_reads(stmt->left->right, stmt->left->left);
+                break;
+            case EQ:
+                count_expr_reads(stmt->right, stmt->left);
+                break;
+            case IN:
+            case OUT:
+            case CALL:
+                count_expr_reads(stmt->left, nullptr);
+                break;
+            case IF:
+                count_expr_reads(stmt->left, nullptr);
+                count_reads(stmt->right);
+                break;
+            case SEMICOLON:
+                if (stmt->left != nullptr) {
+                    count_expr_reads(stmt->left->left, nullptr);
+                    count_reads(stmt->left->right);
+                }
+                if (stmt->right != nullptr) count_reads(stmt->right->left);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// NOTE - q = q + 1 does not keep q alive by itself, reads of the variable being
+//        assigned are skipped
+void dce_t::count_expr_reads(node_t* expr, node_t* target) {
+    tree_walk_t walk = {};
+    walk.init(expr);
+
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        node_t* node = step.node;
+        if (step.event == WALK_ENTER && node->type == VAR && node->value >= 0 && (size_t) node->value < reads_size_ &&
+            (target == nullptr || (size_t) target->value != (size_t) node->value)) {
+            reads_[(size_t) node->value]++;
+        }
+    }
+    if (walk.is_alloc_err()) {
+        is_alloc_err_ = true;
+    }
+    walk.dtor();
+}
+
+// NOTE - right hand sides have no side effects, calls are statements of their own
+void dce_t::drop_stores(node_t** list) {
+    node_t** link = list;
+    while (is_op(*link, SEMICOLON)) {
+        node_t* stmt = (*link)->left;
+
+        node_t* var = nullptr;
+        if (is_op(stmt, DEF_VAR) && stmt->left != nullptr) {
+            var = stmt->left->left;
+        }
+        else if (is_op(stmt, EQ)) {
+            var = stmt->left;
+        }
+
+        if (var != nullptr && var->type == VAR && var->value >= 0 && (size_t) var->value < reads_size_ &&
+            reads_[(size_t) var->value] == 0) {
+            unlink(link);
+            removed_++;
+            continue;
+        }
+
+        if (is_op(stmt, IF)) {
+            drop_stores(&stmt->right);
+        }
+        else if (is_op(stmt, SEMICOLON) && stmt->left != nullptr && stmt->right != nullptr) {
+            drop_stores(&stmt->left->right);
+            drop_stores(&stmt->right->left);
+        }
+        link = &(*link)->right;
+    }
+}
+
+void dce_t::unlink(node_t** link) {
+    node_t* node = *link;
+    node_t* rest = node->right;
+
+    *link = rest;
+    if (rest != nullptr) rest->parent = node->parent;
+
+    node->right = nullptr;
+    tree_->delete_subtree(node);
+}
+
+size_t dce_t::count_stmts(node_t* list) {
+    size_t amount = 0;
+    for (; is_op(list, SEMICOLON); list = list->right) {
+        if (list->left != nullptr) amount++;
+    }
+    return amount;
+}
+
+static bool is_op(const node_t* node, int op) {
+    return node != nullptr && node->type == OP && (int) node->value == op;
+}
+
+// NOTE - same rules as the interpreter, numbers closer than DCE_EPSILON are equal
+static bool compare(int op, double val_l, double val_r, bool* result) {
+    bool equal = fabs(val_l - val_r) < DCE_EPSILON;
+    switch (op) {
+        case IE:   *result = equal;                   return true;
+        case INE:  *result = !equal;                  return true;
+        case IA:   *result = !equal && val_l > val_r; return true;
+        case IAEQ: *result = equal || val_l > val_r;  return true;
+        case IB:   *result = !equal && val_l < val_r; return true;
+        case IBEQ: *result = equal || val_l < val_r;  return true;
+        default:   return false;
+    }
+}
@@ -0,0 +1,351 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "interpreter.h"
+#include "middleend.h"
+#include "logger.h"
+
+const double CMP_EPSILON = 1e-12;
+
+err_t interpreter_t::init(prog_tree_t* tree, FILE* istream, FILE* ostream) {
+    assert(tree != nullptr);
+    assert(istream != nullptr);
+    assert(ostream != nullptr);
+
+    tree_    = tree;
+    istream_ = istream;
+    ostream_ = ostream;
+
+    names_amount_ = tree->var_nametable_size();
+    decls_ = (node_t**) calloc(names_amount_ + 1, sizeof(node_t*));
+    if (decls_ == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return MEM_ALLOC_ERR;
+    }
+
+    for (node_t* list = tree->root_; list != nullptr; list = list->right) {
+        node_t* decl = list->left;
+        if (decl == nullptr || decl->type != OP || (int) decl->value != DECL ||
+            decl->left == nullptr || decl->left->left == nullptr || decl->left->left->type != FUNC) {
+            LOG(ERROR, "Syntax err at %p: expected a function declaration\n", decl);
+            return SYNTAX_ERR;
+        }
+        decls_[(size_t) decl->left->left->value] = decl;
+    }
+    return NO_ERR;
+}
+
+err_t interpreter_t::run() {
+    node_t* main_decl = nullptr;
+    for (size_t i = 0; i < names_amount_; i++) {
+        if (decls_[i] != nullptr && strcmp(tree_->var_nametable_[i].name, "main") == 0) {
+            main_decl = decls_[i];
+            break;
+        }
+    }
+
+    if (main_decl == nullptr) {
+        LOG(ERROR, "Function main was not declared\n");
+        return SYNTAX_ERR;
+    }
+    return (call(main_decl, nullptr) == EXEC_ERROR) ? SYNTAX_ERR : NO_ERR;
+}
+
+void interpreter_t::dtor() {
+    free(decls_);
+    decls_ = nullptr;
+    names_amount_ = 0;
+
+    free(frames_);
+    frames_ = nullptr;
+    frames_size_ = 0;
+    frames_capacity_ = 0;
+    frame_base_ = 0;
+    depth_ = 0;
+}
+
+// NOTE - argument and parameter lists end either with nullptr or with a bare last item
+node_t* interpreter_t::next_item(node_t** list) {
+    node_t* node = *list;
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    if (node->type == OP && (int) node->value == SEMICOLON) {
+        *list = node->right;
+        return node->left;
+    }
+    *list = nullptr;
+    return node;
+}
+
+bool interpreter_t::push_frame() {
+    if (frames_size_ + names_amount_ > frames_capacity_) {
+        size_t capacity = (frames_capacity_ == 0) ? FRAMES_MIN_CAPACITY : frames_capacity_ * 2;
+        while (capacity < frames_size_ + names_amount_) {
+            capacity *= 2;
+        }
+
+        double* frames = (double*) realloc(frames_, sizeof(double) * capacity);
+        if (frames == nullptr) {
+            LOG(ERROR, "Memory allocation error\n");
+            return false;
+        }
+        frames_ = frames;
+        frames_capacity_ = capacity;
+    }
+
+    frame_base_ = frames_size_;
+    for (size_t i = 0; i < names_amount_; i++) {
+        frames_[frames_size_++] = 0;
+    }
+    return true;
+}
+
+double* interpreter_t::slot(node_t* var) {
+    if (var == nullptr || var->type != VAR || var->value < 0 || (size_t) var->value >= names_amount_) {
+        LOG(ERROR, "Expected a variable at %p\n", var);
+        return nullptr;
+    }
+    return &frames_[frame_base_ + (size_t) var->value];
+}
+
+exec_t interpreter_t::call(node_t* decl, node_t* args) {
+    assert(decl != nullptr);
+
+    if (depth_ == INTERPRETER_MAX_DEPTH) {
+        LOG(ERROR, "Call depth exceeded %zu\n", INTERPRETER_MAX_DEPTH);
+        return EXEC_ERROR;
+    }
+
+    size_t args_amount = 0;
+    for (node_t* list = args; next_item(&list) != nullptr;) {
+        args_amount++;
+    }
+
+    // NOTE - arguments are evaluated in the caller's frame and then copied to the callee's one
+    double* values = (double*) calloc(args_amount + 1, sizeof(double));
+    if (values == nullptr) {
+        LOG(ERROR, "Memory allocation error\n");
+        return EXEC_ERROR;
+    }
+
+    size_t i = 0;
+    for (node_t* list = args, *arg = nullptr; (arg = next_item(&list)) != nullptr; i++) {
+        if (!eval(arg, &values[i])) {
+            free(values);
+            return EXEC_ERROR;
+        }
+    }
+
+    size_t caller_base = frame_base_;
+    size_t caller_size = frames_size_;
+    if (!push_frame()) {
+        free(values);
+        return EXEC_ERROR;
+    }
+
+    exec_t status = EXEC_NEXT;
+    i = 0;
+    for (node_t* list = decl->left->right, *param = nullptr; (param = next_item(&list)) != nullptr; i++) {
+        double* var = slot(param);
+        if (var == nullptr || i == args_amount) {
+            status = EXEC_ERROR;
+            break;
+        }
+        *var = values[i];
+    }
+    free(values);
+
+    if (status != EXEC_ERROR && i != args_amount) {
+        LOG(ERROR, "Function %s takes %zu arguments, %zu given\n",
+                   tree_->var_nametable_[(size_t) decl->left->left->value].name, i, args_amount);
+        status = EXEC_ERROR;
+    }
+
+    if (status != EXEC_ERROR) {
+        depth_++;
+        status = exec_list(decl->right);
+        depth_--;
+    }
+
+    frame_base_  = caller_base;
+    frames_size_ = caller_size;
+    return (status == EXEC_ERROR) ? EXEC_ERROR : EXEC_NEXT;
+}
+
+exec_t interpreter_t::exec_list(node_t* list) {
+    while (list != nullptr && list->type == OP && (int) list->value == SEMICOLON) {
+        exec_t status = exec_stmt(list->left);
+        if (status != EXEC_NEXT) {
+            return status;
+        }
+        list = list->right;
+    }
+    return EXEC_NEXT;
+}
+
+exec_t interpreter_t::exec_stmt(node_t* stmt) {
+    if (stmt == nullptr) {
+        return EXEC_NEXT;
+    }
+
+    if (stmt->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a statement\n", stmt);
+        return EXEC_ERROR;
+    }
+
+    switch ((int) stmt->value) {
+        case DEF_VAR:
+            return exec_stmt(stmt->left);
+        case EQ: {
+            double* var = slot(stmt->left);
+            if (var == nullptr || !eval(stmt->right, var)) {
+                return EXEC_ERROR;
+            }
+            return EXEC_NEXT;
+        }
+        case CALL: {
+            node_t* name = stmt->right;
+            if (name == nullptr || name->value < 0 || (size_t) name->value >= names_amount_ ||
+                decls_[(size_t) name->value] == nullptr) {
+                LOG(ERROR, "Call of an undeclared function at %p\n", stmt);
+                return EXEC_ERROR;
+            }
+            return call(decls_[(size_t) name->value], stmt->left);
+        }
+        case RETURN:
+            return EXEC_RETURN;
+        case IF:
+            return exec_if(stmt, nullptr);
+        case SEMICOLON:
+            return exec_if(stmt->left, stmt->right);
+        case IN: {
+            double* var = slot(stmt->left);
+            if (var == nullptr) {
+                return EXEC_ERROR;
+            }
+            if (fscanf(istream_, "%lf", var) != 1) {
+                LOG(ERROR, "Failed to scan %s\n", tree_->var_nametable_[(size_t) stmt->left->value].name);
+                return EXEC_ERROR;
+            }
+            return EXEC_NEXT;
+        }
+        case OUT: {
+            double value = 0;
+            if (!eval(stmt->left, &value)) {
+                return EXEC_ERROR;
+            }
+            fprintf(ostream_, "%lg\n", value);
+            return EXEC_NEXT;
+        }
+        default:
+            LOG(ERROR, "Unsupported statement %s at %p\n", op_to_name((int) stmt->value), stmt);
+            return EXEC_ERROR;
+    }
+}
+
+exec_t interpreter_t::exec_if(node_t* if_node, node_t* else_node) {
+    if (if_node == nullptr || if_node->type != OP || (int) if_node->value != IF) {
+        LOG(ERROR, "Syntax err at %p: expected if\n", if_node);
+        return EXEC_ERROR;
+    }
+    if (else_node != nullptr && (else_node->type != OP || (int) else_node->value != ELSE)) {
+        LOG(ERROR, "Syntax err at %p: expected else\n", else_node);
+        return EXEC_ERROR;
+    }
+
+    bool result = false;
+    if (!eval_cond(if_node->left, &result)) {
+        return EXEC_ERROR;
+    }
+
+    if (result) {
+        return exec_list(if_node->right);
+    }
+    return (else_node != nullptr) ? exec_list(else_node->left) : EXEC_NEXT;
+}
+
+bool interpreter_t::eval_cond(node_t* cmp, bool* result) {
+    assert(result != nullptr);
+
+    if (cmp == nullptr || cmp->type != OP) {
+        LOG(ERROR, "Syntax err at %p: expected a comparison\n", cmp);
+        return false;
+    }
+
+    double val_l = 0;
+    double val_r = 0;
+    if (!eval(cmp->left, &val_l) || !eval(cmp->right, &val_r)) {
+        return false;
+    }
+
+    bool equal = fabs(val_l - val_r) < CMP_EPSILON;
+    switch ((int) cmp->value) {
+        case IE:   *result = equal;                   break;
+        case INE:  *result = !equal;                  break;
+        case IA:   *result = !equal && val_l > val_r; break;
+        case IAEQ: *result = equal || val_l > val_r;  break;
+        case IB:   *result = !equal && val_l < val_r; break;
+        case IBEQ: *result = equal || val_l < val_r;  break;
+        default:
+            LOG(ERROR, "Unknown comparison %s\n", op_to_name((int) cmp->value));
+            return false;
+    }
+    return true;
+}
+
+bool interpreter_t::eval(node_t* node, double* value) {
+    assert(value != nullptr);
+
+    if (node == nullptr) {
+        LOG(ERROR, "Missing operand\n");
+        return false;
+    }
+
+    switch (node->type) {
+        case NUM:
+            *value = node->value;
+            return true;
+        case VAR: {
+            double* var = slot(node);
+            if (var == nullptr) {
+                return false;
+            }
+            *value = *var;
+            return true;
+        }
+        case OP:
+            break;
+        case FUNC:
+        default:
+            LOG(ERROR, "Unexpected node %d in an expression\n", node->type);
+            return false;
+    }
+
+    double val_l = 0;
+    if (!eval(node->left, &val_l)) {
+        return false;
+    }
+
+    if (node->right == nullptr) {
+        switch ((int) node->value) {
+            case SUB:
+                *value = -val_l;
+                return true;
+            case ADD:
+                *value = val_l;
+                return true;
+            default:
+                *value = calculate_op(node->value, NAN, val_l);
+                return true;
+        }
+    }
+
+    double val_r = 0;
+    if (!eval(node->right, &val_r)) {
+        return false;
+    }
+    *value = calculate_op(node->value, val_l, val_r);
+    return true;
+}
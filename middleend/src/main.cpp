@@ -15,13 +15,13 @@ int main() {
     LoggerSetFile(logger);
     LoggerSetLevel(INFO);
 
-    FILE* istream = fopen("out.txt", "r");
+    FILE* istream = fopen("out.ast", "rb");
     if (istream == nullptr) {
         LOG(ERROR, "Failed to open an input data file\n");
         return 1;
     }
 
-    FILE* dump_file = fopen("m_out.txt", "w");
+    FILE* dump_file = fopen("m_out.ast", "wb");
     if (istream == nullptr) {
         LOG(ERROR, "Failed to open an input data file\n");
         return 1;
@@ -38,7 +38,7 @@ int main() {
     prog.set_dump_ostream(dump);
     prog.init(istream);
     prog.dump();
-    prog.deserialization(dump_file);
+    prog.deserialization_bin(dump_file);
     prog.dtor();
 
     if (fclose(istream) == EOF) {
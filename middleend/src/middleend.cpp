@@ -1,15 +1,38 @@
 #include <assert.h>
 #include <math.h>
 #include "middleend.h"
+#include "cse.h"
+#include "dce.h"
 #include "prog_tree.h"
+#include "tree_walk.h"
 #include "logger.h"
 
+// NOTE - the identities hold for exact values only, x * 1e-13 is not 0. Written
+//        without == to keep -Wfloat-equal quiet
+static bool is_exactly(double val, double exact) {
+    return !(val < exact) && !(val > exact);
+}
+
 void middleend_t::init(FILE* istream) {
     assert(istream != nullptr);
 
     prog_tree_.serialization(istream);
 }
 
+void middleend_t::init(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    prog_tree_ = *tree;
+    *tree = prog_tree_t();
+}
+
+void middleend_t::release(prog_tree_t* tree) {
+    assert(tree != nullptr);
+
+    *tree = prog_tree_;
+    prog_tree_ = prog_tree_t();
+}
+
 void middleend_t::dtor() {
     prog_tree_.tree_dtor();
 }
@@ -22,114 +45,162 @@ void middleend_t::dump() {
     prog_tree_.dump(prog_tree_.root_);
 }
 
+size_t middleend_t::optimize_tree() {
+    size_t rewrites = 0;
+    prog_tree_.root_ = optimize(prog_tree_.root_, &rewrites);
 
-node_t* middleend_t::optimize(node_t* node) {
-    if (node == nullptr) {
-        return nullptr;
-    }
+    LOG(INFO, "Optimizer made %zu rewrites\n", rewrites);
 
-    bool change_flag = true;
-    bool basic_op_flag = false;
+    dce_t dce = {};
+    size_t removed = dce.run(&prog_tree_);
+    dce.dtor();
+    LOG(INFO, "Dead code elimination removed %zu statements\n", removed);
 
-    while (change_flag == true) {
-        change_flag = false;
-        basic_op_flag = false;
-        change_flag |= calculations_optimization_r(node);
-        node = basic_operations_optimization_r(node, ROOT, &basic_op_flag);
-        change_flag |= basic_op_flag;
-    }
-    return node;
+    cse_t cse = {};
+    size_t reused = cse.run(&prog_tree_);
+    cse.dtor();
+    LOG(INFO, "Common subexpressions reused %zu times\n", reused);
+
+    return rewrites + removed + reused;
 }
 
-bool middleend_t::calculations_optimization_r(node_t* node) {
-    if (node == nullptr) {
-        return false;
-    }
+// NOTE - children are folded before their parent, so a rewrite is seen by the parent
+//        on its own visit and one postorder pass reaches the fixed point
+node_t* middleend_t::optimize(node_t* node, size_t* rewrites) {
+    assert(rewrites != nullptr);
 
-    bool change_flag = false;
+    tree_walk_t walk = {};
+    walk.init(node);
 
-    if (node->left != nullptr) {
-        change_flag |= calculations_optimization_r(node->left);
-    }
+    walk_step_t step = {};
+    while (walk.next(&step)) {
+        if (step.event != WALK_LEAVE) {
+            continue;
+        }
 
-    if (node->right != nullptr) {
-        change_flag |= calculations_optimization_r(node->right);
+        node_t* folded = fold_node(step.node, rewrites);
+        if (step.rel == ROOT) {
+            node = folded;
+        }
     }
+    // NOTE - every rewrite keeps the tree valid, the nodes left unvisited are not folded
+    if (walk.is_alloc_err()) {
+        LOG(ERROR, "Optimizer stopped after %zu rewrites\n", *rewrites);
+    }
+    walk.dtor();
+    return node;
+}
 
-    if ((node->type == OP) &&
-       ((node->left  != nullptr && node->left->type  == NUM) &&
-        (node->right != nullptr && node->right->type == NUM))) {
-
-        if (node->right != nullptr && node->right->type != NUM) return false;
-        if (node->left  != nullptr && node->left->type  != NUM) return false;
+node_t* middleend_t::fold_node(node_t* node, size_t* rewrites) {
+    if (node->type != OP || node->left == nullptr) {
+        return node;
+    }
+    if (node->right == nullptr) {
+        return fold_unary(node, rewrites);
+    }
 
-        if ((int) node->value == SUB && node->left == nullptr) return false;
-        if ((int) node->value == ADD && node->left == nullptr) return false;
+    if (node->left->type == NUM && node->right->type == NUM) {
+        if (!is_arithmetic(node->value)) {
+            return node;
+        }
 
-        node->value = calculate_value(node->value, node->left, node->right);
+        // NOTE - a division by zero is left to run time, as the unary folds are
+        double value = calculate_value(node->value, node->left, node->right);
+        if (!isfinite(value)) {
+            return node;
+        }
+        node->value = value;
 
-        free(node->left);
-        free(node->right);
+        prog_tree_.free_node(node->left);
+        prog_tree_.free_node(node->right);
 
         node->left = nullptr;
         node->right = nullptr;
         node->type = NUM;
-        change_flag |= true;
+        (*rewrites)++;
+        return node;
     }
-    return change_flag;
-}
-
-double middleend_t::calculate_expression(node_t* node) {
-    calculate_expression_r(node);
-    return node->value;
-};
 
-void middleend_t::calculate_expression_r(node_t* node) {
-    if (node == nullptr) {
-        return;
+    rel_t rel = (node->left->type == NUM) ? LEFT : RIGHT;
+    node_t* num = (rel == LEFT) ? node->left : node->right;
+    if (num->type != NUM) {
+        return node;
     }
 
-    if (node->left != nullptr) {
-        calculate_expression_r(node->left);
+    if (is_exactly(num->value, 0)) {
+        return null_val__optimization(node, rel, rewrites);
     }
+    if (is_exactly(num->value, 1)) {
+        return one_val_optimization(node, rel, rewrites);
+    }
+    return node;
+}
 
-    if (node->right != nullptr) {
-        calculate_expression_r(node->right);
+// NOTE - a single operand is on the left, its value is computed the way the interpreter
+//        does it. A result that is not finite is left for the run time
+node_t* middleend_t::fold_unary(node_t* node, size_t* rewrites) {
+    int op = (int) node->value;
+    if (node->left->type != NUM || !is_arithmetic(op) || op == MUL || op == DIV || op == POW || op == LOG) {
+        return node;
     }
 
-    if (node->type == OP && node->left != nullptr && node->right != nullptr) {
-        double val_l = 0;
-        double val_r = 0;
+    double value = node->left->value;
+    switch (op) {
+        case ADD:
+            break;
+        case SUB:
+            value = -value;
+            break;
+        default:
+            value = calculate_op(op, NAN, value);
+            break;
+    }
+    if (!isfinite(value)) {
+        return node;
+    }
 
-        if (node->left->type == VAR) {
-            printf("Enter the value of '%s' variable: ", "x");
-            scanf("%lf", &val_l);
-        } else {
-            val_l = node->left->value;
-        }
+    prog_tree_.free_node(node->left);
 
-        if (node->right->type == VAR) {
-            printf("Enter the value of '%s' variable: ", "x");
-            scanf("%lf", &val_r);
-        } else {
-            val_r = node->right->value;
-        }
+    node->left = nullptr;
+    node->type = NUM;
+    node->value = value;
+    (*rewrites)++;
+    return node;
+}
 
-        node->value = calculate_value(node->value, node->left, node->right);
+bool middleend_t::is_arithmetic(double op) {
+    return (int) op >= ADD && (int) op < EQ;
+}
 
-        free(node->left);
-        free(node->right);
+node_t* middleend_t::replace_by_child(node_t* node, rel_t keep) {
+    node_t* child = (keep == LEFT) ? node->left  : node->right;
+    node_t* other = (keep == LEFT) ? node->right : node->left;
+    node_t* parent = node->parent;
 
-        node->left = nullptr;
-        node->right = nullptr;
-        node->type = NUM;
+    if (parent != nullptr) {
+        if (parent->left == node) {
+            parent->left = child;
+        }
+        else {
+            parent->right = child;
+        }
     }
+    child->parent = parent;
+
+    prog_tree_.delete_subtree(other);
+    prog_tree_.free_node(node);
+    return child;
 }
 
 double middleend_t::calculate_value(double op_type, node_t* node_l,  node_t* node_r) {
     double val_l = (node_l == nullptr) ? NAN : node_l->value;
     double val_r = (node_r == nullptr) ? NAN : node_r->value;
 
+    return calculate_op(op_type, val_l, val_r);
+}
+
+// NOTE - unary functions take their argument in val_r
+double calculate_op(double op_type, double val_l, double val_r) {
     switch ((int) op_type) {
         case ADD:
             return val_l + val_r;
@@ -177,6 +248,8 @@ double middleend_t::calculate_value(double op_type, node_t* node_l,  node_t* nod
             return log(val_r) / log(val_l);
         case LN:
             return log(val_r);
+        case EXP:
+            return exp(val_r);
         default:
             LOG(ERROR, "Undefined operation %d(%lf)\n", (int) op_type, op_type);
             return NAN;
@@ -184,206 +257,70 @@ double middleend_t::calculate_value(double op_type, node_t* node_l,  node_t* nod
     }
 }
 
-node_t* middleend_t::basic_operations_optimization_r(node_t* node, rel_t rel, bool* flag) {
-    if (node == nullptr) {
-        return nullptr;
-    }
-
-    if (node->left != nullptr) {
-        basic_operations_optimization_r(node->left, LEFT, flag);
-    }
-
-    if (node->right != nullptr) {
-        basic_operations_optimization_r(node->right, RIGHT, flag);
-    }
-
-    if (node->type == OP && node->left != nullptr && node->right != nullptr &&
-       (node->left->type == NUM || node->right->type == NUM)) {
-        if (node->left->type == NUM) {
-            if ((int) node->left->value == 0) {
-                node = null_val__optimization(node, LEFT, rel, flag);
-            }
-            else if ((int) node->left->value == 1) {
-                node = one_val_optimization(node, LEFT, rel, flag);
-            }
-        }
-        else if (node->right->type == NUM) {
-            if ((int) node->right->value == 0) {
-                node = null_val__optimization(node, RIGHT, rel, flag);
-            }
-            else if ((int) node->right->value == 1) {
-                node = one_val_optimization(node, RIGHT, rel, flag);
-            }
-        }
-    }
-    return node;
-}
-
-node_t* middleend_t::null_val__optimization(node_t* node, rel_t rel, rel_t parent_rel, bool* flag) {
-    if (node == nullptr) {
-        return nullptr;
-    }
+// NOTE - rel is the side of the zero operand
+node_t* middleend_t::null_val__optimization(node_t* node, rel_t rel, size_t* rewrites) {
+    rel_t other = (rel == LEFT) ? RIGHT : LEFT;
 
     switch ((int) node->value) {
-        case ADD:
         case SUB:
-            if (parent_rel == RIGHT) {
-                *flag = true;
-                if (rel == LEFT) {
-                    node->parent->right = node->right;
-                    free(node->left);
-                    free(node);
-                }
-                else if (rel == RIGHT) {
-                    node->parent->right = node->left;
-                    free(node->right);
-                    free(node);
-                }
-            }
-            else if (parent_rel == LEFT) {
-                *flag = true;
-                if (rel == LEFT) {
-                    node->parent->left = node->right;
-                    free(node->left);
-                    free(node);
-                }
-                else if (rel == RIGHT) {
-                    node->parent->left = node->left;
-                    free(node->right);
-                    free(node);
-                }
+            // NOTE - 0 - x becomes -x, a single operand stays on the left
+            if (rel == LEFT) {
+                prog_tree_.free_node(node->left);
+                node->left = node->right;
+                node->right = nullptr;
+                (*rewrites)++;
+                return node;
             }
-            else if (parent_rel == ROOT) {
-                *flag = true;
-                if (rel == LEFT) {
-                    node_t* new_root = node->right;
-                    free(node->left);
-                    free(node);
-                    new_root->parent = nullptr;
-                    return new_root;
-                }
-               else if (rel == RIGHT) {
-                    node_t* new_root = node->left;
-                    free(node->right);
-                    free(node);
-                    new_root->parent = nullptr;
-                    return new_root;
-                }
-            }
-            break;
+            [[fallthrough]];
+        case ADD:
+            (*rewrites)++;
+            return replace_by_child(node, other);
         case DIV:
             if (rel == RIGHT) {
                 LOG(ERROR, "Division by zero err\n");
-                return nullptr;
+                return node;
             }
-
             [[fallthrough]];
         case MUL:
-            *flag = true;
-            prog_tree_.delete_subtree_r(node->right);
-            prog_tree_.delete_subtree_r(node->left);
+            prog_tree_.delete_subtree(node->right);
+            prog_tree_.delete_subtree(node->left);
 
             node->right = nullptr;
             node->left = nullptr;
 
             node->type = NUM;
             node->value = 0;
-            break;
+            (*rewrites)++;
+            return node;
         default:
-            break;
+            return node;
     }
-    return node;
 }
 
-node_t* middleend_t::one_val_optimization(node_t* node, rel_t rel, rel_t parent_rel, bool* flag) {
-    if (node == nullptr) {
-        return nullptr;
-    }
+// NOTE - rel is the side of the one operand
+node_t* middleend_t::one_val_optimization(node_t* node, rel_t rel, size_t* rewrites) {
+    rel_t other = (rel == LEFT) ? RIGHT : LEFT;
 
     switch ((int) node->value) {
         case MUL:
-            *flag = true;
-            if (parent_rel == LEFT) {
-                if (rel == LEFT) {
-                    node->parent->left = node->right;
-                    free(node->left);
-                    free(node);
-                }
-                else if (rel == RIGHT) {
-                    node->parent->left = node->left;
-                    free(node->right);
-                    free(node);
-                }
-            }
-            else if (parent_rel == RIGHT) {
-                if (rel == LEFT) {
-                    node->parent->right = node->right;
-                    free(node->left);
-                    free(node);
-                }
-                else if (rel == RIGHT) {
-                    node->parent->right = node->left;
-                    free(node->right);
-                    free(node);
-                }
-            }
-            else if (parent_rel == ROOT) {
-                if (rel == LEFT) {
-                    node_t* new_root = node->right;
-                    free(node->left);
-                    free(node);
-                    new_root->parent = nullptr;
-                    return new_root;
-                }
-                else if (rel == RIGHT) {
-                    node_t* new_root = node->left;
-                    free(node->right);
-                    free(node);
-                    new_root->parent = nullptr;
-                    return new_root;
-                }
-            }
-            break;
+            (*rewrites)++;
+            return replace_by_child(node, other);
         case DIV:
-            if (rel == LEFT) return node;
-            *flag = true;
-            if (parent_rel == LEFT) {
-                node->parent->left = node->left;
-            }
-            else if (parent_rel == RIGHT) {
-                node->parent->right = node->left;
-            }
-            else if (parent_rel == ROOT) {
-                node_t* left = node->left;
-                free(node);
-                free(node->right);
-                if (left == nullptr) return nullptr;
-                left->parent = nullptr;
-                return node->left;
-            }
-            free(node->right);
-            free(node);
-            break;
         case POW:
-            if (rel == RIGHT) {
-                *flag = true;
-                if (parent_rel == LEFT) {
-                    node->parent->left = node->left;
-                }
-                else if (parent_rel == RIGHT) {
-                    node->parent->right = node->left;
-                }
-
-                free(node->right);
-                free(node);
+            if (rel == LEFT) {
+                return node;
             }
-            break;
+            (*rewrites)++;
+            return replace_by_child(node, LEFT);
         default:
-            break;
+            return node;
     }
-    return node;
 }
 
-void middleend_t::deserialization(FILE* ostream) {
-    prog_tree_.deserialization(ostream);
+bool middleend_t::deserialization(FILE* ostream) {
+    return prog_tree_.deserialization(ostream);
+}
+
+bool middleend_t::deserialization_bin(FILE* ostream) {
+    return prog_tree_.deserialization_bin(ostream);
 }